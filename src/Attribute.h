@@ -3,6 +3,8 @@
 
 #include "Base.h"
 #include "Telemetry.h"
+#include "AttributeMirror.h"
+#include "Keys.h"
 
 constexpr char *ATTRIBUTE_TOPIC  PROGMEM = "v1/devices/me/attributes";
 constexpr char *ATTRIBUTE_RESPONSE_TOPIC  PROGMEM = "v1/devices/me/attributes/response";
@@ -13,73 +15,118 @@ constexpr char *ATTRIBUTE_RESPONSE_SUBSCRIBE_TOPIC  PROGMEM = "v1/devices/me/att
 constexpr char *SHARED_KEYS  PROGMEM = "sharedKeys";
 constexpr char *SHARED_KEY  PROGMEM = "shared";
 
+#ifndef MAX_SHARED_ATTRIBUTE_KEYS
+#define MAX_SHARED_ATTRIBUTE_KEYS 8
+#endif
+#define ATTRIBUTE_REQUEST_TIMEOUT 5000U // Default time a request callback waits for its response, also limits merging with an unanswered request
+#define SHARED_KEYS_REQUEST_OVERHEAD 17U // {"sharedKeys":""} around the keys, which already reserve the null terminator
+
 using Attribute = Telemetry;
 using SharedAttributeData = const JsonObjectConst;
 
+// Callbacks of shared attribute updates that are called, when updates are dispatched to a worker task.
+enum AttributeCallbackSelection : uint8_t
+{
+  ALL_CALLBACKS,
+  NETWORK_TASK_CALLBACKS, // Callbacks that use the client themselves, called by onMessage on the network task
+  DISPATCHED_CALLBACKS,   // Every other callback, called by the worker task
+};
+
 class SharedAttributeCallback
 {
-  template <size_t PayloadSize, size_t MaxFieldsElement, typename Logger>
+  template <size_t PayloadSize, typename Capacities, typename Logger, typename Encoding>
   friend class AttributeTemplate;
+  template <size_t PayloadSize, typename Capacities, typename Logger, typename Encoding>
+  friend class GatewayTemplate;
+  template <size_t PayloadSize, typename Capacities, typename Logger, typename Encoding>
+  friend class FirmwareTemplate;
 
 public:
-  using processFn = const std::function<void(const SharedAttributeData &data)>;
+  using processFn = InplaceFunction<void(const SharedAttributeData &data)>;
 
   inline SharedAttributeCallback()
-      : attributes(), callbackFunction(nullptr) {}
+      : attributes(), callbackFunction(nullptr), complete(true), networkTask(false) {}
 
   template <class InputIterator>
   inline SharedAttributeCallback(const InputIterator &first_itr, const InputIterator &last_itr, processFn cb)
-      : attributes(first_itr, last_itr), callbackFunction(cb) {}
+      : attributes(), callbackFunction(cb), complete(true), networkTask(false)
+  {
+    this->complete = this->attributes.insert(this->attributes.end(), first_itr, last_itr);
+  }
 
   inline SharedAttributeCallback(processFn cb)
-      : attributes(), callbackFunction(cb) {}
+      : attributes(), callbackFunction(cb), complete(true), networkTask(false) {}
+
+  // False if more keys were given than MAX_SHARED_ATTRIBUTE_KEYS, such a callback is refused when subscribing,
+  // because the keys that did not fit would never be matched.
+  inline const bool valid() const
+  {
+    return this->complete;
+  }
 
 private:
-  const std::vector<const char *> attributes;
+  // Hashed once when subscribing, so each received update only compares hashes.
+  StaticVector<InternedKey, MAX_SHARED_ATTRIBUTE_KEYS> attributes;
   processFn callbackFunction;
+  bool complete;
+  bool networkTask; // Never dispatched to a worker, because the callback publishes and receives with the client itself
 };
 
 class SharedAttributeRequestCallback
 {
-  template <size_t PayloadSize, size_t MaxFieldsElement, typename Logger>
+  template <size_t PayloadSize, typename Capacities, typename Logger, typename Encoding>
   friend class AttributeTemplate;
 
 public:
-  using processFn = std::function<void(const SharedAttributeData &data)>;
+  using processFn = InplaceFunction<void(const SharedAttributeData &data)>;
+  using failedFn = InplaceFunction<void()>;
 
   inline SharedAttributeRequestCallback()
-      : requestId(0U), callbackFunction(nullptr) {}
+      : requestId(0U), handle(0U), callbackFunction(nullptr), failedFunction(nullptr), timeout(ATTRIBUTE_REQUEST_TIMEOUT), deadline(0U), reconcile(false) {}
 
-  inline SharedAttributeRequestCallback(processFn cb)
-      : requestId(0U), callbackFunction(cb) {}
+  inline SharedAttributeRequestCallback(processFn cb, failedFn onFailed = nullptr, const uint32_t timeout = ATTRIBUTE_REQUEST_TIMEOUT)
+      : requestId(0U), handle(0U), callbackFunction(cb), failedFunction(onFailed), timeout(timeout), deadline(0U), reconcile(false) {}
 
   inline SharedAttributeRequestCallback& setCallback(processFn cb){
     this->callbackFunction = cb;
     return *this;
   }
+
+  // Called instead of the callback if the merged request could not be published or no response arrived in time.
+  inline SharedAttributeRequestCallback& setFailedCallback(failedFn onFailed){
+    this->failedFunction = onFailed;
+    return *this;
+  }
+
+  // Milliseconds to wait for the response, afterwards the callback is dropped by mqttClientLoop and the failed callback is called.
+  inline SharedAttributeRequestCallback& setTimeout(const uint32_t timeout){
+    this->timeout = timeout;
+    return *this;
+  }
 private:
   uint32_t requestId;         // Id the request was called with
+  uint32_t handle;            // Identifies the waiting callback, so it can be cancelled, 0 if it is not waiting
   processFn callbackFunction; // Callback to call
+  failedFn failedFunction;    // Callback to call if the request could not be published or timed out
+  uint32_t timeout;           // Time to wait for the response
+  uint32_t deadline;          // Time the callback is dropped at, set when it starts waiting
+  bool reconcile;             // Response is compared with the attribute mirror and passed to the update callbacks instead
 };
 
 template <
     size_t PayloadSize,
-    size_t MaxFieldsElement,
-    typename Logger = Logger>
+    typename Capacities,
+    typename Logger = Logger,
+    typename Encoding = JsonEncoding>
 class AttributeTemplate : public Base
 {
 
 public:
-  inline AttributeTemplate(PubSubClient *mqttClient, bool *enableQos) : Base(mqttClient, enableQos)
+  inline AttributeTemplate(PubSubClient *mqttClient, bool *enableQos, SubscriptionRegistry *subscriptions) : Base(mqttClient, enableQos, subscriptions)
   {
     this->requestId = 0;
-    this->reserveCallbakSize();
-  }
-
-  inline void reserveCallbakSize(void)
-  {
-    this->sharedAttributeUpdateCallbacks.reserve(MaxFieldsElement);
-    this->sharedAttributeRequestCallbacks.reserve(MaxFieldsElement);
+    this->pendingKeys[0] = '\0';
+    this->inflightKeys[0] = '\0';
   }
 
   inline bool isAttributeResponseMessage(const char *const topic)
@@ -92,10 +139,13 @@ public:
     return strncmp_P(topic, ATTRIBUTE_TOPIC, strlen(ATTRIBUTE_TOPIC)) == 0;
   }
 
-  inline void processSharedAttributeUpdateMessage(char *topic, uint8_t *payload, uint32_t length)
+  inline void processSharedAttributeUpdateMessage(char *, uint8_t *payload, uint32_t length, const AttributeCallbackSelection selection = ALL_CALLBACKS)
   {
-    StaticJsonDocument<JSON_OBJECT_SIZE(MaxFieldsElement)> jsonBuffer;
-    DeserializationError payloadDeserializationError = deserializeJson(jsonBuffer, payload, length);
+    StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::inboundFields)> jsonBuffer;
+    StaticJsonDocument<2U * JSON_OBJECT_SIZE(Capacities::inboundFields) + JSON_OBJECT_SIZE(1)> filter;
+    DeserializationError payloadDeserializationError = buildUpdateFilter(filter)
+                                                           ? Encoding::deserialize(jsonBuffer, payload, length, filter)
+                                                           : Encoding::deserialize(jsonBuffer, payload, length);
     if (payloadDeserializationError)
     {
       Logger::log(UNABLE_TO_DE_SERIALIZE_ATTRIBUTE_UPDATE);
@@ -117,62 +167,29 @@ public:
       return;
     }
 
-    for (size_t i = 0; i < this->sharedAttributeUpdateCallbacks.size(); i++)
-    {
-      char id_message[detectSizeOf(ATTRIBUTE_CALLBACK_ID, i)];
-      snprintf_P(id_message, sizeof(id_message), ATTRIBUTE_CALLBACK_ID, i);
-      Logger::log(id_message);
-
-      if (this->sharedAttributeUpdateCallbacks.at(i).callbackFunction == nullptr)
-      {
-        Logger::log(ATTRIBUTE_CALLBACK_IS_NULL);
-        continue;
-      }
-      else if (this->sharedAttributeUpdateCallbacks.at(i).attributes.empty())
-      {
-        Logger::log(ATTRIBUTE_CALLBACK_NO_KEYS);
-        this->sharedAttributeUpdateCallbacks.at(i).callbackFunction(data);
-        continue;
-      }
-
-      bool containsKey = false;
-      const char *requested_att;
-      for (const char *att : this->sharedAttributeUpdateCallbacks.at(i).attributes)
-      {
-        if (att == nullptr)
-        {
-          Logger::log(ATTRIBUTE_IS_NULL);
-          continue;
-        }
-        containsKey = containsKey || data.containsKey(att);
-
-        if (containsKey)
-        {
-          char contained_message[JSON_STRING_SIZE(strlen(ATTRIBUTE_IN_ARRAY)) + JSON_STRING_SIZE(strlen(att))];
-          snprintf_P(contained_message, sizeof(contained_message), ATTRIBUTE_IN_ARRAY, att);
-          Logger::log(contained_message);
-          requested_att = att;
-          break;
-        }
-      }
+    updateSharedAttributes(data, selection);
+  }
 
-      if (!containsKey || requested_att == nullptr)
+  // True if an update has to be processed on the network task, even though updates are dispatched to a worker.
+  inline const bool hasNetworkTaskCallbacks() const
+  {
+    for (const SharedAttributeCallback &callback : this->sharedAttributeUpdateCallbacks)
+    {
+      if (callback.networkTask)
       {
-        Logger::log(ATTRIBUTE_NO_CHANGE);
-        continue;
+        return true;
       }
-
-      char calling_message[JSON_STRING_SIZE(strlen(CALLING_ATTRIBUTE_CALLBACK)) + JSON_STRING_SIZE(strlen(requested_att))];
-      snprintf_P(calling_message, sizeof(calling_message), CALLING_ATTRIBUTE_CALLBACK, requested_att);
-      Logger::log(calling_message);
-      this->sharedAttributeUpdateCallbacks.at(i).callbackFunction(data);
     }
+    return false;
   }
 
   inline void processSharedAttributeRequestMessage(char *topic, uint8_t *payload, uint32_t length)
   {
-    StaticJsonDocument<JSON_OBJECT_SIZE(MaxFieldsElement)> jsonBuffer;
-    DeserializationError deserializePayloadError = deserializeJson(jsonBuffer, payload, length);
+    // Only shared keys are requested and only the shared object is passed to the callback, client attributes are skipped while parsing.
+    StaticJsonDocument<JSON_OBJECT_SIZE(1)> filter;
+    filter[static_cast<const char *>(SHARED_KEY)] = true;
+    StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::inboundFields)> jsonBuffer;
+    DeserializationError deserializePayloadError = Encoding::deserialize(jsonBuffer, payload, length, filter);
     if (deserializePayloadError)
     {
       Logger::log(UNABLE_TO_DE_SERIALIZE_ATTRIBUTE_REQUEST);
@@ -194,39 +211,53 @@ public:
       return;
     }
 
-    std::string response = topic;
-    size_t index = strlen(ATTRIBUTE_RESPONSE_TOPIC) + 1U;
-    response = response.substr(index, response.length() - index);
-    uint32_t response_id = atoi(response.c_str());
+    const uint32_t response_id = atoi(topic + strlen(ATTRIBUTE_RESPONSE_TOPIC) + 1U);
+    if (response_id == this->inflightRequestId)
+    {
+      this->inflightKeys[0] = '\0';
+    }
+    cacheResponse(data);
 
+    // Requests for overlapping keys share one request id, every callback waiting for it receives the same response.
+    bool reconcile = false;
     for (size_t i = 0; i < this->sharedAttributeRequestCallbacks.size(); i++)
     {
-      if (this->sharedAttributeRequestCallbacks.at(i).callbackFunction == nullptr)
+      if (this->sharedAttributeRequestCallbacks.at(i).requestId != response_id)
       {
-        Logger::log(ATTRIBUTE_REQUEST_CALLBACK_IS_NULL);
         continue;
       }
-      else if (this->sharedAttributeRequestCallbacks.at(i).requestId != response_id)
+      else if (this->sharedAttributeRequestCallbacks.at(i).reconcile)
       {
-        continue;
+        reconcile = true;
       }
+      else if (this->sharedAttributeRequestCallbacks.at(i).callbackFunction == nullptr)
+      {
+        Logger::log(ATTRIBUTE_REQUEST_CALLBACK_IS_NULL);
+      }
+      else
+      {
+        Logger::log(LogMessage(CALLING_REQUEST_ATTRIBUTE_CALLBACK, response_id).c_str());
+        this->sharedAttributeRequestCallbacks.at(i).callbackFunction(data);
+      }
+      // Erasing moves the next callback into the current index, so we need to check the same index again.
+      this->sharedAttributeRequestCallbacks.erase(this->sharedAttributeRequestCallbacks.begin() + i);
+      i--;
+    }
 
-      char message[detectSizeOf(CALLING_REQUEST_ATTRIBUTE_CALLBACK, response_id)];
-      snprintf_P(message, sizeof(message), CALLING_REQUEST_ATTRIBUTE_CALLBACK, response_id);
-      Logger::log(message);
-
-      this->sharedAttributeRequestCallbacks.at(i).callbackFunction(data);
-      this->sharedAttributeRequestCallbacks.erase(std::next(this->sharedAttributeRequestCallbacks.begin(), i));
+    // Comparing with the mirror removes the unchanged values from the response, so it has to happen after every other callback.
+    if (reconcile)
+    {
+      updateSharedAttributes(data);
     }
   }
 
+  // Requests are not published right away, instead every request made until the next flushSharedAttributesRequests is merged into one.
+  // Requests for keys that an unanswered request already asks for wait for its response and fresh enough cached values are served directly.
   template <class InputIterator>
   inline const bool sharedAttributesRequest(const InputIterator &first_itr, const InputIterator &last_itr, SharedAttributeRequestCallback &callback)
   {
-    StaticJsonDocument<JSON_OBJECT_SIZE(1)> requestBuffer;
-    JsonObject requestObject = requestBuffer.to<JsonObject>();
-
-    std::string sharedKeys;
+    size_t missingKeysLength = 0U;
+    bool anyKey = false;
     for (auto itr = first_itr; itr != last_itr; ++itr)
     {
       // Check if the given attribute is null, if it is skip it.
@@ -234,37 +265,141 @@ public:
       {
         continue;
       }
-      sharedKeys.append(*itr);
-      sharedKeys.push_back(COMMA);
+      anyKey = true;
+      if (!containsRequestKey(this->pendingKeys, *itr))
+      {
+        missingKeysLength += strlen(*itr) + 1U;
+      }
     }
 
     // Check if any sharedKeys were requested.
-    if (sharedKeys.empty())
+    if (!anyKey)
     {
       Logger::log(NO_KEYS_TO_REQUEST);
       return false;
     }
+    else if (serveFromCache(first_itr, last_itr, callback))
+    {
+      return true;
+    }
+    else if (this->inflightKeys[0] != '\0' && millis() - this->inflightAt < ATTRIBUTE_REQUEST_TIMEOUT && containsRequestKeys(this->inflightKeys, first_itr, last_itr))
+    {
+      callback.requestId = this->inflightRequestId;
+      return sharedAttributesRequestSubscribe(callback);
+    }
 
-    // Remove latest not needed ,
-    sharedKeys.pop_back();
-    String key = SHARED_KEYS;
-    requestObject[key.c_str()] = sharedKeys.c_str();
-    int objectSize = measureJson(requestBuffer) + 1;
-    char buffer[objectSize];
-    serializeJson(requestObject, buffer, objectSize);
-
-    // Print requested keys.
-    char message[JSON_STRING_SIZE(strlen(REQUEST_ATTRIBUTE)) + sharedKeys.length() + JSON_STRING_SIZE(strlen(buffer))];
-    snprintf_P(message, sizeof(message), REQUEST_ATTRIBUTE, sharedKeys.c_str(), buffer);
-    Logger::log(message);
+    // Append the keys not requested yet to the pending keys, the last comma is replaced by the null terminator on publishing.
+    if (this->pendingKeysLength + missingKeysLength >= sizeof(this->pendingKeys))
+    {
+      Logger::log(ATTRIBUTE_REQUEST_TOO_BIG);
+      return false;
+    }
+    callback.requestId = this->requestId + 1U;
+    if (!sharedAttributesRequestSubscribe(callback))
+    {
+      return false;
+    }
+    for (auto itr = first_itr; itr != last_itr; ++itr)
+    {
+      if (*itr == nullptr || containsRequestKey(this->pendingKeys, *itr))
+      {
+        continue;
+      }
+      const size_t keyLength = strlen(*itr);
+      memcpy(this->pendingKeys + this->pendingKeysLength, *itr, keyLength);
+      this->pendingKeysLength += keyLength;
+      this->pendingKeys[this->pendingKeysLength++] = COMMA;
+      this->pendingKeys[this->pendingKeysLength] = '\0';
+    }
+    return true;
+  }
 
+  // Publishes the request merged from every sharedAttributesRequest since the last call, called once per loop iteration.
+  inline const bool flushSharedAttributesRequests()
+  {
+    if (this->pendingKeysLength == 0U)
+    {
+      return true;
+    }
+    this->pendingKeys[this->pendingKeysLength - 1U] = '\0';
+    this->pendingKeysLength = 0U;
     requestId++;
-    callback.requestId = requestId;
-    sharedAttributesRequestSubscribe(callback);
 
-    char topic[detectSizeOf(ATTRIBUTE_REQUEST_TOPIC, requestId)];
-    snprintf_P(topic, sizeof(topic), ATTRIBUTE_REQUEST_TOPIC, requestId);
-    return (*mqttClient).publish(topic, buffer, (*mqttQoS));
+    StaticJsonDocument<JSON_OBJECT_SIZE(1)> requestBuffer;
+    JsonObject requestObject = requestBuffer.to<JsonObject>();
+    requestObject[static_cast<const char *>(SHARED_KEYS)] = static_cast<const char *>(this->pendingKeys);
+    // The keys never exceed the payload size, the rest is the key name and the JSON syntax around it.
+    char buffer[PayloadSize + SHARED_KEYS_REQUEST_OVERHEAD];
+    const size_t bufferLength = Encoding::serialize(requestObject, buffer, sizeof(buffer));
+
+    // Print requested keys, binary encoded requests can not be printed.
+    const char *printedBuffer = Encoding::binary ? "" : buffer;
+    Logger::log(FormatBuffer<LOG_MESSAGE_SIZE + sizeof(buffer) + PayloadSize>(REQUEST_ATTRIBUTE, this->pendingKeys, printedBuffer).c_str());
+
+    // Remember the published keys, so requests for the same keys can wait for this response.
+    memcpy(this->inflightKeys, this->pendingKeys, sizeof(this->inflightKeys));
+    this->inflightRequestId = requestId;
+    this->inflightAt = millis();
+    this->pendingKeys[0] = '\0';
+
+    const FormattedTopic topic(ATTRIBUTE_REQUEST_TOPIC, requestId);
+    if (publish(topic.c_str(), buffer, bufferLength, PRIORITY_ATTRIBUTE))
+    {
+      return true;
+    }
+    failRequest(requestId);
+    return false;
+  }
+
+  // Stops waiting for the response of the request the callback was passed to, neither of its callbacks is called anymore.
+  inline void cancelSharedAttributesRequest(const SharedAttributeRequestCallback &callback)
+  {
+    if (callback.handle == 0U)
+    {
+      return;
+    }
+    for (size_t i = 0; i < this->sharedAttributeRequestCallbacks.size(); i++)
+    {
+      if (this->sharedAttributeRequestCallbacks.at(i).handle == callback.handle)
+      {
+        this->sharedAttributeRequestCallbacks.erase(this->sharedAttributeRequestCallbacks.begin() + i);
+        return;
+      }
+    }
+  }
+
+  // Drops the callbacks whose response did not arrive in time, a lost response would otherwise keep their slot taken for good.
+  inline void checkSharedAttributesRequestTimeouts()
+  {
+    const uint32_t now = millis();
+    for (size_t i = 0; i < this->sharedAttributeRequestCallbacks.size(); i++)
+    {
+      const SharedAttributeRequestCallback callback = this->sharedAttributeRequestCallbacks.at(i);
+      if (static_cast<int32_t>(now - callback.deadline) < 0)
+      {
+        continue;
+      }
+      Logger::log(LogMessage(ATTRIBUTE_REQUEST_TIMED_OUT, callback.requestId).c_str());
+      // Later requests for the same keys have to ask again instead of waiting for the lost response.
+      if (callback.requestId == this->inflightRequestId)
+      {
+        this->inflightKeys[0] = '\0';
+      }
+      // Erasing moves the next callback into the current index, so we need to check the same index again.
+      this->sharedAttributeRequestCallbacks.erase(this->sharedAttributeRequestCallbacks.begin() + i);
+      i--;
+      if (callback.failedFunction != nullptr)
+      {
+        callback.failedFunction();
+      }
+    }
+  }
+
+  // Responses are kept for the given time in milliseconds and requests for keys they contain are answered without a round trip, 0 disables it.
+  inline void setSharedAttributesRequestCacheTTL(const uint32_t ttl)
+  {
+    this->cacheTTL = ttl;
+    this->cacheLength = 0U;
   }
 
   // Subscribes multiple Shared attributes callbacks.
@@ -274,16 +409,28 @@ public:
     const uint32_t size = std::distance(first_itr, last_itr);
     if (this->sharedAttributeUpdateCallbacks.size() + size > this->sharedAttributeUpdateCallbacks.capacity())
     {
-      Logger::log(MAX_SHARED_ATTRIBUTE_UPDATE_EXCEEDED);
+      Logger::log(LogMessage(MAX_SHARED_ATTRIBUTE_UPDATE_EXCEEDED, Capacities::attributeCallbacks).c_str());
       return false;
     }
-    if (!(*mqttClient).subscribe(ATTRIBUTE_TOPIC, (*mqttQoS) ? 1 : 0))
+    for (auto itr = first_itr; itr != last_itr; ++itr)
+    {
+      if (!(*itr).valid())
+      {
+        Logger::log(LogMessage(TOO_MANY_SHARED_ATTRIBUTE_KEYS, MAX_SHARED_ATTRIBUTE_KEYS).c_str());
+        return false;
+      }
+    }
+    if (size != 0U && !(*subscriptions).subscribe(ATTRIBUTE_TOPIC))
     {
       return false;
     }
 
     // Push back complete vector into our local m_sharedAttributeUpdateCallbacks vector.
     this->sharedAttributeUpdateCallbacks.insert(this->sharedAttributeUpdateCallbacks.end(), first_itr, last_itr);
+    for (auto itr = first_itr; itr != last_itr; ++itr)
+    {
+      mirrorSubscribed(*itr);
+    }
     return true;
   }
 
@@ -291,23 +438,29 @@ public:
   {
     if (this->sharedAttributeUpdateCallbacks.size() + 1U > this->sharedAttributeUpdateCallbacks.capacity())
     {
-      Logger::log(MAX_SHARED_ATTRIBUTE_UPDATE_EXCEEDED);
+      Logger::log(LogMessage(MAX_SHARED_ATTRIBUTE_UPDATE_EXCEEDED, Capacities::attributeCallbacks).c_str());
+      return false;
+    }
+    else if (!callback.valid())
+    {
+      Logger::log(LogMessage(TOO_MANY_SHARED_ATTRIBUTE_KEYS, MAX_SHARED_ATTRIBUTE_KEYS).c_str());
       return false;
     }
-    if (!(*mqttClient).subscribe(ATTRIBUTE_TOPIC, (*mqttQoS) ? 1 : 0))
+    if (!(*subscriptions).subscribe(ATTRIBUTE_TOPIC))
     {
       return false;
     }
 
     // Push back given callback into our local m_sharedAttributeUpdateCallbacks vector.
     this->sharedAttributeUpdateCallbacks.push_back(callback);
+    mirrorSubscribed(callback);
     return true;
   }
 
   inline const bool unsubscribeFromSharedAttribute()
   {
     this->sharedAttributeUpdateCallbacks.clear();
-    if (!(*mqttClient).unsubscribe(ATTRIBUTE_TOPIC))
+    if (!(*subscriptions).unsubscribe(ATTRIBUTE_TOPIC))
     {
       return false;
     }
@@ -317,33 +470,327 @@ public:
   inline const bool unsubscribeFromSharedAttributeRequest()
   {
     this->sharedAttributeRequestCallbacks.clear();
-    if (!(*mqttClient).unsubscribe(ATTRIBUTE_RESPONSE_SUBSCRIBE_TOPIC))
+    this->pendingKeys[0] = '\0';
+    this->pendingKeysLength = 0U;
+    this->inflightKeys[0] = '\0';
+    if (!(*subscriptions).unsubscribe(ATTRIBUTE_RESPONSE_SUBSCRIBE_TOPIC))
     {
       return false;
     }
     return true;
   }
 
+  // Loads the values mirrored before the last reset and passes them to the already subscribed callbacks,
+  // callbacks subscribed later receive them right away when subscribing. Returns false if nothing was mirrored yet.
+  inline const bool enableMirror(PersistentStorage *storage)
+  {
+    const bool loaded = this->mirror.begin(storage);
+    for (const SharedAttributeCallback &callback : this->sharedAttributeUpdateCallbacks)
+    {
+      mirrorSubscribed(callback);
+    }
+    return loaded;
+  }
+
+  inline void disableMirror()
+  {
+    this->mirror.end();
+  }
+
+  inline const bool mirrorEnabled() const
+  {
+    return this->mirror.enabled();
+  }
+
+  // Cached responses might contain values that are being updated, called before an update is processed.
+  inline void invalidateRequestCache()
+  {
+    this->cacheLength = 0U;
+  }
+
+  // Requests the keys of every subscribed callback, the server does not send updates that happened while we were offline.
+  // Only the values that differ from the mirror are passed to the callbacks.
+  inline const bool reconcileMirror()
+  {
+    bool success = true;
+    for (const SharedAttributeCallback &callback : this->sharedAttributeUpdateCallbacks)
+    {
+      success = reconcile(callback) && success;
+    }
+    return success;
+  }
+
 private:
+  AttributeMirrorTemplate<ATTRIBUTE_MIRROR_SIZE, Capacities::inboundFields> mirror;
   uint32_t requestId; // Allows nearly 4.3 million requests before wrapping back to 0.
-  std::vector<SharedAttributeCallback> sharedAttributeUpdateCallbacks;
-  std::vector<SharedAttributeRequestCallback> sharedAttributeRequestCallbacks; // Shared attribute request callbacks array
+  char pendingKeys[PayloadSize];   // Comma separated keys requested since the last flush
+  size_t pendingKeysLength = 0U;
+  char inflightKeys[PayloadSize];  // Keys of the last published request, empty once it was answered
+  uint32_t inflightRequestId = 0U;
+  uint32_t requestHandle = 0U;     // Handle of the last callback that started waiting
+  uint32_t inflightAt = 0U;
+  uint32_t cacheTTL = 0U;
+  uint32_t cachedAt = 0U;
+  size_t cacheLength = 0U;
+  uint8_t cache[PayloadSize];      // MessagePack encoded values of the last response
+  StaticVector<SharedAttributeCallback, Capacities::attributeCallbacks> sharedAttributeUpdateCallbacks;
+  StaticVector<SharedAttributeRequestCallback, Capacities::pendingRequests> sharedAttributeRequestCallbacks; // Shared attribute request callbacks array
+
+  // Passes the update to every callback subscribed to one of its keys. With the mirror enabled only values that changed are passed on.
+  inline void updateSharedAttributes(JsonObject &data, const AttributeCallbackSelection selection = ALL_CALLBACKS)
+  {
+    if (this->mirror.enabled() && !this->mirror.update(data))
+    {
+      Logger::log(ATTRIBUTE_MIRROR_NO_CHANGE);
+      return;
+    }
+
+    const KeyIndex<Capacities::inboundFields> keys(data);
+    for (size_t i = 0; i < this->sharedAttributeUpdateCallbacks.size(); i++)
+    {
+      if (selection != ALL_CALLBACKS && this->sharedAttributeUpdateCallbacks.at(i).networkTask != (selection == NETWORK_TASK_CALLBACKS))
+      {
+        continue;
+      }
+      Logger::log(LogMessage(ATTRIBUTE_CALLBACK_ID, i).c_str());
+
+      if (this->sharedAttributeUpdateCallbacks.at(i).callbackFunction == nullptr)
+      {
+        Logger::log(ATTRIBUTE_CALLBACK_IS_NULL);
+        continue;
+      }
+      else if (this->sharedAttributeUpdateCallbacks.at(i).attributes.empty())
+      {
+        Logger::log(ATTRIBUTE_CALLBACK_NO_KEYS);
+        this->sharedAttributeUpdateCallbacks.at(i).callbackFunction(data);
+        continue;
+      }
+
+      bool containsKey = false;
+      const char *requested_att;
+      for (const InternedKey &att : this->sharedAttributeUpdateCallbacks.at(i).attributes)
+      {
+        if (att.name == nullptr)
+        {
+          Logger::log(ATTRIBUTE_IS_NULL);
+          continue;
+        }
+        containsKey = containsKey || keys.contains(att);
+
+        if (containsKey)
+        {
+          Logger::log(LogMessage(ATTRIBUTE_IN_ARRAY, att.name).c_str());
+          requested_att = att;
+          break;
+        }
+      }
+
+      if (!containsKey || requested_att == nullptr)
+      {
+        Logger::log(ATTRIBUTE_NO_CHANGE);
+        continue;
+      }
+
+      Logger::log(LogMessage(CALLING_ATTRIBUTE_CALLBACK, requested_att).c_str());
+      this->sharedAttributeUpdateCallbacks.at(i).callbackFunction(data);
+    }
+  }
+
+  // Checks if the comma separated keys contain the given key.
+  static inline const bool containsRequestKey(const char *keys, const char *key)
+  {
+    const size_t keyLength = strlen(key);
+    const char *itr = keys;
+    while (*itr != '\0')
+    {
+      const char *end = strchr(itr, COMMA);
+      const size_t length = end == nullptr ? strlen(itr) : static_cast<size_t>(end - itr);
+      if (length == keyLength && strncmp(itr, key, keyLength) == 0)
+      {
+        return true;
+      }
+      else if (end == nullptr)
+      {
+        break;
+      }
+      itr = end + 1U;
+    }
+    return false;
+  }
+
+  template <class InputIterator>
+  static inline const bool containsRequestKeys(const char *keys, const InputIterator &first_itr, const InputIterator &last_itr)
+  {
+    for (auto itr = first_itr; itr != last_itr; ++itr)
+    {
+      if (*itr != nullptr && !containsRequestKey(keys, *itr))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  inline void cacheResponse(const JsonObject &data)
+  {
+    if (this->cacheTTL == 0U || measureMsgPack(data) > sizeof(this->cache))
+    {
+      this->cacheLength = 0U;
+      return;
+    }
+    this->cacheLength = serializeMsgPack(data, this->cache, sizeof(this->cache));
+    this->cachedAt = millis();
+  }
+
+  // Calls the callback with the cached response if it is fresh enough and contains every requested key.
+  template <class InputIterator>
+  inline const bool serveFromCache(const InputIterator &first_itr, const InputIterator &last_itr, const SharedAttributeRequestCallback &callback)
+  {
+    if (this->cacheLength == 0U || millis() - this->cachedAt >= this->cacheTTL)
+    {
+      return false;
+    }
+
+    StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::inboundFields) + PayloadSize> jsonBuffer;
+    if (deserializeMsgPack(jsonBuffer, reinterpret_cast<const char *>(this->cache), this->cacheLength))
+    {
+      return false;
+    }
+    const JsonObjectConst data = jsonBuffer.template as<JsonObjectConst>();
+    for (auto itr = first_itr; itr != last_itr; ++itr)
+    {
+      if (*itr != nullptr && !data.containsKey(*itr))
+      {
+        return false;
+      }
+    }
+
+    Logger::log(ATTRIBUTE_REQUEST_FROM_CACHE);
+    if (callback.callbackFunction != nullptr)
+    {
+      callback.callbackFunction(data);
+    }
+    return true;
+  }
+
+  // Passes the mirrored values to a newly subscribed callback and asks the server whether they are still current.
+  inline void mirrorSubscribed(const SharedAttributeCallback &callback)
+  {
+    if (!this->mirror.enabled() || callback.callbackFunction == nullptr)
+    {
+      return;
+    }
+
+    typename AttributeMirrorTemplate<ATTRIBUTE_MIRROR_SIZE, Capacities::inboundFields>::MirrorDocument mirrored;
+    if (this->mirror.read(mirrored))
+    {
+      const JsonObjectConst data = mirrored.template as<JsonObjectConst>();
+      bool containsKey = callback.attributes.empty() && data.size() != 0U;
+      for (const char *att : callback.attributes)
+      {
+        if (att != nullptr && data.containsKey(att))
+        {
+          containsKey = true;
+          break;
+        }
+      }
+      if (containsKey)
+      {
+        Logger::log(CALLING_MIRRORED_ATTRIBUTE_CALLBACK);
+        callback.callbackFunction(data);
+      }
+    }
+    if ((*mqttClient).connected())
+    {
+      reconcile(callback);
+    }
+  }
+
+  // Drops the callbacks waiting for a request that was never published, so they do not wait for a response forever.
+  inline void failRequest(const uint32_t id)
+  {
+    Logger::log(LogMessage(ATTRIBUTE_REQUEST_FAILED, id).c_str());
+    this->inflightKeys[0] = '\0';
+    for (size_t i = 0; i < this->sharedAttributeRequestCallbacks.size(); i++)
+    {
+      if (this->sharedAttributeRequestCallbacks.at(i).requestId != id)
+      {
+        continue;
+      }
+      else if (this->sharedAttributeRequestCallbacks.at(i).failedFunction != nullptr)
+      {
+        this->sharedAttributeRequestCallbacks.at(i).failedFunction();
+      }
+      this->sharedAttributeRequestCallbacks.erase(this->sharedAttributeRequestCallbacks.begin() + i);
+      i--;
+    }
+  }
+
+  inline const bool reconcile(const SharedAttributeCallback &callback)
+  {
+    // Callbacks subscribed to every key can not be requested, they are only updated by the server.
+    if (callback.attributes.empty())
+    {
+      return true;
+    }
+    SharedAttributeRequestCallback request;
+    request.reconcile = true;
+    return sharedAttributesRequest(callback.attributes.cbegin(), callback.attributes.cend(), request);
+  }
+
+  // Fills the filter with every key a callback subscribed to, at the top level and inside of the shared object,
+  // so an update only costs memory and time for keys somebody is interested in. Returns false if every key has to be parsed instead,
+  // because a callback subscribed to all keys or there are more distinct keys than fit into the filter.
+  inline const bool buildUpdateFilter(JsonDocument &filter) const
+  {
+    if (this->sharedAttributeUpdateCallbacks.empty())
+    {
+      return false;
+    }
+    JsonObject shared = filter.createNestedObject(static_cast<const char *>(SHARED_KEY));
+    for (const SharedAttributeCallback &callback : this->sharedAttributeUpdateCallbacks)
+    {
+      if (callback.attributes.empty())
+      {
+        return false;
+      }
+      for (const char *att : callback.attributes)
+      {
+        if (att == nullptr)
+        {
+          continue;
+        }
+        filter[att] = true;
+        shared[att] = true;
+      }
+    }
+    return !filter.overflowed();
+  }
 
   // Subscribe one Shared attributes request callback.
-  inline const bool sharedAttributesRequestSubscribe(const SharedAttributeRequestCallback &callback)
+  inline const bool sharedAttributesRequestSubscribe(SharedAttributeRequestCallback &callback)
   {
     if (this->sharedAttributeRequestCallbacks.size() + 1 > this->sharedAttributeRequestCallbacks.capacity())
     {
-      Logger::log(MAX_SHARED_ATTRIBUTE_REQUEST_EXCEEDED);
+      Logger::log(LogMessage(MAX_SHARED_ATTRIBUTE_REQUEST_EXCEEDED, Capacities::pendingRequests).c_str());
       return false;
     }
-    if (!(*mqttClient).subscribe(ATTRIBUTE_RESPONSE_SUBSCRIBE_TOPIC, (*mqttQoS) ? 1 : 0))
+    // The response topic stays subscribed between requests, so back to back requests only cost their publish.
+    if (!(*subscriptions).isSubscribed(ATTRIBUTE_RESPONSE_SUBSCRIBE_TOPIC) && !(*subscriptions).subscribe(ATTRIBUTE_RESPONSE_SUBSCRIBE_TOPIC))
     {
       return false;
     }
 
+    // The handle is also set on the given callback, so the caller can cancel it.
+    this->requestHandle++;
+    if (this->requestHandle == 0U)
+    {
+      this->requestHandle++;
+    }
+    callback.handle = this->requestHandle;
     // Push back given callback into our local m_sharedAttributeRequestCallbacks vector.
     this->sharedAttributeRequestCallbacks.push_back(callback);
+    this->sharedAttributeRequestCallbacks.at(this->sharedAttributeRequestCallbacks.size() - 1U).deadline = millis() + callback.timeout;
     return true;
   }
 };
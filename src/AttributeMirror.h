@@ -0,0 +1,111 @@
+#ifndef ATTRIBUTE_MIRROR_H
+#define ATTRIBUTE_MIRROR_H
+
+#include "Arduino.h"
+#include <ArduinoJson.h>
+#include "Storage.h"
+#include "Vector.h"
+
+// Can be overridden with a build flag, the mirror has to hold the MessagePack encoded values of every subscribed key.
+#ifndef ATTRIBUTE_MIRROR_SIZE
+#define ATTRIBUTE_MIRROR_SIZE 256
+#endif
+
+constexpr char *ATTRIBUTE_MIRROR_NAME PROGMEM = "attributes";
+
+// Last known shared attribute values, kept MessagePack encoded in RAM and in a PersistentStorage. They are available right after a reset
+// without waiting for the server and allow reducing an update from the server to the values that actually changed.
+template <size_t MirrorSize, size_t MaxKeys>
+class AttributeMirrorTemplate
+{
+
+public:
+  // Strings are copied out of the mirror buffer when it is read, because the buffer is overwritten when the values are written back.
+  using MirrorDocument = StaticJsonDocument<JSON_OBJECT_SIZE(MaxKeys) + MirrorSize>;
+
+  inline AttributeMirrorTemplate()
+      : storage(nullptr), length(0U)
+  {
+  }
+
+  // Loads the values persisted before the last reset, returns false if there were none.
+  inline const bool begin(PersistentStorage *storage)
+  {
+    this->storage = storage;
+    this->length = storage == nullptr ? 0U : storage->load(ATTRIBUTE_MIRROR_NAME, this->buffer, sizeof(this->buffer));
+    return this->length != 0U;
+  }
+
+  inline void end()
+  {
+    this->storage = nullptr;
+    this->length = 0U;
+  }
+
+  inline const bool enabled() const
+  {
+    return this->storage != nullptr;
+  }
+
+  inline const bool empty() const
+  {
+    return this->length == 0U;
+  }
+
+  // Copies the mirrored values into the document, returns false if nothing is mirrored yet.
+  inline const bool read(JsonDocument &jsonBuffer) const
+  {
+    if (this->length == 0U)
+    {
+      jsonBuffer.template to<JsonObject>();
+      return false;
+    }
+    return !deserializeMsgPack(jsonBuffer, reinterpret_cast<const char *>(this->buffer), this->length);
+  }
+
+  // Merges the update into the mirror and removes every value from the update that is already mirrored,
+  // persists the mirror if anything changed. Returns false if nothing changed.
+  inline const bool update(JsonObject &data)
+  {
+    MirrorDocument mirrored;
+    read(mirrored);
+    const JsonObjectConst current = mirrored.template as<JsonObjectConst>();
+    StaticVector<const char *, MaxKeys> unchanged;
+
+    for (JsonPair pair : data)
+    {
+      const char *key = pair.key().c_str();
+      const JsonVariantConst value = current[key];
+      if (!value.isNull() && value == pair.value())
+      {
+        unchanged.push_back(key);
+        continue;
+      }
+      mirrored[key] = pair.value();
+    }
+    for (const char *key : unchanged)
+    {
+      data.remove(key);
+    }
+
+    if (data.size() == 0U)
+    {
+      return false;
+    }
+    // Values that do not fit are still passed on, they are only not mirrored.
+    else if (mirrored.overflowed() || measureMsgPack(mirrored) > MirrorSize)
+    {
+      return true;
+    }
+    this->length = serializeMsgPack(mirrored, this->buffer, sizeof(this->buffer));
+    this->storage->save(ATTRIBUTE_MIRROR_NAME, this->buffer, this->length);
+    return true;
+  }
+
+private:
+  PersistentStorage *storage;
+  size_t length;
+  uint8_t buffer[MirrorSize];
+};
+
+#endif // ATTRIBUTE_MIRROR_H
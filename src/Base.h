@@ -4,31 +4,74 @@
 #include "Arduino.h"
 #include "PubSubClient.h"
 #include <ArduinoJson.h>
-#include <vector>
+#include "Function.h"
+#include "Vector.h"
 #include "Logger.h"
+#include "Subscription.h"
+#include "Encoding.h"
+#include "Format.h"
+#include "Scheduler.h"
+
+// Receives the messages a module would publish, while its callbacks run on a task that does not own the client.
+class ResponseSink
+{
+
+public:
+    virtual const bool push(const char *topic, const char *payload, const size_t length) = 0;
+};
+
+// Publishes the messages of the modules in the order of their priority instead of their call order.
+class OutboundSink
+{
+
+public:
+    virtual const bool publish(const char *topic, const char *payload, const size_t length, const MessagePriority priority) = 0;
+};
 
 class Base
 {
 
 public:
-    inline Base(PubSubClient *mqttClient, bool *enableQos)
+    inline Base(PubSubClient *mqttClient, bool *enableQos, SubscriptionRegistry *subscriptions)
     {
         this->mqttClient = mqttClient;
         this->mqttQoS = enableQos;
+        this->subscriptions = subscriptions;
+        this->responseSink = nullptr;
+        this->outboundSink = nullptr;
+    }
+
+    // Messages are handed to the sink instead of being published, as long as one is set.
+    inline void setResponseSink(ResponseSink *sink)
+    {
+        this->responseSink = sink;
+    }
+
+    // Messages are scheduled by their priority instead of being published right away, as long as one is set.
+    inline void setOutboundSink(OutboundSink *sink)
+    {
+        this->outboundSink = sink;
     }
 
 protected:
     PubSubClient *mqttClient;
     bool *mqttQoS;
+    SubscriptionRegistry *subscriptions;
+    ResponseSink *responseSink;
+    OutboundSink *outboundSink;
 
-    inline const uint8_t detectSizeOf(const char *msg, ...)
+    // Publishes with an explicit length, because binary encoded payloads may contain null bytes.
+    inline const bool publish(const char *topic, const char *payload, const size_t length, const MessagePriority priority)
     {
-        va_list args;
-        va_start(args, msg);
-        const int32_t result = JSON_STRING_SIZE(vsnprintf_P(nullptr, 0U, msg, args));
-        assert(result >= 0);
-        va_end(args);
-        return result;
+        if (this->responseSink != nullptr)
+        {
+            return (*this->responseSink).push(topic, payload, length);
+        }
+        else if (this->outboundSink != nullptr)
+        {
+            return (*this->outboundSink).publish(topic, payload, length, priority);
+        }
+        return (*mqttClient).publish(topic, reinterpret_cast<const uint8_t *>(payload), length, (*mqttQoS));
     }
 
 };
@@ -0,0 +1,64 @@
+#ifndef BUFFERED_PRINT_H
+#define BUFFERED_PRINT_H
+
+#include "Arduino.h"
+
+#ifndef STREAM_CHUNK_SIZE
+#define STREAM_CHUNK_SIZE 64
+#endif
+
+// Collects the bytes written by the serializer into chunks, because PubSubClient passes every write straight to the network client
+// and ArduinoJson writes most of the payload one byte at a time.
+template <size_t ChunkSize = STREAM_CHUNK_SIZE>
+class BufferedPrint : public Print
+{
+
+public:
+  inline BufferedPrint(Print &output)
+      : output(output), length(0U), written(0U)
+  {
+  }
+
+  size_t write(uint8_t character) override
+  {
+    buffer[length++] = character;
+    if (length == ChunkSize)
+    {
+      flush();
+    }
+    return 1U;
+  }
+
+  size_t write(const uint8_t *data, size_t size) override
+  {
+    for (size_t i = 0; i < size; i++)
+    {
+      write(data[i]);
+    }
+    return size;
+  }
+
+  inline void flush()
+  {
+    if (length == 0U)
+    {
+      return;
+    }
+    written += output.write(buffer, length);
+    length = 0U;
+  }
+
+  // Amount of bytes that actually reached the output, compared with the announced length to detect a broken connection.
+  inline const size_t flushed() const
+  {
+    return written;
+  }
+
+private:
+  Print &output;
+  uint8_t buffer[ChunkSize];
+  size_t length;
+  size_t written;
+};
+
+#endif // BUFFERED_PRINT_H
@@ -0,0 +1,29 @@
+#ifndef CAPACITIES_H
+#define CAPACITIES_H
+
+#include "Arduino.h"
+
+// Independent capacities of the modules, for example a device with 40 shared attributes, but only 4 RPC methods with small responses uses
+// ThingspodTemplate<256U, 40U, Logger, JsonEncoding, AllFeatures, CapacityTraits<4U, 8U, 2U, 40U, 8U, 32U>>.
+// RPCMethods: server side RPC callbacks that can be subscribed at once.
+// AttributeCallbacks: shared attribute update callbacks that can be subscribed at once.
+// PendingRequests: shared attribute requests that can await their response at once.
+// InboundFields: fields of every received message, also sizes the attribute mirror and the awaited responses.
+// OutboundFields: fields of every sent telemetry or attribute message.
+// ResponseSize: bytes of the serialized response to a server side RPC.
+template <size_t RPCMethods, size_t AttributeCallbacks, size_t PendingRequests, size_t InboundFields, size_t OutboundFields, size_t ResponseSize>
+struct CapacityTraits
+{
+  static constexpr size_t rpcMethods = RPCMethods;
+  static constexpr size_t attributeCallbacks = AttributeCallbacks;
+  static constexpr size_t pendingRequests = PendingRequests;
+  static constexpr size_t inboundFields = InboundFields;
+  static constexpr size_t outboundFields = OutboundFields;
+  static constexpr size_t responseSize = ResponseSize;
+};
+
+// Every capacity taken from MaxFieldsElement and the response from PayloadSize, used if no traits are given.
+template <size_t PayloadSize, size_t MaxFieldsElement>
+using UniformCapacities = CapacityTraits<MaxFieldsElement, MaxFieldsElement, MaxFieldsElement, MaxFieldsElement, MaxFieldsElement, PayloadSize>;
+
+#endif // CAPACITIES_H
@@ -10,6 +10,13 @@ constexpr char *SECRET_KEY  PROGMEM = "secretKey";
 constexpr char *DURATION_KEY  PROGMEM = "durationMs";
 constexpr char *DEVICE_NAME_KEY  PROGMEM = "deviceName";
 
+// Claiming is requested once with its own secret, so the request is sized from the secret instead of PayloadSize.
+#ifndef MAX_CLAIM_SECRET_LENGTH
+#define MAX_CLAIM_SECRET_LENGTH 32U
+#endif
+// {"secretKey":"","durationMs":4294967295} around the secret, including the null terminator.
+#define CLAIM_REQUEST_SIZE (41U + MAX_CLAIM_SECRET_LENGTH)
+
 
 #endif
 #endif
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include "Arduino.h"
+
+#define DEFAULT_RECONNECT_MIN_DELAY 1000U
+#define DEFAULT_RECONNECT_MAX_DELAY 60000U
+
+#ifndef MAX_ACCESS_TOKEN_LENGTH
+#define MAX_ACCESS_TOKEN_LENGTH 64U
+#endif
+
+#ifndef MAX_CLIENT_ID_LENGTH
+#define MAX_CLIENT_ID_LENGTH 64U
+#endif
+
+// Timings of the managed connection, allows to measure how long the device was offline and how long restoring took.
+struct ConnectionStats
+{
+  uint32_t reconnects;            // Amount of successful reconnects
+  uint32_t failedAttempts;        // Amount of failed reconnect attempts
+  uint32_t lastReconnectDuration; // Time in milliseconds from detecting the disconnect until the session was restored
+  uint32_t lastRestoreDuration;   // Time in milliseconds it took to restore subscriptions, firmware info and queued data
+};
+
+// Exponential backoff with equal jitter, so a fleet that lost the server at the same time does not reconnect in lockstep.
+class ReconnectBackoff
+{
+
+public:
+  inline ReconnectBackoff(const uint32_t minDelay = DEFAULT_RECONNECT_MIN_DELAY, const uint32_t maxDelay = DEFAULT_RECONNECT_MAX_DELAY)
+      : minDelay(minDelay), maxDelay(maxDelay), attempts(0U)
+  {
+  }
+
+  inline void setDelays(const uint32_t minDelay, const uint32_t maxDelay)
+  {
+    this->minDelay = minDelay;
+    this->maxDelay = maxDelay < minDelay ? minDelay : maxDelay;
+  }
+
+  inline void reset()
+  {
+    this->attempts = 0U;
+  }
+
+  // Returns the time to wait before the next attempt and increases the exponent for the following one.
+  inline const uint32_t nextDelay()
+  {
+    uint32_t delay = this->maxDelay;
+    // Stop shifting once the delay can not grow anymore, prevents overflowing the 32 bit value.
+    if (this->attempts < 31U && (this->minDelay << this->attempts) >> this->attempts == this->minDelay)
+    {
+      delay = this->minDelay << this->attempts;
+      this->attempts++;
+    }
+    if (delay > this->maxDelay)
+    {
+      delay = this->maxDelay;
+    }
+    const uint32_t half = delay / 2U;
+    return half + random(half + 1U);
+  }
+
+private:
+  uint32_t minDelay;
+  uint32_t maxDelay;
+  uint8_t attempts;
+};
+
+#endif // CONNECTION_H
@@ -0,0 +1,294 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include "Arduino.h"
+
+// Awaitable request / response operations are only available if the compiler supports C++20 coroutines, for example with -std=gnu++20.
+#if defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <ArduinoJson.h>
+#include "Vector.h"
+
+#ifndef MAX_COROUTINE_FRAMES
+#define MAX_COROUTINE_FRAMES 2
+#endif
+#ifndef COROUTINE_FRAME_SIZE
+#define COROUTINE_FRAME_SIZE 2048
+#endif
+#ifndef MAX_AWAITED_OPERATIONS
+#define MAX_AWAITED_OPERATIONS 4
+#endif
+#define DEFAULT_AWAIT_TIMEOUT 10000U
+
+// Fixed amount of fixed size blocks the coroutine frames are placed in, so starting a coroutine never allocates on the heap.
+class CoroutineFramePool
+{
+
+public:
+  inline CoroutineFramePool()
+      : used()
+  {
+  }
+
+  inline void *allocate(const size_t size)
+  {
+    if (size > COROUTINE_FRAME_SIZE)
+    {
+      return nullptr;
+    }
+    for (size_t i = 0; i < MAX_COROUTINE_FRAMES; i++)
+    {
+      if (!used[i])
+      {
+        used[i] = true;
+        return frames[i].data;
+      }
+    }
+    return nullptr;
+  }
+
+  inline void deallocate(void *frame)
+  {
+    for (size_t i = 0; i < MAX_COROUTINE_FRAMES; i++)
+    {
+      if (frames[i].data == frame)
+      {
+        used[i] = false;
+        return;
+      }
+    }
+  }
+
+  // One pool shared by every coroutine, because the frame is allocated before the coroutine knows which object it belongs to.
+  static inline CoroutineFramePool &instance()
+  {
+    static CoroutineFramePool pool;
+    return pool;
+  }
+
+private:
+  struct Frame
+  {
+    alignas(std::max_align_t) uint8_t data[COROUTINE_FRAME_SIZE];
+  };
+
+  Frame frames[MAX_COROUTINE_FRAMES];
+  bool used[MAX_COROUTINE_FRAMES];
+};
+
+// Return type of coroutines that await operations, the coroutine starts right away and destroys itself once it finished.
+// If no frame of the pool is free the coroutine is not started at all, which can be checked with started().
+class CoroutineTask
+{
+
+public:
+  struct promise_type
+  {
+    static inline void *operator new(const size_t size) noexcept
+    {
+      return CoroutineFramePool::instance().allocate(size);
+    }
+
+    static inline void operator delete(void *frame, const size_t)
+    {
+      CoroutineFramePool::instance().deallocate(frame);
+    }
+
+    static inline CoroutineTask get_return_object_on_allocation_failure()
+    {
+      return CoroutineTask(false);
+    }
+
+    inline CoroutineTask get_return_object()
+    {
+      return CoroutineTask(true);
+    }
+
+    inline std::suspend_never initial_suspend() noexcept
+    {
+      return {};
+    }
+
+    inline std::suspend_never final_suspend() noexcept
+    {
+      return {};
+    }
+
+    inline void return_void()
+    {
+    }
+
+    inline void unhandled_exception()
+    {
+      abort();
+    }
+  };
+
+  inline const bool started() const
+  {
+    return this->valid;
+  }
+
+private:
+  inline explicit CoroutineTask(const bool valid)
+      : valid(valid)
+  {
+  }
+
+  bool valid;
+};
+
+// State shared by every awaitable operation, the scheduler resumes the awaiting coroutine once the operation completed or timed out.
+class AwaitedOperation
+{
+  friend class CoroutineScheduler;
+
+public:
+  inline AwaitedOperation()
+      : handle(), ticket(0U), deadline(0U), completed(false)
+  {
+  }
+
+  inline const bool timedOut() const
+  {
+    return !this->completed;
+  }
+
+protected:
+  std::coroutine_handle<> handle;
+  uint32_t ticket;
+  uint32_t deadline;
+  bool completed;
+};
+
+// Resumes coroutines waiting for an operation, driven by mqttClientLoop so coroutines only ever run on the network task and never inside a callback.
+// Callbacks identify their operation by ticket instead of by pointer, so a response that arrives after the operation timed out is ignored.
+class CoroutineScheduler
+{
+
+public:
+  inline CoroutineScheduler()
+      : nextTicket(0U)
+  {
+  }
+
+  // Registers the operation and returns its ticket, 0 if too many operations are awaited at once.
+  inline const uint32_t wait(AwaitedOperation *operation, const std::coroutine_handle<> handle, const uint32_t timeout)
+  {
+    if (this->waiting.full())
+    {
+      return 0U;
+    }
+    nextTicket++;
+    if (nextTicket == 0U)
+    {
+      nextTicket++;
+    }
+    operation->handle = handle;
+    operation->ticket = nextTicket;
+    operation->deadline = millis() + timeout;
+    operation->completed = false;
+    this->waiting.push_back(operation);
+    return nextTicket;
+  }
+
+  // Waiting operation with the given ticket or nullptr if it already completed or timed out.
+  inline AwaitedOperation *find(const uint32_t ticket) const
+  {
+    for (AwaitedOperation *operation : this->waiting)
+    {
+      if (operation->ticket == ticket && !operation->completed)
+      {
+        return operation;
+      }
+    }
+    return nullptr;
+  }
+
+  // Marks the operation as completed, the coroutine is resumed by the next poll.
+  inline void complete(AwaitedOperation *operation)
+  {
+    operation->completed = true;
+  }
+
+  // Forgets an operation that completed before its coroutine had to be suspended.
+  inline void cancel(AwaitedOperation *operation)
+  {
+    for (size_t i = 0; i < this->waiting.size(); i++)
+    {
+      if (this->waiting.at(i) == operation)
+      {
+        this->waiting.erase(this->waiting.begin() + i);
+        return;
+      }
+    }
+  }
+
+  inline void poll()
+  {
+    const uint32_t now = millis();
+    for (size_t i = 0; i < this->waiting.size();)
+    {
+      AwaitedOperation *operation = this->waiting.at(i);
+      if (!operation->completed && static_cast<int32_t>(now - operation->deadline) < 0)
+      {
+        i++;
+        continue;
+      }
+      // Removed before resuming, because the resumed coroutine may await the next operation or finish and free the operation.
+      this->waiting.erase(this->waiting.begin() + i);
+      operation->handle.resume();
+    }
+  }
+
+private:
+  StaticVector<AwaitedOperation *, MAX_AWAITED_OPERATIONS> waiting;
+  uint32_t nextTicket;
+};
+
+// Result of an awaited operation that answers with JSON, the values are copied into the document, because the response buffer
+// is long gone once the coroutine is resumed.
+template <size_t PayloadSize, size_t MaxFieldsElement>
+class AwaitedJson
+{
+
+public:
+  inline AwaitedJson()
+      : success(false), document()
+  {
+  }
+
+  // False if the operation timed out or could not be started.
+  inline explicit operator bool() const
+  {
+    return this->success;
+  }
+
+  inline const JsonObjectConst values() const
+  {
+    return this->document.template as<JsonObjectConst>();
+  }
+
+  // Response that is not an object, for example the plain value returned by a server side RPC method.
+  inline const JsonVariantConst value() const
+  {
+    return this->document.template as<JsonVariantConst>();
+  }
+
+  // Copies the values out of the response, the copy from a constant buffer makes the document own the strings.
+  inline void assign(const JsonVariantConst &data)
+  {
+    char buffer[PayloadSize];
+    const size_t length = serializeMsgPack(data, buffer, sizeof(buffer));
+    this->success = length != 0U && !deserializeMsgPack(this->document, static_cast<const char *>(buffer), length);
+  }
+
+private:
+  bool success;
+  StaticJsonDocument<JSON_OBJECT_SIZE(MaxFieldsElement) + PayloadSize> document;
+};
+
+#endif // defined(__cpp_impl_coroutine)
+
+#endif // COROUTINE_H
@@ -0,0 +1,50 @@
+#ifndef DUTY_CYCLE_H
+#define DUTY_CYCLE_H
+
+#include "Arduino.h"
+
+// The mirrored attributes are reconciled and the firmware info is resent once every this many wakes.
+#ifndef DEFAULT_SESSION_REFRESH_WAKES
+#define DEFAULT_SESSION_REFRESH_WAKES 24U
+#endif
+// Increased whenever DutyCycleSession changes, so a blob written by an older firmware is ignored instead of misread.
+#define DUTY_CYCLE_LAYOUT_VERSION 1U
+// Topic index and length in front of every persisted payload.
+#define SESSION_MESSAGE_OVERHEAD 3U
+// Telemetry, attributes and both of their gateway variants.
+#define PERSISTED_TOPIC_COUNT 4U
+
+constexpr char *DUTY_CYCLE_SESSION_NAME PROGMEM = "session";
+
+// State of a duty cycled session that has to outlive deep sleep, persisted by sleep and loaded again on the next boot.
+// The queued messages follow the session in the same blob, each as topic index, length and payload.
+struct DutyCycleSession
+{
+  uint8_t layout;             // DUTY_CYCLE_LAYOUT_VERSION
+  uint8_t queued;             // Amount of queued messages persisted after the session
+  uint16_t wakesSinceRefresh; // Wakes since the mirrored attributes were reconciled and the firmware info was sent
+  uint32_t subscriptions;     // Fingerprint of the topics the broker session was subscribed to
+  uint32_t wakes;             // Amount of successful wakes
+};
+
+// Measurements of the last wake, allows to compare the time and traffic of a wake with and without a persistent broker session.
+struct DutyCycleStats
+{
+  uint32_t lastWakeDuration;    // Time in milliseconds from starting to connect until disconnecting again
+  uint32_t lastConnectDuration; // Time in milliseconds until the broker accepted the connection
+  uint32_t lastFlushed;         // Messages queued while asleep that were published right after connecting
+  bool lastResubscribed;        // True if the subscriptions had to be sent again
+  bool lastRefreshed;           // True if the mirrored attributes were requested and the firmware info was sent
+};
+
+// Everything a duty cycled client keeps between beginDutyCycle and endDutyCycle.
+struct DutyCycleState
+{
+  bool persistentSession = false;
+  uint16_t refreshInterval = DEFAULT_SESSION_REFRESH_WAKES;
+  uint32_t wokeAt = 0U;
+  DutyCycleSession session = {};
+  DutyCycleStats stats = {};
+};
+
+#endif // DUTY_CYCLE_H
@@ -0,0 +1,186 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "Telemetry.h"
+
+// Encoding policies decide how outbound payloads are serialized and inbound payloads are parsed, for the telemetry, attribute and RPC topics.
+// Provisioning and claiming always use JSON, because they happen before the device profile of the device is known.
+
+// JSON text, the default format understood by the server without any additional configuration.
+class JsonEncoding
+{
+
+public:
+  static constexpr bool binary = false;
+
+  template <typename Source>
+  static inline const size_t measure(const Source &source)
+  {
+    return measureJson(source);
+  }
+
+  // Returns the amount of written bytes without the null terminator.
+  template <typename Source>
+  static inline const size_t serialize(const Source &source, char *buffer, const size_t size)
+  {
+    return serializeJson(source, buffer, size);
+  }
+
+  template <typename Source>
+  static inline const size_t serialize(const Source &source, Print &output)
+  {
+    return serializeJson(source, output);
+  }
+
+  template <typename Input>
+  static inline DeserializationError deserialize(JsonDocument &jsonBuffer, Input *payload, const size_t length)
+  {
+    return deserializeJson(jsonBuffer, payload, length);
+  }
+
+  // Only the fields set to true in the filter are stored, every other field is skipped while parsing.
+  template <typename Input>
+  static inline DeserializationError deserialize(JsonDocument &jsonBuffer, Input *payload, const size_t length, const JsonDocument &filter)
+  {
+    return deserializeJson(jsonBuffer, payload, length, DeserializationOption::Filter(filter));
+  }
+
+  static inline const size_t serializeArrayBegin(char *buffer, const size_t size, const size_t count)
+  {
+    (void)count;
+    return writeCharacter(buffer, size, '[');
+  }
+
+  static inline const size_t serializeArraySeparator(char *buffer, const size_t size)
+  {
+    return writeCharacter(buffer, size, ',');
+  }
+
+  static inline const size_t serializeArrayEnd(char *buffer, const size_t size)
+  {
+    return writeCharacter(buffer, size, ']');
+  }
+
+  static inline const size_t serializeRecord(const TelemetryRecord &record, JsonDocument &jsonBuffer, char *buffer, const size_t size)
+  {
+    return record.serialize(jsonBuffer, buffer, size);
+  }
+
+private:
+  static inline const size_t writeCharacter(char *buffer, const size_t size, const char character)
+  {
+    if (size < 2U)
+    {
+      return 0U;
+    }
+    buffer[0] = character;
+    buffer[1] = '\0';
+    return 1U;
+  }
+};
+
+// MessagePack, roughly a third smaller than JSON and without any float formatting or parsing,
+// needs a converter on the server side (for example a rule chain script or a device profile transport configuration).
+class MsgPackEncoding
+{
+
+public:
+  static constexpr bool binary = true;
+
+  template <typename Source>
+  static inline const size_t measure(const Source &source)
+  {
+    return measureMsgPack(source);
+  }
+
+  template <typename Source>
+  static inline const size_t serialize(const Source &source, char *buffer, const size_t size)
+  {
+    return serializeMsgPack(source, buffer, size);
+  }
+
+  template <typename Source>
+  static inline const size_t serialize(const Source &source, Print &output)
+  {
+    return serializeMsgPack(source, output);
+  }
+
+  template <typename Input>
+  static inline DeserializationError deserialize(JsonDocument &jsonBuffer, Input *payload, const size_t length)
+  {
+    return deserializeMsgPack(jsonBuffer, payload, length);
+  }
+
+  template <typename Input>
+  static inline DeserializationError deserialize(JsonDocument &jsonBuffer, Input *payload, const size_t length, const JsonDocument &filter)
+  {
+    return deserializeMsgPack(jsonBuffer, payload, length, DeserializationOption::Filter(filter));
+  }
+
+  static inline const size_t serializeArrayBegin(char *buffer, const size_t size, const size_t count)
+  {
+    if (count < 16U && size >= 1U)
+    {
+      buffer[0] = static_cast<char>(0x90 | count); // fixarray
+      return 1U;
+    }
+    else if (count <= 0xFFFF && size >= 3U)
+    {
+      buffer[0] = static_cast<char>(0xDC); // array 16
+      buffer[1] = static_cast<char>(count >> 8U);
+      buffer[2] = static_cast<char>(count & 0xFF);
+      return 3U;
+    }
+    return 0U;
+  }
+
+  static inline const size_t serializeArraySeparator(char *buffer, const size_t size)
+  {
+    (void)buffer;
+    (void)size;
+    return 0U;
+  }
+
+  static inline const size_t serializeArrayEnd(char *buffer, const size_t size)
+  {
+    (void)buffer;
+    (void)size;
+    return 0U;
+  }
+
+  // Writes the record as a {"ts":uint64,"values":{...}} map.
+  static inline const size_t serializeRecord(const TelemetryRecord &record, JsonDocument &jsonBuffer, char *buffer, const size_t size)
+  {
+    if (!record.serializeValues(jsonBuffer))
+    {
+      return 0U;
+    }
+    // Map header, "ts" key, uint 64 value and "values" key.
+    const size_t headerLength = 1U + 3U + 9U + 7U;
+    const size_t valuesLength = measureMsgPack(jsonBuffer);
+    if (headerLength + valuesLength > size)
+    {
+      return 0U;
+    }
+
+    size_t length = 0U;
+    buffer[length++] = static_cast<char>(0x82); // fixmap with 2 entries
+    buffer[length++] = static_cast<char>(0xA2); // fixstr with 2 characters
+    buffer[length++] = 't';
+    buffer[length++] = 's';
+    buffer[length++] = static_cast<char>(0xCF); // uint 64, big endian
+    for (int8_t shift = 56; shift >= 0; shift -= 8)
+    {
+      buffer[length++] = static_cast<char>((record.ts >> shift) & 0xFF);
+    }
+    buffer[length++] = static_cast<char>(0xA6); // fixstr with 6 characters
+    memcpy(buffer + length, "values", 6U);
+    length += 6U;
+    length += serializeMsgPack(jsonBuffer, buffer + length, size - length);
+    return length;
+  }
+};
+
+#endif // ENCODING_H
@@ -0,0 +1,530 @@
+#ifndef FEATURES_H
+#define FEATURES_H
+
+#include <type_traits>
+#include "RPC.h"
+#include "Attribute.h"
+#include "Provisioning.h"
+#include "Firmware.h"
+#include "Gateway.h"
+#include "Queue.h"
+#include "Scheduler.h"
+#include "TelemetryFilter.h"
+#include "TelemetryAggregator.h"
+
+// Selects the modules a ThingspodTemplate contains, for example a device that only sends telemetry and handles server side RPCs uses
+// ThingspodTemplate<128U, 16U, Logger, JsonEncoding, FeaturePolicy<true, false, false, false, false>>.
+// Disabled modules are replaced by empty stand-ins, so their code is never instantiated, their messages are never routed
+// and their API calls return false without sending anything.
+// The buffers behind the optional client services are opted into with the remaining parameters, each one costs RAM in every instance:
+// Offline queues data while disconnected for the managed connection and the duty cycle, which needs it,
+// Producers is the queue of the thread safe API, Dispatch the queues between the network and the worker task,
+// Scheduling the outbound scheduler and Shaping the telemetry filter and aggregation.
+template <bool RPC, bool Attributes, bool Provisioning, bool Firmware, bool Gateway,
+          bool Offline = false, bool Producers = false, bool Dispatch = false, bool Scheduling = false, bool Shaping = false>
+struct FeaturePolicy
+{
+  static_assert(!Firmware || Attributes, "The firmware update is announced with shared attributes and therefore needs the attribute module");
+
+  static constexpr bool rpc = RPC;
+  static constexpr bool attributes = Attributes;
+  static constexpr bool provisioning = Provisioning;
+  static constexpr bool firmware = Firmware;
+  static constexpr bool gateway = Gateway;
+  static constexpr bool offline = Offline;
+  static constexpr bool producers = Producers;
+  static constexpr bool dispatch = Dispatch;
+  static constexpr bool scheduling = Scheduling;
+  static constexpr bool shaping = Shaping;
+};
+
+using AllFeatures = FeaturePolicy<true, true, true, true, true, true, true, true, true, true>;
+using TelemetryOnly = FeaturePolicy<false, false, false, false, false>;
+
+template <bool Enabled, typename Module, typename Disabled>
+using FeatureModule = typename std::conditional<Enabled, Module, Disabled>::type;
+
+// Stand-in for the RPC module.
+class NullRPC
+{
+
+public:
+  template <typename... Args>
+  inline NullRPC(const Args &...) {}
+
+  inline void setOutboundSink(OutboundSink *) {}
+
+  inline void setResponseSink(ResponseSink *) {}
+
+  inline const bool unsubscribeFromRPC()
+  {
+    return true;
+  }
+
+  inline bool isRPCMessage(const char *const)
+  {
+    return false;
+  }
+
+  inline bool isRPCResponseMessage(const char *const)
+  {
+    return false;
+  }
+
+  inline const RPCRequestHandle RPCRequest(const char *, const JsonVariantConst &, const RPCRequestCallback &)
+  {
+    const RPCRequestHandle invalid = {0U};
+    return invalid;
+  }
+
+  inline void cancelRPCRequest(const RPCRequestHandle &) {}
+
+  inline void processRPCResponseMessage(char *, uint8_t *, uint32_t) {}
+
+  inline void checkRPCRequestTimeouts() {}
+
+  inline const bool unsubscribeFromRPCResponses()
+  {
+    return true;
+  }
+
+  inline void processRPCMessage(char *, uint8_t *, uint32_t) {}
+
+  template <class InputIterator>
+  inline const bool RPCSubscribe(const InputIterator &, const InputIterator &)
+  {
+    return false;
+  }
+
+  inline const bool RPCSubscribe(const RPCCallback &)
+  {
+    return false;
+  }
+
+  inline const bool RPCUnsubscribe()
+  {
+    return true;
+  }
+};
+
+// Stand-in for the shared attribute module.
+class NullAttribute
+{
+
+public:
+  template <typename... Args>
+  inline NullAttribute(const Args &...) {}
+
+  inline void setOutboundSink(OutboundSink *) {}
+
+  inline bool isAttributeMessage(const char *const)
+  {
+    return false;
+  }
+
+  inline bool isAttributeResponseMessage(const char *const)
+  {
+    return false;
+  }
+
+  inline void processSharedAttributeUpdateMessage(char *, uint8_t *, uint32_t, const AttributeCallbackSelection = ALL_CALLBACKS) {}
+
+  inline const bool hasNetworkTaskCallbacks() const
+  {
+    return false;
+  }
+
+  inline void processSharedAttributeRequestMessage(char *, uint8_t *, uint32_t) {}
+
+  template <class InputIterator>
+  inline const bool sharedAttributesRequest(const InputIterator &, const InputIterator &, SharedAttributeRequestCallback &)
+  {
+    return false;
+  }
+
+  template <class InputIterator>
+  inline const bool sharedAttributesSubscribe(const InputIterator &, const InputIterator &)
+  {
+    return false;
+  }
+
+  inline const bool sharedAttributesSubscribe(const SharedAttributeCallback &)
+  {
+    return false;
+  }
+
+  inline const bool flushSharedAttributesRequests()
+  {
+    return true;
+  }
+
+  inline void cancelSharedAttributesRequest(const SharedAttributeRequestCallback &) {}
+
+  inline void checkSharedAttributesRequestTimeouts() {}
+
+  inline void setSharedAttributesRequestCacheTTL(const uint32_t) {}
+
+  inline const bool unsubscribeFromSharedAttribute()
+  {
+    return true;
+  }
+
+  inline const bool unsubscribeFromSharedAttributeRequest()
+  {
+    return true;
+  }
+
+  inline const bool enableMirror(PersistentStorage *)
+  {
+    return false;
+  }
+
+  inline void disableMirror() {}
+
+  inline const bool mirrorEnabled() const
+  {
+    return false;
+  }
+
+  inline void invalidateRequestCache() {}
+
+  inline const bool reconcileMirror()
+  {
+    return true;
+  }
+};
+
+// Stand-in for the provisioning module.
+class NullProvisioning
+{
+
+public:
+  template <typename... Args>
+  inline NullProvisioning(const Args &...) {}
+
+  inline bool isProvisionResponseTopic(const char *const)
+  {
+    return false;
+  }
+
+  inline const bool sendProvisionRequest(const char *, const char *, const char *)
+  {
+    return false;
+  }
+
+  inline const bool provisionSubscribe(const ProvisionCallback)
+  {
+    return false;
+  }
+
+  inline const bool unsubscribeFromProvisioning()
+  {
+    return true;
+  }
+
+  inline void processProvisioningResponseMessage(char *, uint8_t *, uint32_t) {}
+};
+
+// Stand-in for the firmware update module.
+class NullFirmware
+{
+
+public:
+  template <typename... Args>
+  inline NullFirmware(const Args &...) {}
+
+  inline void setOutboundSink(OutboundSink *) {}
+
+  inline bool isFirmwareResponseTopic(const char *const)
+  {
+    return false;
+  }
+
+  inline void processFirmwareResponseMessage(char *, uint8_t *, uint32_t) {}
+
+  inline void setFirmwareWriter(FirmwareWriter *) {}
+
+  inline void setWriteBehind(FirmwareWriteBehind *) {}
+
+  inline const bool startFirmwareUpdate(const char *, const char *, const FirmwareUpdateCallback &)
+  {
+    return false;
+  }
+
+  inline const bool resendFirmwareInfo()
+  {
+    return true;
+  }
+
+  inline const bool unsubscribeFromOTAFirmware()
+  {
+    return true;
+  }
+};
+
+// Stand-in for the gateway module.
+class NullGateway
+{
+
+public:
+  template <typename... Args>
+  inline NullGateway(const Args &...) {}
+
+  inline void setOutboundSink(OutboundSink *) {}
+
+  inline void setResponseSink(ResponseSink *) {}
+
+  inline bool isGatewayRPCMessage(const char *const)
+  {
+    return false;
+  }
+
+  inline bool isGatewayAttributeMessage(const char *const)
+  {
+    return false;
+  }
+
+  inline void processGatewayRPCMessage(char *, uint8_t *, uint32_t) {}
+
+  inline void processGatewayAttributeMessage(char *, uint8_t *, uint32_t) {}
+
+  inline const char *gatewayDevice() const
+  {
+    return nullptr;
+  }
+
+  inline const bool isDeviceConnected(const char *) const
+  {
+    return false;
+  }
+
+  inline const bool connectDevice(const char *, const char *)
+  {
+    return false;
+  }
+
+  inline const bool disconnectDevice(const char *)
+  {
+    return false;
+  }
+
+  inline const bool reconnectDevices()
+  {
+    return true;
+  }
+
+  inline void clear() {}
+
+  inline const bool gatewayRPCSubscribe(const char *, const RPCCallback &)
+  {
+    return false;
+  }
+
+  inline const bool unsubscribeFromGatewayRPC()
+  {
+    return true;
+  }
+
+  inline const bool gatewaySharedAttributesSubscribe(const char *, const SharedAttributeCallback &)
+  {
+    return false;
+  }
+
+  inline const bool unsubscribeFromGatewaySharedAttributes()
+  {
+    return true;
+  }
+
+  inline const size_t serializeTelemetry(const GatewayDeviceValues *, const size_t, char *, const size_t)
+  {
+    return 0U;
+  }
+
+  inline const size_t serializeAttributes(const GatewayDeviceValues *, const size_t, char *, const size_t)
+  {
+    return 0U;
+  }
+};
+
+// Stand-in for the queue of data sent while disconnected, nothing is ever queued.
+class NullOutboundQueue
+{
+
+public:
+  using Message = OutboundMessage<1U>;
+
+  inline const bool empty() const
+  {
+    return true;
+  }
+
+  inline const size_t size() const
+  {
+    return 0U;
+  }
+
+  inline const uint32_t droppedMessages() const
+  {
+    return 0U;
+  }
+
+  inline const bool push(const char *, const char *, const size_t)
+  {
+    return false;
+  }
+
+  // Never called, because the queue is always empty.
+  inline const Message &front() const
+  {
+    return none;
+  }
+
+  inline const Message &at(const size_t) const
+  {
+    return none;
+  }
+
+  inline void pop() {}
+
+  inline void clear() {}
+
+private:
+  Message none = {};
+};
+
+// Stand-in for the state of a duty cycled session, the duty cycle API needs the offline queue.
+struct NullDutyCycleState
+{
+};
+
+// Stand-in for the telemetry filter, every value is sent.
+class NullTelemetryFilter
+{
+
+public:
+  inline const bool add(const char *, const TelemetryFilterConfig &)
+  {
+    return false;
+  }
+
+  inline const bool remove(const char *)
+  {
+    return false;
+  }
+
+  inline const uint32_t suppressed() const
+  {
+    return 0U;
+  }
+
+  inline const bool filter(const Telemetry &, const uint32_t)
+  {
+    return true;
+  }
+
+  inline void markSent(const Telemetry &, const uint32_t) {}
+};
+
+// Stand-in for the telemetry aggregation, every sample is sent on its own.
+class NullTelemetryAggregator
+{
+
+public:
+  inline const bool add(const char *, const uint32_t)
+  {
+    return false;
+  }
+
+  inline const bool remove(const char *)
+  {
+    return false;
+  }
+
+  template <typename Emitter>
+  inline const bool sample(const Telemetry &, const uint32_t, Emitter)
+  {
+    return false;
+  }
+
+  template <typename Emitter>
+  inline void flush(const uint32_t, Emitter) {}
+};
+
+#if defined(ESP8266) || defined(ESP32)
+
+// Stand-in for the queues between tasks, nothing can be pushed.
+template <typename Message>
+class NullProducerQueue
+{
+
+public:
+  template <typename... Fields>
+  inline const bool tryPush(const char *, const char *, const size_t, const Fields &...)
+  {
+    return false;
+  }
+
+  inline Message *front()
+  {
+    return nullptr;
+  }
+
+  inline void pop() {}
+
+  inline const uint32_t contention() const
+  {
+    return 0U;
+  }
+
+  inline const uint32_t droppedMessages() const
+  {
+    return 0U;
+  }
+};
+
+// Stand-in for the outbound scheduler, every message is admitted right away without any rate limit.
+class NullOutboundScheduler
+{
+
+public:
+  inline void setRateLimit(const MessagePriority, const uint16_t, const uint32_t, const uint32_t) {}
+
+  inline const bool admit(const MessagePriority, const uint32_t)
+  {
+    return true;
+  }
+
+  inline void giveBack(const MessagePriority) {}
+
+  inline const bool push(const MessagePriority, const char *, const char *, const size_t)
+  {
+    return false;
+  }
+
+  template <typename Publish>
+  inline void drain(const uint32_t, Publish) {}
+
+  template <typename Take>
+  inline void release(Take) {}
+
+  inline const bool empty() const
+  {
+    return true;
+  }
+
+  inline const size_t size(const MessagePriority) const
+  {
+    return 0U;
+  }
+
+  inline const uint32_t droppedMessages(const MessagePriority) const
+  {
+    return 0U;
+  }
+
+  inline void clear() {}
+};
+
+#endif // defined(ESP8266) || defined(ESP32)
+
+#endif // FEATURES_H
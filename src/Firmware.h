@@ -3,16 +3,19 @@
 
 #include "Base.h"
 #include "Attribute.h"
+#include <array>
+#include <limits>
 
-#if defined(ESP8266)
-#include <Updater.h>
-#elif defined(ESP32)
-#include <Update.h>
+#include "FirmwareWriter.h"
+
+#if defined(ESP8266) || defined(ESP32)
 #include <MD5Builder.h>
 #endif
 
 constexpr char *FIRMWARE_RESPONSE_TOPIC PROGMEM = "v2/fw/response";
 
+using FirmwareUpdateCallback = InplaceFunction<void(const bool &)>;
+
 #if defined(ESP8266) || defined(ESP32) || !defined(ARDUINO_AVR_MEGA)
 constexpr char *FIRMWARE_RESPONSE_SUBSCRIBE_TOPIC PROGMEM = "v2/fw/response/#";
 constexpr char *FIRMWARE_REQUEST_TOPIC PROGMEM = "v2/fw/request/0/chunk/%u";
@@ -36,20 +39,33 @@ constexpr char *FIRMWARE_STATE_DOWNLOADING PROGMEM = "DOWNLOADING";
 constexpr char *FIRMWARE_STATE_FAILED PROGMEM = "FAILED";
 constexpr char *FIRMWARE_STATE_UPDATE_ERROR PROGMEM = "UPDATE ERROR";
 constexpr char *FIRMWARE_STATE_CHECKSUM_ERROR PROGMEM = "CHECKSUM ERROR";
+
+// Longest firmware title and version that can be received, longer ones are rejected, because they could not be compared safely.
+#ifndef MAX_FIRMWARE_TITLE_LENGTH
+#define MAX_FIRMWARE_TITLE_LENGTH 32U
+#endif
+#ifndef MAX_FIRMWARE_VERSION_LENGTH
+#define MAX_FIRMWARE_VERSION_LENGTH 32U
+#endif
+#define MD5_CHECKSUM_LENGTH 32U
 #endif // defined(ESP8266) || defined(ESP32) || !defined(ARDUINO_AVR_MEGA)
 
 template <
     size_t PayloadSize,
-    size_t MaxFieldsElement,
-    typename Logger = Logger>
+    typename Capacities,
+    typename Logger = Logger,
+    typename Encoding = JsonEncoding>
 class FirmwareTemplate : public Base
 {
 
 public:
-  inline FirmwareTemplate(PubSubClient *mqttClient, bool *enableQos, AttributeTemplate<PayloadSize, MaxFieldsElement, Logger> *attribute)
-      : Base(mqttClient, enableQos)
+  inline FirmwareTemplate(PubSubClient *mqttClient, bool *enableQos, SubscriptionRegistry *subscriptions, AttributeTemplate<PayloadSize, Capacities, Logger, Encoding> *attribute)
+      : Base(mqttClient, enableQos, subscriptions)
   {
     this->attribute = attribute;
+#if defined(ESP8266) || defined(ESP32)
+    this->writer = &this->updateWriter;
+#endif
   }
 
   inline bool isFirmwareResponseTopic(const char *const topic)
@@ -61,88 +77,46 @@ public:
 
   inline void processFirmwareResponseMessage(char *topic, uint8_t *payload, uint32_t length)
   {
-    static uint32_t sizeReceive = 0;
-    static MD5Builder md5;
-    uint16_t chunReceive = atoi(strrchr(topic, SLASH) + 1U);
-    if (this->firmwareChunkProcessed > chunReceive + 1)
-    {
-      return;
-    }
-    this->firmwareChunkReceive = chunReceive;
-
-    char message[detectSizeOf(FIRMWARE_CHUNK, firmwareChunkReceive, length)];
-    snprintf_P(message, sizeof(message), FIRMWARE_CHUNK, this->firmwareChunkReceive, length);
-    Logger::log(message);
-
-    if (strncmp_P(this->firmwareState.c_str(), FIRMWARE_STATE_DOWNLOADING, strlen(FIRMWARE_STATE_DOWNLOADING)) != 0)
-    {
-      this->firmwareState = FIRMWARE_STATE_DOWNLOADING;
-    }
+    const uint16_t chunkReceive = atoi(strrchr(topic, SLASH) + 1U);
+    Logger::log(LogMessage(FIRMWARE_CHUNK, chunkReceive, length).c_str());
 
-    if (this->firmwareChunkReceive == 0)
+    // Only copied here, the download loop writes the chunk once every chunk before it has been written.
+    if (this->writeBehind != nullptr)
     {
-      sizeReceive = 0;
-      md5 = MD5Builder();
-      md5.begin();
-      if (!Update.begin(this->firmwareSize))
+      if (chunkReceive >= this->firmwareChunkProcessed && chunkReceive < this->firmwareChunkRequested && !(*this->writeBehind).stage(chunkReceive, payload, length))
       {
-        Logger::log(ERROR_UPDATE_BEGIN);
-        Update.printError(Serial);
-        this->firmwareState = FIRMWARE_STATE_UPDATE_ERROR;
-        return;
+        Logger::log(FIRMWARE_CHUNK_NOT_STAGED);
       }
+      return;
     }
 
-    if (Update.write(payload, length) != length)
+    if (this->firmwareChunkProcessed > chunkReceive + 1)
     {
-      Logger::log(ERROR_UPDATE_WITE);
-      Update.printError(Serial);
-      this->firmwareState = FIRMWARE_STATE_UPDATE_ERROR;
       return;
     }
+    this->firmwareChunkReceive = chunkReceive;
+    writeChunk(chunkReceive, payload, length);
+  }
 
-    md5.add(payload, length);
-    sizeReceive += length;
-    this->firmwareChunkProcessed++;
-    if (this->firmwareSize == sizeReceive)
-    {
-      md5.calculate();
-      String md5Str = md5.toString();
-      char actual[JSON_STRING_SIZE(strlen(MD5_ACTUAL)) + md5Str.length()];
-      snprintf_P(actual, sizeof(actual), MD5_ACTUAL, md5Str.c_str());
-      Logger::log(actual);
-
-      char expected[JSON_STRING_SIZE(strlen(MD5_EXPECTED)) + JSON_STRING_SIZE(strlen(this->firmwareChecksum.c_str()))];
-      snprintf_P(expected, sizeof(expected), MD5_EXPECTED, this->firmwareChecksum.c_str());
-      Logger::log(expected);
+  // Image is written with the given writer instead of the Update library, nullptr restores the Update library.
+  inline void setFirmwareWriter(FirmwareWriter *writer)
+  {
+    this->writer = (writer != nullptr) ? writer : &this->updateWriter;
+  }
 
-      if (strncmp(md5Str.c_str(), this->firmwareChecksum.c_str(), md5Str.length()) != 0)
-      {
-        Logger::log(CHECKSUM_VERIFICATION_FAILED);
-#if defined(ESP32)
-        Update.abort();
-#endif
-        this->firmwareState = FIRMWARE_STATE_CHECKSUM_ERROR;
-        return;
-      }
-      else
-      {
-        Logger::log(CHECKSUM_VERIFICATION_SUCCESS);
-        if (Update.end())
-        {
-          Logger::log(FIRMWARE_UPDATE_SUCCESS);
-          this->firmwareState = STATUS_SUCCESS;
-          return;
-        }
-      }
-    }
+  // Received chunks are buffered and written while the next chunks are received, nullptr writes every chunk right away again.
+  inline void setWriteBehind(FirmwareWriteBehind *writeBehind)
+  {
+    this->writeBehind = writeBehind;
   }
 
-  inline const bool startFirmwareUpdate(const char *currFwTitle, const char *currFwVersion, const std::function<void(const bool &)> &updatedCallback)
+  inline const bool startFirmwareUpdate(const char *currFwTitle, const char *currFwVersion, const FirmwareUpdateCallback &updatedCallback)
   {
     if (this->registered == true)
     {
-      return this->registered;
+      // Only the callback is replaced, the assigned firmware is requested again so the new callback learns the outcome as well.
+      this->firmwareUpdatedCallbackFunction = updatedCallback;
+      return requestFirmwareInfo();
     }
 
     if (currFwTitle == nullptr || currFwVersion == nullptr)
@@ -159,30 +133,44 @@ public:
       return false;
     }
 
-    const std::array<const char *, 5U> fwSharedKeys{FIRMWARE_CHECKSUM_KEY, FIRMWARE_CHECKSUM_ALGO_KEY, FIRMWARE_SIZE_KEY, FIRMWARE_TITLE_KEY, FIRMWARE_VERSION_KEY};
+    constexpr std::array<InternedKey, 5U> fwSharedKeys = firmwareKeys();
 
-    SharedAttributeCallback sharedReqCallback(fwSharedKeys.cbegin(), fwSharedKeys.cend(), std::bind(&FirmwareTemplate::firmwareSharedAttributeReceived, this, std::placeholders::_1));
+    SharedAttributeCallback sharedReqCallback(fwSharedKeys.cbegin(), fwSharedKeys.cend(), [this](const SharedAttributeData &data)
+                                              { this->firmwareSharedAttributeReceived(data); });
+    // The download blocks while it requests chunks and loops the client, so it has to run on the network task even when dispatching.
+    sharedReqCallback.networkTask = true;
 
-    if (!(*attribute).sharedAttributesSubscribe(sharedReqCallback))
-    {
-      return false;
-    }
-
-    // Set private members needed for update.
+    // Set private members needed for update, before subscribing because the attribute mirror calls the callback right away.
     this->currentFirmwareTitle = currFwTitle;
     this->currentFirmwareVersion = currFwVersion;
     this->firmwareUpdatedCallbackFunction = updatedCallback;
-    this->registered = true;
     if (!firmwareSendState(FIRMWARE_STATE_READY))
     {
       return false;
     }
-    return true;
+
+    if (!(*attribute).sharedAttributesSubscribe(sharedReqCallback))
+    {
+      return false;
+    }
+    this->registered = true;
+    // The server only sends changes of the assigned firmware, the mirror requests the current one itself when subscribing.
+    return (*attribute).mirrorEnabled() || requestFirmwareInfo();
+  }
+
+  // Sends the current firmware info again, needed after reconnecting because the server does not keep it for the new session.
+  inline const bool resendFirmwareInfo()
+  {
+    if (this->registered == false)
+    {
+      return true;
+    }
+    return firmwareSendFirmwareInfo(this->currentFirmwareTitle, this->currentFirmwareVersion);
   }
 
   inline const bool unsubscribeFromOTAFirmware()
   {
-    if (!(*mqttClient).unsubscribe(FIRMWARE_RESPONSE_SUBSCRIBE_TOPIC))
+    if (!(*subscriptions).unsubscribe(FIRMWARE_RESPONSE_SUBSCRIBE_TOPIC))
     {
       return false;
     }
@@ -194,28 +182,151 @@ public:
 
 private:
 #if defined(ESP8266) || defined(ESP32)
-  AttributeTemplate<PayloadSize, MaxFieldsElement, Logger> *attribute;
+  enum downloadState
+  {
+    IDLE,
+    DOWNLOADING,
+    SUCCESS,
+    UPDATE_ERROR,
+    CHECKSUM_ERROR,
+  };
+
+  AttributeTemplate<PayloadSize, Capacities, Logger, Encoding> *attribute;
   const char *currentFirmwareTitle;
-  String targetFirmwareTitle;
+  char targetFirmwareTitle[MAX_FIRMWARE_TITLE_LENGTH + 1U];
   const char *currentFirmwareVersion;
-  String targetFirmwareVersion;
-  String firmwareState;
+  char targetFirmwareVersion[MAX_FIRMWARE_VERSION_LENGTH + 1U];
+  // Title and version of the image written by the last successful update, the target buffers are overwritten by the next announcement.
+  char installedFirmwareTitle[MAX_FIRMWARE_TITLE_LENGTH + 1U];
+  char installedFirmwareVersion[MAX_FIRMWARE_VERSION_LENGTH + 1U];
+  downloadState firmwareState = IDLE;
   bool registered = false;
   uint32_t firmwareSize;
-  String firmwareChecksum;
-  std::function<void(const bool &)> firmwareUpdatedCallbackFunction;
-  uint16_t firmwareChunkReceive = std::numeric_limits<int>::max();
+  char firmwareChecksum[MD5_CHECKSUM_LENGTH + 1U];
+  FirmwareUpdateCallback firmwareUpdatedCallbackFunction;
+  uint16_t firmwareChunkReceive = std::numeric_limits<uint16_t>::max();
   uint16_t firmwareChunkProcessed = 0;
+  uint16_t firmwareChunkRequested = 0;
+  uint32_t sizeReceive = 0;
+  MD5Builder md5;
+  UpdateWriter updateWriter;
+  FirmwareWriter *writer;
+  FirmwareWriteBehind *writeBehind = nullptr;
+
+  // Writes the chunk into the image and verifies the checksum once the last chunk has been written.
+  inline void writeChunk(const uint16_t chunk, uint8_t *data, const uint32_t length)
+  {
+    this->firmwareState = DOWNLOADING;
+
+    if (chunk == 0)
+    {
+      this->sizeReceive = 0;
+      this->md5 = MD5Builder();
+      this->md5.begin();
+      if (!(*this->writer).begin(this->firmwareSize))
+      {
+        Logger::log(ERROR_UPDATE_BEGIN);
+        (*this->writer).printError();
+        this->firmwareState = UPDATE_ERROR;
+        return;
+      }
+    }
+
+    if ((*this->writer).write(data, length) != length)
+    {
+      Logger::log(ERROR_UPDATE_WITE);
+      (*this->writer).printError();
+      this->firmwareState = UPDATE_ERROR;
+      return;
+    }
+
+    this->md5.add(data, length);
+    this->sizeReceive += length;
+    this->firmwareChunkProcessed++;
+    if (this->firmwareSize == this->sizeReceive)
+    {
+      this->md5.calculate();
+      char md5Str[MD5_CHECKSUM_LENGTH + 1U];
+      this->md5.getChars(md5Str);
+      Logger::log(LogMessage(MD5_ACTUAL, md5Str).c_str());
+
+      Logger::log(LogMessage(MD5_EXPECTED, this->firmwareChecksum).c_str());
+
+      if (strncmp(md5Str, this->firmwareChecksum, MD5_CHECKSUM_LENGTH) != 0)
+      {
+        Logger::log(CHECKSUM_VERIFICATION_FAILED);
+        (*this->writer).abort();
+        this->firmwareState = CHECKSUM_ERROR;
+        return;
+      }
+      else
+      {
+        Logger::log(CHECKSUM_VERIFICATION_SUCCESS);
+        if ((*this->writer).end())
+        {
+          Logger::log(FIRMWARE_UPDATE_SUCCESS);
+          this->firmwareState = SUCCESS;
+          return;
+        }
+      }
+    }
+  }
+
+  static constexpr std::array<InternedKey, 5U> firmwareKeys()
+  {
+    return {{FIRMWARE_CHECKSUM_KEY, FIRMWARE_CHECKSUM_ALGO_KEY, FIRMWARE_SIZE_KEY, FIRMWARE_TITLE_KEY, FIRMWARE_VERSION_KEY}};
+  }
+
+  // Requests the assigned firmware, the response is handled like an update of the firmware keys.
+  inline const bool requestFirmwareInfo()
+  {
+    const std::array<InternedKey, 5U> fwSharedKeys = firmwareKeys();
+    SharedAttributeRequestCallback request([this](const SharedAttributeData &data)
+                                           { this->firmwareSharedAttributeReceived(data); },
+                                           [this]()
+                                           { this->notifyUpdated(false); });
+    return (*attribute).sharedAttributesRequest(fwSharedKeys.cbegin(), fwSharedKeys.cend(), request);
+  }
+
+  // Reports the final state of an update check to the server and to the updated callback, so every check ends with one call of it.
+  inline void finishUpdate(const char *state, const bool success)
+  {
+    firmwareSendState(state);
+    notifyUpdated(success);
+  }
+
+  inline void notifyUpdated(const bool success)
+  {
+    if (this->firmwareUpdatedCallbackFunction != nullptr)
+    {
+      this->firmwareUpdatedCallbackFunction(success);
+    }
+  }
+
+  // Published around the outbound scheduler, because the download loop only loops the client and a request held back by a rate limit
+  // would never be sent. The download paces the requests itself.
+  inline const bool requestChunk(const uint16_t chunk, const uint16_t chunkSize)
+  {
+    const FormattedTopic topic(FIRMWARE_REQUEST_TOPIC, chunk);
+    const FormatBuffer<MAX_UNSIGNED_DIGITS + 1U> size(NUMBER_PRINTF, chunkSize);
+    return (*mqttClient).publish(topic.c_str(), reinterpret_cast<const uint8_t *>(size.c_str()), size.size(), (*mqttQoS));
+  }
+
+  inline const bool chunkReceived(const uint16_t chunk)
+  {
+    if (this->writeBehind != nullptr)
+    {
+      return (*this->writeBehind).find(chunk) != nullptr;
+    }
+    return this->firmwareChunkReceive == chunk;
+  }
 
   inline const bool firmwareSendFirmwareInfo(const char *currFwTitle, const char *currFwVersion)
   {
     StaticJsonDocument<JSON_OBJECT_SIZE(2)> currentFirmwareInfo;
     JsonObject currentFirmwareInfoObject = currentFirmwareInfo.to<JsonObject>();
-    String title = CURRENT_FIRMWARE_TITLE_KEY;
-    String version = CURRENT_FIRMWARE_VERSION_KEY;
-
-    currentFirmwareInfoObject[title.c_str()] = currFwTitle;
-    currentFirmwareInfoObject[version.c_str()] = currFwVersion;
+    currentFirmwareInfoObject[static_cast<const char *>(CURRENT_FIRMWARE_TITLE_KEY)] = currFwTitle;
+    currentFirmwareInfoObject[static_cast<const char *>(CURRENT_FIRMWARE_VERSION_KEY)] = currFwVersion;
 
     return sendTelemetryJson(currentFirmwareInfoObject);
   }
@@ -224,16 +335,14 @@ private:
   {
     StaticJsonDocument<JSON_OBJECT_SIZE(1)> currentFirmwareState;
     JsonObject currentFirmwareStateObject = currentFirmwareState.to<JsonObject>();
-
-    String state = CURRENT_FIRMWARE_STATE_KEY;
-    currentFirmwareStateObject[state.c_str()] = currFwState;
+    currentFirmwareStateObject[static_cast<const char *>(CURRENT_FIRMWARE_STATE_KEY)] = currFwState;
 
     return sendTelemetryJson(currentFirmwareStateObject);
   }
 
   inline const bool firmwareOTASubscribe()
   {
-    if (!(*mqttClient).subscribe(FIRMWARE_RESPONSE_SUBSCRIBE_TOPIC, (*mqttQoS) ? 1 : 0))
+    if (!(*subscriptions).subscribe(FIRMWARE_RESPONSE_SUBSCRIBE_TOPIC))
     {
       return false;
     }
@@ -246,34 +355,39 @@ private:
     if (!data.containsKey(FIRMWARE_VERSION_KEY) || !data.containsKey(FIRMWARE_TITLE_KEY))
     {
       Logger::log(NO_FIRMWARE);
-      firmwareSendState(FIRMWARE_STATE_NO_FIRMWARE);
+      finishUpdate(FIRMWARE_STATE_NO_FIRMWARE, false);
       return;
     }
 
-    this->targetFirmwareTitle = data[FIRMWARE_TITLE_KEY].as<const char *>();
-    this->targetFirmwareVersion = data[FIRMWARE_VERSION_KEY].as<const char *>();
-    this->firmwareChecksum = data[FIRMWARE_CHECKSUM_KEY].as<const char *>();
+    if (!copyValue(this->targetFirmwareTitle, data[FIRMWARE_TITLE_KEY].as<const char *>()) ||
+        !copyValue(this->targetFirmwareVersion, data[FIRMWARE_VERSION_KEY].as<const char *>()) ||
+        !copyValue(this->firmwareChecksum, data[FIRMWARE_CHECKSUM_KEY].as<const char *>()))
+    {
+      Logger::log(FIRMWARE_INFO_TOO_LONG);
+      finishUpdate(FIRMWARE_STATE_FAILED, false);
+      return;
+    }
     this->firmwareSize = data[FIRMWARE_SIZE_KEY].as<const uint32_t>();
     const char *fw_checksum_algorithm = data[FIRMWARE_CHECKSUM_ALGO_KEY].as<const char *>();
 
-    if (strncmp_P(this->currentFirmwareTitle, this->targetFirmwareTitle.c_str(), strlen(this->currentFirmwareTitle)) == 0 && strncmp_P(this->currentFirmwareVersion, this->targetFirmwareVersion.c_str(), strlen(this->currentFirmwareVersion)) == 0)
+    if (strncmp_P(this->currentFirmwareTitle, this->targetFirmwareTitle, strlen(this->currentFirmwareTitle)) == 0 && strncmp_P(this->currentFirmwareVersion, this->targetFirmwareVersion, strlen(this->currentFirmwareVersion)) == 0)
     {
       Logger::log(FIRMWARE_UP_TO_DATE);
-      firmwareSendState(FIRMWARE_STATE_UP_TO_DATE);
+      finishUpdate(FIRMWARE_STATE_UP_TO_DATE, false);
       return;
     }
 
-    if (strncmp_P(this->currentFirmwareTitle, this->targetFirmwareTitle.c_str(), strlen(this->currentFirmwareTitle)) != 0)
+    if (strncmp_P(this->currentFirmwareTitle, this->targetFirmwareTitle, strlen(this->currentFirmwareTitle)) != 0)
     {
       Logger::log(FIRMWARE_NOT_FOR_US);
-      firmwareSendState(FIRMWARE_STATE_NO_FIRMWARE);
+      finishUpdate(FIRMWARE_STATE_NO_FIRMWARE, false);
       return;
     }
 
     if (strncmp_P(fw_checksum_algorithm, FIRMWARE_CHECKSUM_VALUE, strlen(FIRMWARE_CHECKSUM_VALUE)) != 0)
     {
       Logger::log(FIRMWARE_CHECKSUM_ALGO_NOT_SUPPORTED);
-      firmwareSendState(FIRMWARE_STATE_INVALID_CHECKSUM);
+      finishUpdate(FIRMWARE_STATE_INVALID_CHECKSUM, false);
       return;
     }
 
@@ -281,14 +395,19 @@ private:
 
     Logger::log(PAGE_BREAK);
     Logger::log(NEW_FIRMWARE);
-    char firmware[JSON_STRING_SIZE(strlen(FROM_TOO)) + JSON_STRING_SIZE(strlen(this->currentFirmwareVersion)) + JSON_STRING_SIZE(strlen(this->targetFirmwareVersion.c_str()))];
-    snprintf_P(firmware, sizeof(firmware), FROM_TOO, this->currentFirmwareVersion, this->targetFirmwareVersion.c_str());
-    Logger::log(firmware);
+    Logger::log(LogMessage(FROM_TOO, this->currentFirmwareVersion, this->targetFirmwareVersion).c_str());
     Logger::log(DOWNLOADING_FIRMWARE);
 
-    const uint16_t chunkSize = 4096U; // maybe less if we don't have enough RAM
+    const uint16_t chunkSize = FIRMWARE_CHUNK_SIZE; // maybe less if we don't have enough RAM
     const uint16_t numberOfChunk = static_cast<uint16_t>(this->firmwareSize / chunkSize) + 1U;
-    this->firmwareChunkReceive = std::numeric_limits<int>::max();
+    this->firmwareChunkReceive = std::numeric_limits<uint16_t>::max();
+    this->firmwareChunkProcessed = 0U;
+    this->firmwareChunkRequested = 0U;
+    const uint16_t depth = (this->writeBehind != nullptr) ? (*this->writeBehind).depth() : 1U;
+    if (this->writeBehind != nullptr)
+    {
+      (*this->writeBehind).reset();
+    }
     uint16_t currChunk = 0U;
     uint8_t nbRetry = 5U;
 
@@ -299,36 +418,44 @@ private:
     if (changeBufferSize && !(*mqttClient).setBufferSize(chunkSize + 50U))
     {
       Logger::log(NOT_ENOUGH_RAM);
+      finishUpdate(FIRMWARE_STATE_FAILED, false);
       return;
     }
 
     firmwareSendState(FIRMWARE_STATE_DOWNLOADING);
-    this->firmwareState = FIRMWARE_STATE_DOWNLOADING;
-    char size[detectSizeOf(NUMBER_PRINTF, chunkSize)];
+    this->firmwareState = DOWNLOADING;
     do
     {
-      char topic[detectSizeOf(FIRMWARE_REQUEST_TOPIC, currChunk)]; // Size adjuts dynamically to the current length of the currChunk number to ensure we don't cut it out of the topic string.
-      snprintf_P(topic, sizeof(topic), FIRMWARE_REQUEST_TOPIC, currChunk);
-      snprintf_P(size, sizeof(size), NUMBER_PRINTF, chunkSize);
-
-      (*mqttClient).publish(topic, size, (*mqttQoS));
+      // With the write behind stage the following chunks are requested ahead, so they are received while the current one is written.
+      while (this->firmwareChunkRequested < numberOfChunk && this->firmwareChunkRequested < currChunk + depth)
+      {
+        if (!chunkReceived(this->firmwareChunkRequested))
+        {
+          requestChunk(this->firmwareChunkRequested, chunkSize);
+        }
+        this->firmwareChunkRequested++;
+      }
 
       const uint64_t timeout = millis() + 3000U; // Amount of time we wait until we declare the download as failed in milliseconds.
-      do
+      while (!chunkReceived(currChunk) && (timeout >= millis()))
       {
         delay(5);
-        // loop();
         (*mqttClient).loop();
+      }
 
-      } while ((this->firmwareChunkReceive != currChunk) && (timeout >= millis()));
-
-      if (this->firmwareChunkReceive == currChunk)
+      if (chunkReceived(currChunk))
       {
+        if (this->writeBehind != nullptr)
+        {
+          FirmwareChunk *chunk = (*this->writeBehind).find(currChunk);
+          writeChunk(currChunk, chunk->data, chunk->length);
+          (*this->writeBehind).release(chunk);
+        }
 
         if (numberOfChunk != (currChunk + 1))
         {
           // Check if state is still DOWNLOADING and did not fail.
-          if (strncmp_P(this->firmwareState.c_str(), FIRMWARE_STATE_DOWNLOADING, strlen(FIRMWARE_STATE_DOWNLOADING)) == 0)
+          if (this->firmwareState == DOWNLOADING)
           {
             currChunk++;
           }
@@ -340,6 +467,7 @@ private:
               Logger::log(UNABLE_TO_WRITE);
               break;
             }
+            this->firmwareChunkRequested = currChunk;
           }
         }
         // The last chunk
@@ -357,6 +485,7 @@ private:
           Logger::log(UNABLE_TO_DOWNLOAD);
           break;
         }
+        this->firmwareChunkRequested = currChunk;
       }
     } while (numberOfChunk != currChunk);
 
@@ -367,59 +496,51 @@ private:
     }
     // Unsubscribe from now not needed topics anymore.
     unsubscribeFromOTAFirmware();
-    bool success = false;
     // Update current_fw_title and current_fw_version if updating was a success.
-    if (strncmp_P(this->firmwareState.c_str(), STATUS_SUCCESS, strlen(STATUS_SUCCESS)) == 0)
+    if (this->firmwareState == SUCCESS)
     {
-      this->currentFirmwareTitle = this->targetFirmwareTitle.c_str();
-      this->currentFirmwareVersion = this->targetFirmwareVersion.c_str();
+      strcpy(this->installedFirmwareTitle, this->targetFirmwareTitle);
+      strcpy(this->installedFirmwareVersion, this->targetFirmwareVersion);
+      this->currentFirmwareTitle = this->installedFirmwareTitle;
+      this->currentFirmwareVersion = this->installedFirmwareVersion;
       firmwareSendFirmwareInfo(this->currentFirmwareTitle, this->currentFirmwareVersion);
-      firmwareSendState(STATUS_SUCCESS);
-      success = true;
+      finishUpdate(STATUS_SUCCESS, true);
     }
     else
     {
-      firmwareSendState(FIRMWARE_STATE_FAILED);
-    }
-
-    if (this->firmwareUpdatedCallbackFunction != nullptr)
-    {
-      this->firmwareUpdatedCallbackFunction(success);
+      finishUpdate(FIRMWARE_STATE_FAILED, false);
     }
   }
 
-  inline const bool sendTelemetryJsonChar(const char *json)
+  // Copies the received value into the fixed buffer, false if it is missing or does not fit.
+  template <size_t Size>
+  static inline const bool copyValue(char (&destination)[Size], const char *value)
   {
-    if (json == nullptr)
-    {
-      return false;
-    }
-
-    const uint32_t json_size = JSON_STRING_SIZE(strlen(json));
-    if (json_size > PayloadSize)
+    if (value == nullptr || strlen(value) >= Size)
     {
-      char message[detectSizeOf(INVALID_BUFFER_SIZE, PayloadSize, json_size)];
-      snprintf_P(message, sizeof(message), INVALID_BUFFER_SIZE, PayloadSize, json_size);
-      Logger::log(message);
       return false;
     }
-    return (*mqttClient).publish(TELEMETRY_TOPIC, json, this->mqttQoS);
+    memcpy(destination, value, strlen(value) + 1U);
+    return true;
   }
 
   inline const bool sendTelemetryJson(const JsonObject &jsonObject)
   {
     const uint32_t json_object_size = jsonObject.size();
-    if (MaxFieldsElement < json_object_size)
+    if (Capacities::outboundFields < json_object_size)
+    {
+      Logger::log(LogMessage(TOO_MANY_JSON_FIELDS, json_object_size, Capacities::outboundFields).c_str());
+      return false;
+    }
+    const uint32_t json_size = JSON_STRING_SIZE(Encoding::measure(jsonObject));
+    if (json_size > PayloadSize)
     {
-      char message[detectSizeOf(TOO_MANY_JSON_FIELDS, json_object_size, MaxFieldsElement)];
-      snprintf_P(message, sizeof(message), TOO_MANY_JSON_FIELDS, json_object_size, MaxFieldsElement);
-      Logger::log(message);
+      Logger::log(LogMessage(INVALID_BUFFER_SIZE, PayloadSize, json_size).c_str());
       return false;
     }
-    const uint32_t json_size = JSON_STRING_SIZE(measureJson(jsonObject));
-    char json[json_size];
-    serializeJson(jsonObject, json, json_size);
-    return sendTelemetryJsonChar(json);
+    char json[PayloadSize];
+    const size_t length = Encoding::serialize(jsonObject, json, sizeof(json));
+    return publish(TELEMETRY_TOPIC, json, length, PRIORITY_FIRMWARE);
   }
 
 #endif // defined(ESP8266) || defined(ESP32)
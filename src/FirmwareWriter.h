@@ -0,0 +1,170 @@
+#ifndef FIRMWARE_WRITER_H
+#define FIRMWARE_WRITER_H
+
+#include "Arduino.h"
+
+#if defined(ESP8266)
+#include <Updater.h>
+#elif defined(ESP32)
+#include <Update.h>
+#endif
+
+#define FIRMWARE_CHUNK_SIZE 4096U
+#define DEFAULT_FIRMWARE_WRITE_BUFFERS 2
+
+// Destination of the downloaded firmware image, implement it to write the image somewhere else than the OTA partition,
+// for example into a file when testing the download on a host.
+class FirmwareWriter
+{
+
+public:
+  virtual ~FirmwareWriter() {}
+
+  virtual bool begin(size_t size) = 0;
+
+  // Returns the amount of written bytes, anything less than the length is treated as an error.
+  virtual size_t write(uint8_t *data, size_t length) = 0;
+
+  virtual bool end() = 0;
+
+  virtual void abort() = 0;
+
+  // Prints the reason of the last failure.
+  virtual void printError() = 0;
+};
+
+#if defined(ESP8266) || defined(ESP32)
+
+// Writes the image into the OTA partition with the Update library of the core.
+class UpdateWriter : public FirmwareWriter
+{
+
+public:
+  bool begin(size_t size) override
+  {
+    return Update.begin(size);
+  }
+
+  size_t write(uint8_t *data, size_t length) override
+  {
+    return Update.write(data, length);
+  }
+
+  bool end() override
+  {
+    return Update.end();
+  }
+
+  void abort() override
+  {
+#if defined(ESP32)
+    Update.abort();
+#endif
+  }
+
+  void printError() override
+  {
+    Update.printError(Serial);
+  }
+};
+
+#endif // defined(ESP8266) || defined(ESP32)
+
+// Chunk that was received, but is not written yet. The data is word aligned, because flash is programmed in words.
+struct FirmwareChunk
+{
+  alignas(4) uint8_t data[FIRMWARE_CHUNK_SIZE];
+  uint16_t length;
+  uint16_t index;
+  bool staged;
+};
+
+// Buffers received chunks, so the next chunks can already be requested and received while the previous one is written to flash.
+class FirmwareWriteBehind
+{
+
+public:
+  inline FirmwareWriteBehind(FirmwareChunk *chunks, const size_t count)
+      : chunks(chunks), count(count)
+  {
+  }
+
+  // Amount of chunks that may be requested ahead of the one that is written next.
+  inline const size_t depth() const
+  {
+    return count;
+  }
+
+  // Called before every download, the buffers are not initialized before.
+  inline void reset()
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      chunks[i].staged = false;
+    }
+  }
+
+  // Copies the chunk into a free buffer, chunks that are already staged are skipped. Returns false if every buffer is in use.
+  inline const bool stage(const uint16_t index, const uint8_t *data, const size_t length)
+  {
+    if (length > FIRMWARE_CHUNK_SIZE)
+    {
+      return false;
+    }
+    else if (find(index) != nullptr)
+    {
+      return true;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+      if (!chunks[i].staged)
+      {
+        memcpy(chunks[i].data, data, length);
+        chunks[i].length = length;
+        chunks[i].index = index;
+        chunks[i].staged = true;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  inline FirmwareChunk *find(const uint16_t index)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      if (chunks[i].staged && chunks[i].index == index)
+      {
+        return &chunks[i];
+      }
+    }
+    return nullptr;
+  }
+
+  inline void release(FirmwareChunk *chunk)
+  {
+    chunk->staged = false;
+  }
+
+private:
+  FirmwareChunk *chunks;
+  size_t count;
+};
+
+// Write behind stage with the buffers stored inline, every buffer costs FIRMWARE_CHUNK_SIZE bytes of RAM.
+template <size_t Buffers = DEFAULT_FIRMWARE_WRITE_BUFFERS>
+class StaticFirmwareWriteBehind : public FirmwareWriteBehind
+{
+  static_assert(Buffers >= 2U, "Writing behind needs at least two buffers, one being written and one being received");
+
+public:
+  inline StaticFirmwareWriteBehind()
+      : FirmwareWriteBehind(storage, Buffers)
+  {
+  }
+
+private:
+  FirmwareChunk storage[Buffers];
+};
+
+#endif // FIRMWARE_WRITER_H
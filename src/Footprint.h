@@ -0,0 +1,106 @@
+#ifndef FOOTPRINT_H
+#define FOOTPRINT_H
+
+#include "Thingspod.h"
+
+// Size of the formatted topic and log message buffers, both are fixed at compile time.
+#define FOOTPRINT_TOPIC_SIZE sizeof(FormattedTopic)
+#define FOOTPRINT_LOG_MESSAGE_SIZE sizeof(LogMessage)
+
+constexpr size_t footprintMax(const size_t a, const size_t b)
+{
+  return a > b ? a : b;
+}
+
+// Call chains of modules disabled by the feature policy do not exist and therefore do not count.
+constexpr size_t footprintIf(const bool enabled, const size_t size)
+{
+  return enabled ? size : 0U;
+}
+
+// Compile time report of the memory a given ThingspodTemplate configuration needs.
+// The stack sizes are the sum of the fixed size buffers (json documents, payload and log buffers) along the deepest call chain of each entry point,
+// they do not include compiler temporaries, the frames of PubSubClient or the user callbacks themselves.
+// test/host/stack_usage_test.cpp measures the RPC, attribute, firmware and gateway paths on a painted stack and checks them against these sums.
+template <
+    size_t PayloadSize = DEFAULT_PAYLOAD_SIZE,
+    size_t MaxFieldsElement = DEFAULT_FIELDS_ELEMENT,
+    typename Logger = Logger,
+    typename Encoding = JsonEncoding,
+    typename Features = AllFeatures,
+    typename Capacities = UniformCapacities<PayloadSize, MaxFieldsElement>>
+class FootprintTemplate
+{
+
+public:
+  // Document every inbound payload is parsed into.
+  static constexpr size_t inboundDocumentSize = sizeof(StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::inboundFields)>);
+  // Document the values of every sent message are collected in.
+  static constexpr size_t outboundDocumentSize = sizeof(StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::outboundFields)>);
+  // Shared by every entry point, onMessage formats the received topic into a log message before routing it.
+  static constexpr size_t onMessageStackSize = FOOTPRINT_LOG_MESSAGE_SIZE + FOOTPRINT_TOPIC_SIZE;
+
+  // onMessage -> processRPCMessage -> callback, the request is parsed through a filter and the params into a separate document,
+  // then the response is serialized.
+  static constexpr size_t rpcStackSize = onMessageStackSize + sizeof(RPCResponse) + sizeof(StaticJsonDocument<JSON_OBJECT_SIZE(2)>) + 2U * inboundDocumentSize + PayloadSize +
+                                         footprintMax(PayloadSize, sizeof(StaticJsonDocument<JSON_OBJECT_SIZE(1)>) + Capacities::responseSize + FOOTPRINT_TOPIC_SIZE);
+  // onMessage -> processSharedAttributeUpdateMessage -> callback, the subscribed keys are collected into a filter document first
+  // and the update is compared with the attribute mirror.
+  static constexpr size_t attributeUpdateStackSize = onMessageStackSize + inboundDocumentSize + sizeof(StaticJsonDocument<2U * JSON_OBJECT_SIZE(Capacities::inboundFields) + JSON_OBJECT_SIZE(1)>) +
+                                                    sizeof(typename AttributeMirrorTemplate<ATTRIBUTE_MIRROR_SIZE, Capacities::inboundFields>::MirrorDocument) + 3U * FOOTPRINT_LOG_MESSAGE_SIZE;
+  // onMessage -> processSharedAttributeRequestMessage -> callback.
+  static constexpr size_t attributeRequestStackSize = onMessageStackSize + inboundDocumentSize + FOOTPRINT_LOG_MESSAGE_SIZE;
+  // onMessage -> processProvisioningResponseMessage -> callback.
+  static constexpr size_t provisioningStackSize = onMessageStackSize + inboundDocumentSize;
+  // onMessage -> processSharedAttributeUpdateMessage -> firmware callback -> chunk download loop -> onMessage -> processFirmwareResponseMessage,
+  // the firmware download runs inside of the shared attribute callback and receives the chunks in a nested onMessage call.
+  static constexpr size_t firmwareStackSize = attributeUpdateStackSize + 3U * FOOTPRINT_LOG_MESSAGE_SIZE + onMessageStackSize + 3U * FOOTPRINT_LOG_MESSAGE_SIZE;
+  // sendTelemetry / sendAttributes -> sendDataArray -> sendTelemetryJson -> sendTelemetryJsonChar.
+  static constexpr size_t sendStackSize = outboundDocumentSize + PayloadSize + FOOTPRINT_LOG_MESSAGE_SIZE;
+  // A sample that closes an aggregation window publishes the statistics from within the send call, before its own values are sent.
+  static constexpr size_t aggregationStackSize = sendStackSize + AGGREGATED_VALUES_COUNT * sizeof(FormatBuffer<MAX_AGGREGATED_KEY_LENGTH + 7U>) + sizeof(StaticJsonDocument<JSON_OBJECT_SIZE(AGGREGATED_VALUES_COUNT)>) + AGGREGATED_RECORD_SIZE + FOOTPRINT_LOG_MESSAGE_SIZE;
+  // mqttClientLoop -> flushSharedAttributesRequests, the merged keys are serialized into the request, or sharedAttributesRequest answering from the cached response.
+  static constexpr size_t attributeRequestSendStackSize = footprintMax(sizeof(StaticJsonDocument<JSON_OBJECT_SIZE(1)>) + 2U * (PayloadSize + SHARED_KEYS_REQUEST_OVERHEAD) + PayloadSize + FOOTPRINT_LOG_MESSAGE_SIZE + FOOTPRINT_TOPIC_SIZE,
+                                                                       sizeof(StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::inboundFields) + PayloadSize>));
+
+  // onMessage -> processGatewayRPCMessage -> callback, the response is serialized into its own document.
+  static constexpr size_t gatewayRPCStackSize = onMessageStackSize + sizeof(RPCResponse) + inboundDocumentSize + sizeof(StaticJsonDocument<JSON_OBJECT_SIZE(3) + JSON_OBJECT_SIZE(1)>) + PayloadSize;
+  // sendGatewayTelemetry / sendGatewayAttributes, the values of every device are encoded into a scratch buffer before the outer payload.
+  static constexpr size_t gatewaySendStackSize = 3U * PayloadSize + outboundDocumentSize + sizeof(StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::outboundFields) + Capacities::outboundFields * JSON_ARRAY_SIZE(1)>) + FOOTPRINT_LOG_MESSAGE_SIZE;
+
+  // trySendTelemetry / trySendAttributes, runs on the stack of the producer task and is therefore not part of the worst case below.
+  static constexpr size_t producerStackSize = outboundDocumentSize + PayloadSize;
+
+  // processDispatchedMessages, runs on the stack of the worker task instead of inside onMessage.
+  static constexpr size_t dispatchStackSize = footprintMax(footprintMax(footprintIf(Features::rpc, rpcStackSize), footprintIf(Features::gateway, gatewayRPCStackSize)), footprintIf(Features::attributes, attributeUpdateStackSize));
+
+  static constexpr size_t onMessageWorstCaseStackSize = footprintMax(footprintMax(footprintMax(footprintIf(Features::rpc, rpcStackSize), footprintIf(Features::gateway, gatewayRPCStackSize)), footprintIf(Features::firmware, firmwareStackSize)),
+                                                                     footprintMax(footprintMax(footprintIf(Features::attributes, attributeUpdateStackSize), footprintIf(Features::attributes, attributeRequestStackSize)), footprintIf(Features::provisioning, provisioningStackSize)));
+  static constexpr size_t worstCaseStackSize = footprintMax(onMessageWorstCaseStackSize, footprintMax(footprintMax(footprintMax(sendStackSize, footprintIf(Features::shaping, aggregationStackSize)), footprintIf(Features::gateway, gatewaySendStackSize)), footprintIf(Features::attributes, attributeRequestSendStackSize)));
+
+  // Size of the instance itself, which holds the callback containers of every enabled module and the queues of every opted in service.
+  static constexpr size_t staticRamSize = sizeof(ThingspodTemplate<PayloadSize, MaxFieldsElement, Logger, Encoding, Features, Capacities>);
+  // Static RAM the disabled modules save compared with the same configuration with every module enabled.
+  static constexpr size_t savedRamSize = sizeof(ThingspodTemplate<PayloadSize, MaxFieldsElement, Logger, Encoding, AllFeatures, Capacities>) - staticRamSize;
+  static constexpr size_t savedStackSize = FootprintTemplate<PayloadSize, MaxFieldsElement, Logger, Encoding, AllFeatures, Capacities>::worstCaseStackSize - worstCaseStackSize;
+
+  static inline void log()
+  {
+    Logger::log(LogMessage(FOOTPRINT_REPORT, worstCaseStackSize, onMessageWorstCaseStackSize, staticRamSize).c_str());
+    Logger::log(LogMessage(FOOTPRINT_FEATURES_REPORT, savedStackSize, savedRamSize).c_str());
+  }
+};
+
+// Fails compilation if the given footprint exceeds the stack or static RAM budget declared by the user, for example:
+// static_assert(FootprintBudget<FootprintTemplate<128U, 16U>, 4096U, 8192U>::value, "");
+template <typename Footprint, size_t StackBudget, size_t RamBudget>
+struct FootprintBudget
+{
+  static_assert(Footprint::worstCaseStackSize <= StackBudget, "Worst case stack usage exceeds the declared stack budget, decrease PayloadSize, MaxFieldsElement or the capacities");
+  static_assert(Footprint::staticRamSize <= RamBudget, "Static RAM usage exceeds the declared RAM budget, decrease PayloadSize, MaxFieldsElement or the capacities");
+  static constexpr bool value = true;
+};
+
+using Footprint = FootprintTemplate<>;
+
+#endif // FOOTPRINT_H
@@ -0,0 +1,189 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include "Arduino.h"
+#include <type_traits>
+
+#ifndef LOG_MESSAGE_SIZE
+#define LOG_MESSAGE_SIZE 128U
+#endif
+#ifndef FORMATTED_TOPIC_SIZE
+#define FORMATTED_TOPIC_SIZE 48U
+#endif
+// Enough for every digit of an uint64_t.
+#define MAX_UNSIGNED_DIGITS 20U
+
+// Formats the value into the buffer without going through printf, returns the amount of written digits.
+// The buffer has to hold at least MAX_UNSIGNED_DIGITS characters, no null terminator is written.
+inline size_t formatUnsigned(char *buffer, uint64_t value)
+{
+  char digits[MAX_UNSIGNED_DIGITS];
+  size_t count = 0U;
+  do
+  {
+    digits[count++] = '0' + (value % 10U);
+    value /= 10U;
+  } while (value != 0U);
+  for (size_t i = 0U; i < count; i++)
+  {
+    buffer[i] = digits[count - i - 1U];
+  }
+  return count;
+}
+
+// Formats a message from a PROGMEM format string in one pass into a buffer of fixed capacity, so the size is known at compile time.
+// Only the conversions the library uses are supported, %u, %i and %d take any integer, %s a string and %% a literal percent sign,
+// the argument type decides how it is printed. Arguments are taken by value like the variadic arguments of printf, so passing
+// a static constexpr member does not require its definition. Anything that does not fit into the capacity is cut off.
+template <size_t Capacity>
+class FormatBuffer
+{
+  static_assert(Capacity > 1U, "The buffer needs room for at least one character and the null terminator");
+
+public:
+  template <typename... Args>
+  inline explicit FormatBuffer(const char *format, const Args... args)
+      : length(0U), cut(false)
+  {
+    append(format, args...);
+    this->buffer[this->length] = '\0';
+  }
+
+  inline const char *c_str() const
+  {
+    return this->buffer;
+  }
+
+  inline const size_t size() const
+  {
+    return this->length;
+  }
+
+  // True if the formatted message did not fit and was cut off.
+  inline const bool truncated() const
+  {
+    return this->cut;
+  }
+
+private:
+  char buffer[Capacity];
+  size_t length;
+  bool cut;
+
+  // Copies the format until the next conversion, returns the format after the conversion or nullptr once the format ended.
+  inline const char *literal(const char *format)
+  {
+    while (true)
+    {
+      const char character = pgm_read_byte(format);
+      if (character == '\0')
+      {
+        return nullptr;
+      }
+      format++;
+      if (character != '%')
+      {
+        put(character);
+        continue;
+      }
+      const char conversion = pgm_read_byte(format);
+      if (conversion == '\0')
+      {
+        return nullptr;
+      }
+      format++;
+      if (conversion == '%')
+      {
+        put('%');
+        continue;
+      }
+      return format;
+    }
+  }
+
+  inline void append(const char *format)
+  {
+    // Conversions without a matching argument are skipped.
+    while (format != nullptr)
+    {
+      format = literal(format);
+    }
+  }
+
+  template <typename T, typename... Args>
+  inline void append(const char *format, const T value, const Args... args)
+  {
+    format = literal(format);
+    if (format == nullptr)
+    {
+      return;
+    }
+    put(value);
+    append(format, args...);
+  }
+
+  inline void put(const char character)
+  {
+    if (this->length + 1U < Capacity)
+    {
+      this->buffer[this->length++] = character;
+    }
+    else
+    {
+      this->cut = true;
+    }
+  }
+
+  inline void put(const char *string)
+  {
+    if (string == nullptr)
+    {
+      return;
+    }
+    for (; *string != '\0'; string++)
+    {
+      put(*string);
+    }
+  }
+
+  inline void put(char *string)
+  {
+    put(static_cast<const char *>(string));
+  }
+
+  template <typename T>
+  inline typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type put(const T value)
+  {
+    putDigits(value);
+  }
+
+  template <typename T>
+  inline typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type put(const T value)
+  {
+    if (value < 0)
+    {
+      put('-');
+      // Negated as unsigned, so the smallest value does not overflow.
+      putDigits(0U - static_cast<uint64_t>(value));
+      return;
+    }
+    putDigits(static_cast<uint64_t>(value));
+  }
+
+  inline void putDigits(const uint64_t value)
+  {
+    char digits[MAX_UNSIGNED_DIGITS];
+    const size_t count = formatUnsigned(digits, value);
+    for (size_t i = 0U; i < count; i++)
+    {
+      put(digits[i]);
+    }
+  }
+};
+
+// Log messages are formatted into a buffer of this type before being handed to the Logger.
+using LogMessage = FormatBuffer<LOG_MESSAGE_SIZE>;
+// Topics that contain a request id or chunk number.
+using FormattedTopic = FormatBuffer<FORMATTED_TOPIC_SIZE>;
+
+#endif // FORMAT_H
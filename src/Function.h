@@ -0,0 +1,152 @@
+#ifndef FUNCTION_H
+#define FUNCTION_H
+
+#include "Arduino.h"
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Size of the inline storage for the captured state of a callback, enough for a lambda capturing a few pointers.
+#define DEFAULT_CALLBACK_STORAGE_SIZE (4U * sizeof(void *))
+
+template <typename Signature, size_t StorageSize = DEFAULT_CALLBACK_STORAGE_SIZE>
+class InplaceFunction;
+
+// Replacement for std::function that never allocates, the callable is copied into a fixed size buffer inside the object itself.
+// Callables that do not fit into the buffer are rejected at compile time instead of falling back to the heap.
+template <typename Result, typename... Arguments, size_t StorageSize>
+class InplaceFunction<Result(Arguments...), StorageSize>
+{
+
+public:
+  inline InplaceFunction()
+      : invoker(nullptr), manager(nullptr)
+  {
+  }
+
+  inline InplaceFunction(std::nullptr_t)
+      : invoker(nullptr), manager(nullptr)
+  {
+  }
+
+  template <typename Callable, typename = typename std::enable_if<!std::is_same<typename std::decay<Callable>::type, InplaceFunction>::value>::type>
+  inline InplaceFunction(Callable callable)
+      : invoker(nullptr), manager(nullptr)
+  {
+    static_assert(sizeof(Callable) <= StorageSize, "Callable does not fit into the callback storage, increase StorageSize or capture less");
+    static_assert(alignof(Callable) <= alignof(Storage), "Callable alignment is not supported by the callback storage");
+    if (isNull(callable))
+    {
+      return;
+    }
+    new (&storage) Callable(std::move(callable));
+    this->invoker = &invoke<Callable>;
+    this->manager = &manage<Callable>;
+  }
+
+  inline InplaceFunction(const InplaceFunction &other)
+      : invoker(other.invoker), manager(other.manager)
+  {
+    if (this->manager != nullptr)
+    {
+      this->manager(&storage, &other.storage);
+    }
+  }
+
+  inline InplaceFunction &operator=(const InplaceFunction &other)
+  {
+    if (this != &other)
+    {
+      reset();
+      this->invoker = other.invoker;
+      this->manager = other.manager;
+      if (this->manager != nullptr)
+      {
+        this->manager(&storage, &other.storage);
+      }
+    }
+    return *this;
+  }
+
+  inline InplaceFunction &operator=(std::nullptr_t)
+  {
+    reset();
+    return *this;
+  }
+
+  inline ~InplaceFunction()
+  {
+    reset();
+  }
+
+  inline Result operator()(Arguments... arguments) const
+  {
+    return this->invoker(&storage, std::forward<Arguments>(arguments)...);
+  }
+
+  inline explicit operator bool() const
+  {
+    return this->invoker != nullptr;
+  }
+
+  inline bool operator==(std::nullptr_t) const
+  {
+    return this->invoker == nullptr;
+  }
+
+  inline bool operator!=(std::nullptr_t) const
+  {
+    return this->invoker != nullptr;
+  }
+
+private:
+  using Storage = typename std::aligned_storage<StorageSize>::type;
+  using Invoker = Result (*)(const void *callable, Arguments &&...arguments);
+  // Copies the callable from source into destination, or destroys destination if source is null.
+  using Manager = void (*)(void *destination, const void *source);
+
+  Storage storage;
+  Invoker invoker;
+  Manager manager;
+
+  template <typename Callable>
+  static inline Result invoke(const void *callable, Arguments &&...arguments)
+  {
+    return (*const_cast<Callable *>(static_cast<const Callable *>(callable)))(std::forward<Arguments>(arguments)...);
+  }
+
+  template <typename Callable>
+  static inline void manage(void *destination, const void *source)
+  {
+    if (source == nullptr)
+    {
+      static_cast<Callable *>(destination)->~Callable();
+      return;
+    }
+    new (destination) Callable(*static_cast<const Callable *>(source));
+  }
+
+  template <typename Callable>
+  static inline bool isNull(const Callable &)
+  {
+    return false;
+  }
+
+  template <typename Callable>
+  static inline bool isNull(Callable *callable)
+  {
+    return callable == nullptr;
+  }
+
+  inline void reset()
+  {
+    if (this->manager != nullptr)
+    {
+      this->manager(&storage, nullptr);
+    }
+    this->invoker = nullptr;
+    this->manager = nullptr;
+  }
+};
+
+#endif // FUNCTION_H
@@ -0,0 +1,521 @@
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include "Base.h"
+#include "Hash.h"
+#include "Telemetry.h"
+#include "RPC.h"
+#include "Attribute.h"
+
+constexpr char *GATEWAY_CONNECT_TOPIC PROGMEM = "v1/gateway/connect";
+constexpr char *GATEWAY_DISCONNECT_TOPIC PROGMEM = "v1/gateway/disconnect";
+constexpr char *GATEWAY_TELEMETRY_TOPIC PROGMEM = "v1/gateway/telemetry";
+constexpr char *GATEWAY_ATTRIBUTE_TOPIC PROGMEM = "v1/gateway/attributes";
+constexpr char *GATEWAY_RPC_TOPIC PROGMEM = "v1/gateway/rpc";
+
+constexpr char *GATEWAY_DEVICE_KEY PROGMEM = "device";
+constexpr char *GATEWAY_TYPE_KEY PROGMEM = "type";
+constexpr char *GATEWAY_DATA_KEY PROGMEM = "data";
+constexpr char *GATEWAY_ID_KEY PROGMEM = "id";
+
+// Can be overridden with a build flag, for example -DMAX_GATEWAY_DEVICES=200 for large concentrators.
+#ifndef MAX_GATEWAY_DEVICES
+#define MAX_GATEWAY_DEVICES 16
+#endif
+#ifndef MAX_GATEWAY_CALLBACKS
+#define MAX_GATEWAY_CALLBACKS 4
+#endif
+
+// Values of one sub device, a record with a timestamp of 0 is timestamped by the server instead.
+class GatewayDeviceValues
+{
+
+public:
+  inline GatewayDeviceValues() : device(nullptr), record() {}
+
+  inline GatewayDeviceValues(const char *device, const Telemetry *values, const size_t valuesCount, const uint64_t ts = 0U)
+      : device(device), record(ts, values, valuesCount) {}
+
+  const char *device;    // Name of the sub device
+  TelemetryRecord record; // Values of the sub device
+};
+
+// Sub device connections of a gateway over the v1/gateway/* topics, so one MQTT connection serves many devices.
+// Device names and types are stored as pointers and have to stay valid as long as the device is connected.
+template <
+    size_t PayloadSize,
+    typename Capacities,
+    typename Logger = Logger,
+    typename Encoding = JsonEncoding>
+class GatewayTemplate : public Base
+{
+
+public:
+  inline GatewayTemplate(PubSubClient *mqttClient, bool *enableQos, SubscriptionRegistry *subscriptions)
+      : Base(mqttClient, enableQos, subscriptions), devicesCount(0U), currentDevice(nullptr)
+  {
+  }
+
+  inline bool isGatewayRPCMessage(const char *const topic)
+  {
+    return strcmp_P(topic, GATEWAY_RPC_TOPIC) == 0;
+  }
+
+  inline bool isGatewayAttributeMessage(const char *const topic)
+  {
+    return strcmp_P(topic, GATEWAY_ATTRIBUTE_TOPIC) == 0;
+  }
+
+  // Name of the sub device whose callback is currently running, allows one callback subscribed for every device to tell them apart.
+  inline const char *gatewayDevice() const
+  {
+    return this->currentDevice;
+  }
+
+  inline const bool isDeviceConnected(const char *name) const
+  {
+    return findDevice(name) < this->devicesCount;
+  }
+
+  inline const size_t connectedDevices() const
+  {
+    return this->devicesCount;
+  }
+
+  inline const bool connectDevice(const char *name, const char *type)
+  {
+    if (name == nullptr)
+    {
+      return false;
+    }
+
+    size_t index = findDevice(name);
+    if (index >= this->devicesCount)
+    {
+      if (this->devicesCount >= MAX_GATEWAY_DEVICES)
+      {
+        Logger::log(MAX_GATEWAY_DEVICES_EXCEEDED);
+        return false;
+      }
+      // Keep the devices sorted by hash, so looking up the device of an inbound message is a binary search.
+      const uint32_t hash = hashString(name);
+      index = lowerBound(hash);
+      for (size_t i = this->devicesCount; i > index; i--)
+      {
+        this->devices[i] = this->devices[i - 1U];
+      }
+      this->devices[index].name = name;
+      this->devices[index].hash = hash;
+      this->devicesCount++;
+    }
+    this->devices[index].type = type;
+    return publishDevice(GATEWAY_CONNECT_TOPIC, name, type);
+  }
+
+  // Disconnecting a device also removes the callbacks subscribed for it.
+  inline const bool disconnectDevice(const char *name)
+  {
+    const size_t index = findDevice(name);
+    if (index >= this->devicesCount)
+    {
+      return false;
+    }
+
+    const Device device = this->devices[index];
+    for (size_t i = index + 1U; i < this->devicesCount; i++)
+    {
+      this->devices[i - 1U] = this->devices[i];
+    }
+    this->devicesCount--;
+
+    for (size_t i = 0; i < this->rpcCallbacks.size(); i++)
+    {
+      if (this->rpcCallbacks.at(i).device != nullptr && this->rpcCallbacks.at(i).matches(device))
+      {
+        this->rpcCallbacks.erase(this->rpcCallbacks.begin() + i);
+        i--;
+      }
+    }
+    // The topics are shared by every device, they are only unsubscribed once no device has a callback left.
+    if (this->rpcCallbacks.empty())
+    {
+      (*this->subscriptions).unsubscribe(GATEWAY_RPC_TOPIC);
+    }
+    for (size_t i = 0; i < this->attributeCallbacks.size(); i++)
+    {
+      if (this->attributeCallbacks.at(i).device != nullptr && this->attributeCallbacks.at(i).matches(device))
+      {
+        this->attributeCallbacks.erase(this->attributeCallbacks.begin() + i);
+        i--;
+      }
+    }
+    if (this->attributeCallbacks.empty())
+    {
+      (*this->subscriptions).unsubscribe(GATEWAY_ATTRIBUTE_TOPIC);
+    }
+    return publishDevice(GATEWAY_DISCONNECT_TOPIC, device.name, nullptr);
+  }
+
+  // The server drops every sub device session together with the session of the gateway, announce them again after reconnecting.
+  inline const bool reconnectDevices()
+  {
+    bool success = true;
+    for (size_t i = 0; i < this->devicesCount; i++)
+    {
+      success = publishDevice(GATEWAY_CONNECT_TOPIC, this->devices[i].name, this->devices[i].type) && success;
+    }
+    return success;
+  }
+
+  // Forgets every device and callback without publishing anything, used when the broker dropped our session.
+  inline void clear()
+  {
+    this->devicesCount = 0U;
+    this->unsubscribeFromGatewayRPC();
+    this->unsubscribeFromGatewaySharedAttributes();
+  }
+
+  // Subscribes the callback for the given device, nullptr subscribes it for every device.
+  inline const bool gatewayRPCSubscribe(const char *device, const RPCCallback &callback)
+  {
+    if (this->rpcCallbacks.full())
+    {
+      Logger::log(MAX_GATEWAY_CALLBACKS_EXCEEDED);
+      return false;
+    }
+    if (!(*this->subscriptions).subscribe(GATEWAY_RPC_TOPIC))
+    {
+      return false;
+    }
+
+    this->rpcCallbacks.push_back(GatewayCallback<RPCCallback>(device, callback));
+    return true;
+  }
+
+  inline const bool unsubscribeFromGatewayRPC()
+  {
+    this->rpcCallbacks.clear();
+    return (*this->subscriptions).unsubscribe(GATEWAY_RPC_TOPIC);
+  }
+
+  // Subscribes the callback for the given device, nullptr subscribes it for every device.
+  inline const bool gatewaySharedAttributesSubscribe(const char *device, const SharedAttributeCallback &callback)
+  {
+    if (this->attributeCallbacks.full())
+    {
+      Logger::log(MAX_GATEWAY_CALLBACKS_EXCEEDED);
+      return false;
+    }
+    else if (!callback.valid())
+    {
+      Logger::log(LogMessage(TOO_MANY_SHARED_ATTRIBUTE_KEYS, MAX_SHARED_ATTRIBUTE_KEYS).c_str());
+      return false;
+    }
+    if (!(*this->subscriptions).subscribe(GATEWAY_ATTRIBUTE_TOPIC))
+    {
+      return false;
+    }
+
+    this->attributeCallbacks.push_back(GatewayCallback<SharedAttributeCallback>(device, callback));
+    return true;
+  }
+
+  inline const bool unsubscribeFromGatewaySharedAttributes()
+  {
+    this->attributeCallbacks.clear();
+    return (*this->subscriptions).unsubscribe(GATEWAY_ATTRIBUTE_TOPIC);
+  }
+
+  // Writes the values of every device into one {"Device A":[{...}],"Device B":[{"ts":ms,"values":{...}}]} payload.
+  // Returns the length of the payload or 0 if it could not be serialized.
+  inline const size_t serializeTelemetry(const GatewayDeviceValues *data, const size_t dataCount, char *payload, const size_t size)
+  {
+    return serializeDevices(data, dataCount, payload, size, true);
+  }
+
+  // Writes the values of every device into one {"Device A":{...},"Device B":{...}} payload, timestamps are ignored.
+  // Returns the length of the payload or 0 if it could not be serialized.
+  inline const size_t serializeAttributes(const GatewayDeviceValues *data, const size_t dataCount, char *payload, const size_t size)
+  {
+    return serializeDevices(data, dataCount, payload, size, false);
+  }
+
+  inline void processGatewayRPCMessage(char *, uint8_t *payload, uint32_t length)
+  {
+    RPCResponse rpcResponse;
+    StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::inboundFields)> jsonBuffer;
+    if (Encoding::deserialize(jsonBuffer, payload, length))
+    {
+      Logger::log(UNABLE_TO_DE_SERIALIZE_GATEWAY_MESSAGE);
+      return;
+    }
+
+    const size_t index = findDevice(jsonBuffer[GATEWAY_DEVICE_KEY].template as<const char *>());
+    if (index >= this->devicesCount)
+    {
+      Logger::log(GATEWAY_DEVICE_NOT_CONNECTED);
+      return;
+    }
+    const Device &device = this->devices[index];
+    const JsonObjectConst data = jsonBuffer[GATEWAY_DATA_KEY].template as<JsonObjectConst>();
+    const char *methodName = data[RPC_METHOD_KEY].template as<const char *>();
+    if (methodName == nullptr)
+    {
+      Logger::log(RPC_METHOD_NULL);
+      return;
+    }
+
+    for (const GatewayCallback<RPCCallback> &callback : this->rpcCallbacks)
+    {
+      if (!callback.matches(device) || callback.callback.callbackFunction == nullptr || callback.callback.methodName == nullptr)
+      {
+        continue;
+      }
+      else if (strcmp(callback.callback.methodName, methodName) != 0)
+      {
+        continue;
+      }
+
+      Logger::log(CALLING_RPC);
+      Logger::log(methodName);
+      this->currentDevice = device.name;
+      rpcResponse = callback.callback.callbackFunction(data[RPC_PARAMS_KEY]);
+      this->currentDevice = nullptr;
+      break;
+    }
+
+    // Fill in response, the server matches it to the request with the device name and the request id.
+    StaticJsonDocument<JSON_OBJECT_SIZE(3) + JSON_OBJECT_SIZE(1)> responseBuffer;
+    responseBuffer[static_cast<const char *>(GATEWAY_DEVICE_KEY)] = device.name;
+    responseBuffer[static_cast<const char *>(GATEWAY_ID_KEY)] = data[GATEWAY_ID_KEY];
+    JsonVariant responseData = responseBuffer.createNestedObject(static_cast<const char *>(GATEWAY_DATA_KEY));
+    if (rpcResponse.serializeKeyValue(responseData) == false)
+    {
+      Logger::log(UNABLE_TO_SERIALIZE);
+      return;
+    }
+
+    const uint32_t json_size = JSON_STRING_SIZE(Encoding::measure(responseBuffer));
+    if (json_size > PayloadSize)
+    {
+      Logger::log(LogMessage(INVALID_BUFFER_SIZE, PayloadSize, json_size).c_str());
+      return;
+    }
+    char responsePayload[PayloadSize];
+    const size_t responseLength = Encoding::serialize(responseBuffer, responsePayload, sizeof(responsePayload));
+    publish(GATEWAY_RPC_TOPIC, responsePayload, responseLength, PRIORITY_RPC);
+  }
+
+  inline void processGatewayAttributeMessage(char *, uint8_t *payload, uint32_t length)
+  {
+    StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::inboundFields)> jsonBuffer;
+    if (Encoding::deserialize(jsonBuffer, payload, length))
+    {
+      Logger::log(UNABLE_TO_DE_SERIALIZE_GATEWAY_MESSAGE);
+      return;
+    }
+
+    const size_t index = findDevice(jsonBuffer[GATEWAY_DEVICE_KEY].template as<const char *>());
+    if (index >= this->devicesCount)
+    {
+      Logger::log(GATEWAY_DEVICE_NOT_CONNECTED);
+      return;
+    }
+    const Device &device = this->devices[index];
+    const JsonObjectConst data = jsonBuffer[GATEWAY_DATA_KEY].template as<JsonObjectConst>();
+    if (data.isNull())
+    {
+      Logger::log(NOT_FOUND_ATTRIBUTE_UPDATE);
+      return;
+    }
+
+    this->currentDevice = device.name;
+    const KeyIndex<Capacities::inboundFields> keys(data);
+    for (const GatewayCallback<SharedAttributeCallback> &callback : this->attributeCallbacks)
+    {
+      if (!callback.matches(device) || callback.callback.callbackFunction == nullptr)
+      {
+        continue;
+      }
+
+      // Callbacks without keys are called for every update, the same as for the attributes of the gateway itself.
+      bool containsKey = callback.callback.attributes.empty();
+      for (const InternedKey &att : callback.callback.attributes)
+      {
+        if (keys.contains(att))
+        {
+          containsKey = true;
+          break;
+        }
+      }
+      if (containsKey)
+      {
+        callback.callback.callbackFunction(data);
+      }
+    }
+    this->currentDevice = nullptr;
+  }
+
+private:
+  struct Device
+  {
+    const char *name;
+    const char *type;
+    uint32_t hash;
+  };
+
+  template <typename Callback>
+  class GatewayCallback
+  {
+  public:
+    inline GatewayCallback() : device(nullptr), deviceHash(0U), callback() {}
+
+    inline GatewayCallback(const char *device, const Callback &callback)
+        : device(device), deviceHash(hashString(device)), callback(callback) {}
+
+    // Compares the hashes first, so only the callbacks of the matching device need a string compare.
+    inline const bool matches(const Device &other) const
+    {
+      return device == nullptr || (deviceHash == other.hash && (device == other.name || strcmp(device, other.name) == 0));
+    }
+
+    const char *device; // Device the callback is subscribed for, nullptr for every device
+    uint32_t deviceHash;
+    Callback callback;
+  };
+
+  Device devices[MAX_GATEWAY_DEVICES];
+  size_t devicesCount;
+  const char *currentDevice;
+  StaticVector<GatewayCallback<RPCCallback>, MAX_GATEWAY_CALLBACKS> rpcCallbacks;
+  StaticVector<GatewayCallback<SharedAttributeCallback>, MAX_GATEWAY_CALLBACKS> attributeCallbacks;
+
+  // Index of the first device with a hash that is not smaller than the given one.
+  inline const size_t lowerBound(const uint32_t hash) const
+  {
+    size_t first = 0U;
+    size_t count = this->devicesCount;
+    while (count > 0U)
+    {
+      const size_t step = count / 2U;
+      if (this->devices[first + step].hash < hash)
+      {
+        first += step + 1U;
+        count -= step + 1U;
+      }
+      else
+      {
+        count = step;
+      }
+    }
+    return first;
+  }
+
+  // Returns the index of the device or devicesCount if it is not connected.
+  inline const size_t findDevice(const char *name) const
+  {
+    if (name == nullptr)
+    {
+      return this->devicesCount;
+    }
+    const uint32_t hash = hashString(name);
+    for (size_t i = lowerBound(hash); i < this->devicesCount && this->devices[i].hash == hash; i++)
+    {
+      if (this->devices[i].name == name || strcmp(this->devices[i].name, name) == 0)
+      {
+        return i;
+      }
+    }
+    return this->devicesCount;
+  }
+
+  inline const bool publishDevice(const char *topic, const char *name, const char *type)
+  {
+    StaticJsonDocument<JSON_OBJECT_SIZE(2)> requestBuffer;
+    requestBuffer[static_cast<const char *>(GATEWAY_DEVICE_KEY)] = name;
+    if (type != nullptr)
+    {
+      requestBuffer[static_cast<const char *>(GATEWAY_TYPE_KEY)] = type;
+    }
+
+    const uint32_t json_size = JSON_STRING_SIZE(Encoding::measure(requestBuffer));
+    if (json_size > PayloadSize)
+    {
+      Logger::log(LogMessage(INVALID_BUFFER_SIZE, PayloadSize, json_size).c_str());
+      return false;
+    }
+    char requestPayload[PayloadSize];
+    const size_t requestLength = Encoding::serialize(requestBuffer, requestPayload, sizeof(requestPayload));
+    return publish(topic, requestPayload, requestLength, PRIORITY_ATTRIBUTE);
+  }
+
+  inline const size_t serializeDevices(const GatewayDeviceValues *data, const size_t dataCount, char *payload, const size_t size, const bool telemetry)
+  {
+    if (data == nullptr || dataCount == 0U)
+    {
+      return 0U;
+    }
+    else if (dataCount > Capacities::outboundFields)
+    {
+      Logger::log(LogMessage(TOO_MANY_JSON_FIELDS, dataCount, Capacities::outboundFields).c_str());
+      return 0U;
+    }
+
+    // The values of every device are encoded one after another into the same buffer and linked into the outer document
+    // as raw values, so the outer document only holds one slot per device instead of every single value.
+    char values[PayloadSize];
+    size_t valuesLength = 0U;
+    StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::outboundFields)> valuesBuffer;
+    StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::outboundFields) + Capacities::outboundFields * JSON_ARRAY_SIZE(1)> devicesBuffer;
+    JsonObject devicesObject = devicesBuffer.template to<JsonObject>();
+
+    for (size_t i = 0; i < dataCount; ++i)
+    {
+      const GatewayDeviceValues &device = data[i];
+      if (device.device == nullptr || device.record.valuesCount > Capacities::outboundFields)
+      {
+        Logger::log(UNABLE_TO_SERIALIZE);
+        return 0U;
+      }
+
+      char *buffer = values + valuesLength;
+      const size_t remaining = sizeof(values) - valuesLength;
+      size_t written = 0U;
+      if (telemetry && device.record.ts != 0U)
+      {
+        written = Encoding::serializeRecord(device.record, valuesBuffer, buffer, remaining);
+      }
+      else if (device.record.serializeValues(valuesBuffer) && JSON_STRING_SIZE(Encoding::measure(valuesBuffer)) <= remaining)
+      {
+        written = Encoding::serialize(valuesBuffer, buffer, remaining);
+      }
+
+      if (written == 0U)
+      {
+        Logger::log(LogMessage(GATEWAY_DEVICE_TOO_BIG, device.device, PayloadSize).c_str());
+        return 0U;
+      }
+
+      const char *encodedValues = buffer;
+      if (telemetry)
+      {
+        devicesObject.createNestedArray(device.device).add(serialized(encodedValues, written));
+      }
+      else
+      {
+        devicesObject[device.device] = serialized(encodedValues, written);
+      }
+      valuesLength += written;
+    }
+
+    const uint32_t json_size = JSON_STRING_SIZE(Encoding::measure(devicesBuffer));
+    if (json_size > size)
+    {
+      Logger::log(LogMessage(INVALID_BUFFER_SIZE, size, json_size).c_str());
+      return 0U;
+    }
+    return Encoding::serialize(devicesBuffer, payload, size);
+  }
+};
+
+#endif // GATEWAY_H
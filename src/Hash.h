@@ -0,0 +1,18 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include "Arduino.h"
+
+// FNV-1a, cheap enough to run on every lookup, so names and keys can be compared by hash before falling back to strcmp.
+inline const uint32_t hashString(const char *value)
+{
+  uint32_t result = 2166136261U;
+  while (value != nullptr && *value != '\0')
+  {
+    result ^= static_cast<uint8_t>(*value++);
+    result *= 16777619U;
+  }
+  return result;
+}
+
+#endif // HASH_H
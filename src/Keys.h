@@ -0,0 +1,101 @@
+#ifndef KEYS_H
+#define KEYS_H
+
+#include "Arduino.h"
+#include <ArduinoJson.h>
+#include "Hash.h"
+
+// Same FNV-1a as hashString, but evaluated by the compiler for string literals.
+constexpr uint32_t hashLiteral(const char *value, const uint32_t result = 2166136261U)
+{
+  return (value == nullptr || *value == '\0') ? result : hashLiteral(value + 1, (result ^ static_cast<uint8_t>(*value)) * 16777619U);
+}
+
+// Key with its hash, computed at compile time if the key is a constexpr literal, for example
+// constexpr InternedKey TEMPERATURE_KEY("temperature"). Converts to the key text, so it can be used wherever a key is expected,
+// while lookups compare the hash first and only verify a matching hash with strcmp.
+class InternedKey
+{
+
+public:
+  constexpr InternedKey()
+      : name(nullptr), hash(hashLiteral(nullptr))
+  {
+  }
+
+  constexpr InternedKey(const char *name)
+      : name(name), hash(hashLiteral(name))
+  {
+  }
+
+  constexpr operator const char *() const
+  {
+    return this->name;
+  }
+
+  inline const bool matches(const char *other, const uint32_t otherHash) const
+  {
+    return this->name != nullptr && other != nullptr && this->hash == otherHash && strcmp(this->name, other) == 0;
+  }
+
+  const char *name;
+  uint32_t hash;
+};
+
+// Hashes of every key of a received object, computed once per message, so checking each subscribed key only compares hashes
+// instead of calling strcmp for every key of the object. Objects with more keys than the capacity fall back to containsKey.
+template <size_t Capacity>
+class KeyIndex
+{
+
+public:
+  inline explicit KeyIndex(const JsonObjectConst &object)
+      : object(object), entries(), count(0U), complete(true)
+  {
+    for (const JsonPairConst pair : object)
+    {
+      if (this->count == Capacity)
+      {
+        this->complete = false;
+        break;
+      }
+      this->entries[this->count].name = pair.key().c_str();
+      this->entries[this->count].hash = hashString(this->entries[this->count].name);
+      this->count++;
+    }
+  }
+
+  inline const bool contains(const InternedKey &key) const
+  {
+    if (key.name == nullptr)
+    {
+      return false;
+    }
+    else if (!this->complete)
+    {
+      return this->object.containsKey(key.name);
+    }
+    for (size_t i = 0U; i < this->count; i++)
+    {
+      if (key.matches(this->entries[i].name, this->entries[i].hash))
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  struct Entry
+  {
+    const char *name;
+    uint32_t hash;
+  };
+
+  const JsonObjectConst object;
+  Entry entries[Capacity];
+  size_t count;
+  bool complete;
+};
+
+#endif // KEYS_H
@@ -14,14 +14,21 @@ constexpr char *NO_RPC_PARAMS_PASSED PROGMEM = "No parameters passed with RPC, p
 constexpr char *CALLING_RPC PROGMEM = "Calling RPC:";
 constexpr char *UNABLE_TO_SERIALIZE PROGMEM = "Unable to serialize data";
 constexpr char *CONNECT_FAILED PROGMEM = "Connecting to server failed";
-constexpr char *MAX_RPC_EXCEEDED PROGMEM = "Too many rpc subscriptions, increase MaxFieldsAmt or unsubscribe";
-constexpr char *MAX_SHARED_ATTRIBUTE_UPDATE_EXCEEDED PROGMEM = "Too many shared attribute update callback subscriptions, increase MaxFieldsAmt or unsubscribe";
-constexpr char *MAX_SHARED_ATTRIBUTE_REQUEST_EXCEEDED PROGMEM = "Too many shared attribute request callback subscriptions, increase MaxFieldsAmt";
+constexpr char *CREDENTIALS_TOO_LONG PROGMEM = "Access token or client id is missing or longer than MAX_ACCESS_TOKEN_LENGTH (%u) or MAX_CLIENT_ID_LENGTH (%u)";
+constexpr char *RECONNECT_FAILED PROGMEM = "Reconnecting to server failed, retrying in (%u) ms";
+constexpr char *RECONNECT_SUCCESS PROGMEM = "Reconnected and restored session in (%u) ms";
+constexpr char *MAX_RPC_EXCEEDED PROGMEM = "Too many rpc subscriptions, increase RPCMethods of the CapacityTraits (%u) or unsubscribe";
+constexpr char *MAX_SHARED_ATTRIBUTE_UPDATE_EXCEEDED PROGMEM = "Too many shared attribute update callback subscriptions, increase AttributeCallbacks of the CapacityTraits (%u) or unsubscribe";
+constexpr char *TOO_MANY_SHARED_ATTRIBUTE_KEYS PROGMEM = "Shared attribute callback has more keys than MAX_SHARED_ATTRIBUTE_KEYS (%u), increase it with a build flag";
+constexpr char *MAX_SHARED_ATTRIBUTE_REQUEST_EXCEEDED PROGMEM = "Too many shared attribute request callback subscriptions, increase PendingRequests of the CapacityTraits (%u)";
 constexpr char *NUMBER_PRINTF PROGMEM = "%u";
 constexpr char COMMA PROGMEM = ',';
 constexpr char *NO_KEYS_TO_REQUEST PROGMEM = "No keys to request were given";
 constexpr char *REQUEST_ATTRIBUTE PROGMEM = "Requesting shared attributes transformed from (%s) into json (%s)";
 constexpr char *UNABLE_TO_DE_SERIALIZE_RPC PROGMEM = "Unable to de-serialize RPC";
+constexpr char *MAX_RPC_REQUESTS_EXCEEDED PROGMEM = "Too many RPC requests awaiting a response, increase MAX_PENDING_RPC_REQUESTS or wait for the responses";
+constexpr char *RPC_REQUEST_TIMED_OUT PROGMEM = "RPC request (%u) timed out";
+constexpr char *RPC_RESPONSE_UNKNOWN PROGMEM = "RPC response (%u) does not belong to a pending request, skipping it";
 constexpr char *UNABLE_TO_DE_SERIALIZE_ATTRIBUTE_UPDATE PROGMEM = "Unable to de-serialize shared attribute update";
 constexpr char *RECEIVED_ATTRIBUTE_UPDATE PROGMEM = "Received shared attribute update";
 constexpr char *NOT_FOUND_ATTRIBUTE_UPDATE PROGMEM = "Shared attribute update key not found";
@@ -35,12 +42,33 @@ constexpr char *CALLING_ATTRIBUTE_CALLBACK PROGMEM = "Calling subscribed callbac
 constexpr char *RECEIVED_ATTRIBUTE PROGMEM = "Received shared attribute request";
 constexpr char *ATTRIBUTE_KEY_NOT_FOUND PROGMEM = "Shared attribute key not found";
 constexpr char *ATTRIBUTE_REQUEST_CALLBACK_IS_NULL PROGMEM = "Shared attribute request callback is NULL";
+constexpr char *ATTRIBUTE_MIRROR_NO_CHANGE PROGMEM = "Shared attribute update did not change any mirrored value, skipping callbacks";
+constexpr char *CALLING_MIRRORED_ATTRIBUTE_CALLBACK PROGMEM = "Calling subscribed callback with the mirrored shared attributes";
+constexpr char *ATTRIBUTE_REQUEST_TOO_BIG PROGMEM = "Requested shared attribute keys do not fit into PayloadSize, call loop to send the pending request first or increase PayloadSize";
+constexpr char *ATTRIBUTE_REQUEST_FAILED PROGMEM = "Publishing shared attribute request (%u) failed, its callbacks will not receive a response";
+constexpr char *ATTRIBUTE_REQUEST_TIMED_OUT PROGMEM = "Shared attribute request (%u) timed out, its callback will not receive a response";
+constexpr char *ATTRIBUTE_REQUEST_FROM_CACHE PROGMEM = "Answering shared attribute request from the cached response";
 constexpr char *CALLING_REQUEST_ATTRIBUTE_CALLBACK PROGMEM = "Calling subscribed callback for response id (%u)";
-constexpr char *TOO_MANY_JSON_FIELDS PROGMEM = "Too many JSON fields passed (%u), increase MaxFieldsAmt (%u) accordingly";
+constexpr char *TELEMETRY_SERIES_TOO_BIG PROGMEM = "Telemetry record (%u) does not fit into PayloadSize (%u), send less records at once or increase PayloadSize";
+constexpr char *MAX_GATEWAY_DEVICES_EXCEEDED PROGMEM = "Too many gateway devices connected, increase MAX_GATEWAY_DEVICES or disconnect devices";
+constexpr char *MAX_GATEWAY_CALLBACKS_EXCEEDED PROGMEM = "Too many gateway callback subscriptions, increase MAX_GATEWAY_CALLBACKS or unsubscribe";
+constexpr char *UNABLE_TO_DE_SERIALIZE_GATEWAY_MESSAGE PROGMEM = "Unable to de-serialize gateway message";
+constexpr char *GATEWAY_DEVICE_NOT_CONNECTED PROGMEM = "Gateway message for a device that is not connected, skipping it";
+constexpr char *GATEWAY_DEVICE_TOO_BIG PROGMEM = "Values of gateway device (%s) do not fit into PayloadSize (%u), send less devices at once or increase PayloadSize";
+constexpr char *DISPATCH_QUEUE_FULL PROGMEM = "Dispatch queue is full, skipping message on topic (%s), call processDispatchedMessages more often";
+constexpr char *DISPATCH_MESSAGE_TOO_BIG PROGMEM = "Message on topic (%s) with (%u) bytes is too big to be dispatched, increase MAX_DISPATCH_PAYLOAD_SIZE";
+constexpr char *DISPATCH_WITH_MIRROR PROGMEM = "Dispatching callbacks can not be combined with the attribute mirror";
+constexpr char *AGGREGATE_NOT_SENT PROGMEM = "Statistics of (%s) could not be sent, while disconnected they are only queued if they fit into PayloadSize";
+constexpr char *STREAMED_PAYLOAD_OFFLINE PROGMEM = "Payload bigger than PayloadSize can only be streamed while connected, it is not queued";
+constexpr char *TOO_MANY_JSON_FIELDS PROGMEM = "Too many JSON fields passed (%u), increase OutboundFields of the CapacityTraits (%u) accordingly";
+constexpr char *FOOTPRINT_REPORT PROGMEM = "Worst case stack (%u) bytes, of that onMessage (%u) bytes, static RAM (%u) bytes";
+constexpr char *FOOTPRINT_FEATURES_REPORT PROGMEM = "Disabled modules save (%u) bytes of worst case stack and (%u) bytes of static RAM";
 constexpr char CALLBACK_ON_MESSAGE[] PROGMEM = "Callback on_message from topic: (%s)";
 
 #if defined(ESP8266) || defined(ESP32) || defined(ARDUINO_AVR_MEGA)
 constexpr char *PROVISION_REQUEST PROGMEM = "Provision request:";
+constexpr char *PROVISION_REQUEST_TOO_BIG PROGMEM = "Provision request (%u) is bigger than PROVISION_REQUEST_SIZE (%u), increase MAX_PROVISION_VALUE_LENGTH";
+constexpr char *CLAIM_REQUEST_TOO_BIG PROGMEM = "Claiming request (%u) is bigger than CLAIM_REQUEST_SIZE (%u), increase MAX_CLAIM_SECRET_LENGTH";
 constexpr char *UNABLE_TO_DE_SERIALIZE_PROVISION_RESPONSE PROGMEM = "Unable to de-serialize provision response";
 constexpr char *PROVISION_RESPONSE PROGMEM = "Process provisioning response";
 constexpr char *RECEIVED_PROVISION_RESPONSE PROGMEM = "Received provision response";
@@ -51,6 +79,7 @@ constexpr char *NO_FIRMWARE PROGMEM = "No new firmware assigned on the given dev
 constexpr char *FIRMWARE_UP_TO_DATE PROGMEM = "Firmware is already up to date";
 constexpr char *FIRMWARE_NOT_FOR_US PROGMEM = "Firmware is not for us (title is different)";
 constexpr char *FIRMWARE_CHECKSUM_ALGO_NOT_SUPPORTED PROGMEM = "Checksum algorithm is not supported, please use MD5 only";
+constexpr char *FIRMWARE_INFO_TOO_LONG PROGMEM = "Firmware title, version or checksum is missing or longer than its buffer";
 constexpr char *PAGE_BREAK = "=================================";
 constexpr char *NEW_FIRMWARE PROGMEM = "A new Firmware is available:";
 constexpr char *FROM_TOO = "(%s) => (%s)";
@@ -60,6 +89,7 @@ constexpr char SLASH PROGMEM = '/';
 constexpr char *UNABLE_TO_WRITE PROGMEM = "Unable to write firmware";
 constexpr char *UNABLE_TO_DOWNLOAD PROGMEM = "Unable to download firmware";
 constexpr char *FIRMWARE_CHUNK PROGMEM = "Receive chunk (%i), with size (%u) bytes";
+constexpr char *FIRMWARE_CHUNK_NOT_STAGED PROGMEM = "No free write behind buffer or chunk too big, chunk is requested again";
 constexpr char *ERROR_UPDATE_BEGIN PROGMEM = "Error during Update.begin";
 constexpr char *ERROR_UPDATE_WITE PROGMEM = "Error during Update.write";
 constexpr char *MD5_ACTUAL PROGMEM = "MD5 actual checksum: (%s)";
@@ -25,17 +25,24 @@ constexpr char *MQTT_BASIC_TOKEN_CREDENTIAL_TYPE PROGMEM = "MQTT_BASIC";
 constexpr char *PROVISION_DEVICE_KEY PROGMEM = "provisionDeviceKey";
 constexpr char *PROVISION_DEVICE_SECRET_KEY PROGMEM = "provisionDeviceSecret";
 
+// Provisioning is requested once with its own values, so the request is sized from them instead of PayloadSize.
+#ifndef MAX_PROVISION_VALUE_LENGTH
+#define MAX_PROVISION_VALUE_LENGTH 32U
+#endif
+// {"deviceName":"","provisionDeviceKey":"","provisionDeviceSecret":""} around the values, including the null terminator.
+#define PROVISION_REQUEST_SIZE (69U + 3U * MAX_PROVISION_VALUE_LENGTH)
+
 #endif
 
 using ProvisionData = const JsonObjectConst;
 
 class ProvisionCallback
 {
-  template <size_t PayloadSize, size_t MaxFieldsElement, typename Logger>
+  template <size_t PayloadSize, typename Capacities, typename Logger, typename Encoding>
   friend class ProvisioningTemplate;
 
 public:
-  using processFn = std::function<void(const ProvisionData &data)>;
+  using processFn = InplaceFunction<void(const ProvisionData &data)>;
 
   inline ProvisionCallback()
       : callbackFunction(nullptr) {}
@@ -49,13 +56,14 @@ private:
 
 template <
     size_t PayloadSize,
-    size_t MaxFieldsElement,
-    typename Logger = Logger>
+    typename Capacities,
+    typename Logger = Logger,
+    typename Encoding = JsonEncoding>
 class ProvisioningTemplate : public Base
 {
 
 public:
-  inline ProvisioningTemplate(PubSubClient *mqttClient, bool *enableQos) : Base(mqttClient, enableQos)
+  inline ProvisioningTemplate(PubSubClient *mqttClient, bool *enableQos, SubscriptionRegistry *subscriptions) : Base(mqttClient, enableQos, subscriptions)
   {
   }
 
@@ -71,16 +79,18 @@ public:
     StaticJsonDocument<JSON_OBJECT_SIZE(3)> requestBuffer;
     JsonObject requestObject = requestBuffer.to<JsonObject>();
 
-    String deviceNameKey = DEVICE_NAME_KEY;
-    String provisionKey = PROVISION_DEVICE_KEY;
-    String secretKey = PROVISION_DEVICE_SECRET_KEY;
-    requestObject[deviceNameKey.c_str()] = deviceName;
-    requestObject[provisionKey.c_str()] = provisionDeviceKey;
-    requestObject[secretKey.c_str()] = provisionDeviceSecret;
+    requestObject[static_cast<const char *>(DEVICE_NAME_KEY)] = deviceName;
+    requestObject[static_cast<const char *>(PROVISION_DEVICE_KEY)] = provisionDeviceKey;
+    requestObject[static_cast<const char *>(PROVISION_DEVICE_SECRET_KEY)] = provisionDeviceSecret;
 
-    uint8_t objectSize = JSON_STRING_SIZE(measureJson(requestBuffer));
-    char requestPayload[objectSize];
-    serializeJson(requestObject, requestPayload, objectSize);
+    const uint32_t json_size = JSON_STRING_SIZE(measureJson(requestBuffer));
+    if (json_size > PROVISION_REQUEST_SIZE)
+    {
+      Logger::log(LogMessage(PROVISION_REQUEST_TOO_BIG, json_size, PROVISION_REQUEST_SIZE).c_str());
+      return false;
+    }
+    char requestPayload[PROVISION_REQUEST_SIZE];
+    serializeJson(requestObject, requestPayload, sizeof(requestPayload));
 
     Logger::log(PROVISION_REQUEST);
     Logger::log(requestPayload);
@@ -89,7 +99,7 @@ public:
 
   inline const bool provisionSubscribe(const ProvisionCallback callback)
   {
-    if (!(*mqttClient).subscribe(PROVISION_RESPONSE_TOPIC, (*mqttQoS) ? 1 : 0))
+    if (!(*subscriptions).isSubscribed(PROVISION_RESPONSE_TOPIC) && !(*subscriptions).subscribe(PROVISION_RESPONSE_TOPIC))
     {
       return false;
     }
@@ -99,18 +109,18 @@ public:
 
   inline const bool unsubscribeFromProvisioning()
   {
-    if (!(*mqttClient).unsubscribe(PROVISION_RESPONSE_TOPIC))
+    if (!(*subscriptions).unsubscribe(PROVISION_RESPONSE_TOPIC))
     {
       return false;
     }
     return true;
   }
 
-  inline void processProvisioningResponseMessage(char *topic, uint8_t *payload, uint32_t length)
+  inline void processProvisioningResponseMessage(char *, uint8_t *payload, uint32_t length)
   {
     Logger::log(PROVISION_RESPONSE);
 
-    StaticJsonDocument<JSON_OBJECT_SIZE(MaxFieldsElement)> jsonBuffer;
+    StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::inboundFields)> jsonBuffer;
     DeserializationError payloadDeserializationError = deserializeJson(jsonBuffer, payload, length);
     if (payloadDeserializationError)
     {
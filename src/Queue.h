@@ -0,0 +1,259 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include "Arduino.h"
+#if defined(ESP8266) || defined(ESP32)
+#include <atomic>
+#endif
+
+#define DEFAULT_OUTBOUND_QUEUE_SIZE 4
+#define DEFAULT_PRODUCER_QUEUE_SIZE 4
+#define DEFAULT_DISPATCH_QUEUE_SIZE 4
+#ifndef MAX_DISPATCH_TOPIC_LENGTH
+#define MAX_DISPATCH_TOPIC_LENGTH 64
+#endif
+// Dispatched messages were received, so their size is bounded by the receive buffer of PubSubClient instead of PayloadSize.
+// Only has to be increased if setBufferSize enlarges the buffer for RPC or shared attribute messages.
+#ifndef MAX_DISPATCH_PAYLOAD_SIZE
+#define MAX_DISPATCH_PAYLOAD_SIZE MQTT_MAX_PACKET_SIZE
+#endif
+
+// Already serialized message to one of our constant topics, only the pointer to the topic is kept.
+template <size_t PayloadSize>
+struct OutboundMessage
+{
+  const char *topic;
+  uint16_t length;
+  char payload[PayloadSize];
+
+  static inline const bool fits(const char *topic, const size_t length)
+  {
+    return topic != nullptr && length < PayloadSize;
+  }
+
+  // The payload is copied with the given length, because binary encoded payloads may contain null bytes.
+  inline void assign(const char *topic, const char *payload, const size_t length)
+  {
+    this->topic = topic;
+    this->length = length;
+    memcpy(this->payload, payload, length);
+    this->payload[length] = '\0';
+  }
+};
+
+// Message that is handed to another task, the topic is copied as well, because it may contain a request id.
+template <size_t PayloadSize>
+struct DispatchMessage
+{
+  char topic[MAX_DISPATCH_TOPIC_LENGTH];
+  uint16_t length;
+  char payload[PayloadSize];
+
+  static inline const bool fits(const char *topic, const size_t length)
+  {
+    return topic != nullptr && strlen(topic) < MAX_DISPATCH_TOPIC_LENGTH && length < PayloadSize;
+  }
+
+  inline void assign(const char *topic, const char *payload, const size_t length)
+  {
+    strncpy(this->topic, topic, sizeof(this->topic));
+    this->length = length;
+    memcpy(this->payload, payload, length);
+    this->payload[length] = '\0';
+  }
+};
+
+// Fixed capacity ring buffer of already serialized messages, keeps data that could not be published while we were offline.
+// If the queue is full the oldest message is dropped, because for telemetry the newest values are the most relevant.
+// Messages to formatted topics have to be stored as DispatchMessage, which copies the topic.
+template <size_t PayloadSize, size_t Capacity, typename Entry = OutboundMessage<PayloadSize>>
+class OutboundQueue
+{
+
+public:
+  using Message = Entry;
+
+  inline OutboundQueue()
+      : head(0U), count(0U), dropped(0U)
+  {
+  }
+
+  inline const bool empty() const
+  {
+    return count == 0U;
+  }
+
+  inline const size_t size() const
+  {
+    return count;
+  }
+
+  inline const uint32_t droppedMessages() const
+  {
+    return dropped;
+  }
+
+  inline const bool push(const char *topic, const char *payload, const size_t length)
+  {
+    if (payload == nullptr || !Message::fits(topic, length) || Capacity == 0U)
+    {
+      return false;
+    }
+    if (count == Capacity)
+    {
+      pop();
+      dropped++;
+    }
+
+    messages[(head + count) % Capacity].assign(topic, payload, length);
+    count++;
+    return true;
+  }
+
+  inline const Message &front() const
+  {
+    return messages[head];
+  }
+
+  // Message at the given position counted from the oldest one.
+  inline const Message &at(const size_t index) const
+  {
+    return messages[(head + index) % Capacity];
+  }
+
+  inline void pop()
+  {
+    if (count == 0U)
+    {
+      return;
+    }
+    head = (head + 1U) % Capacity;
+    count--;
+  }
+
+  inline void clear()
+  {
+    head = 0U;
+    count = 0U;
+  }
+
+private:
+  Message messages[Capacity == 0U ? 1U : Capacity];
+  size_t head;
+  size_t count;
+  uint32_t dropped;
+};
+
+#if defined(ESP8266) || defined(ESP32)
+
+// Bounded lock free queue of messages, any amount of tasks can push while one single consumer task pops.
+// Every slot carries a sequence number that tells producers and the consumer whose turn it is, so pushing never waits for a lock
+// and the consumer never touches a slot a producer is still copying into. The capacity has to be a power of two.
+template <typename Message, size_t Capacity>
+class ProducerQueue
+{
+  static_assert(Capacity >= 2U && (Capacity & (Capacity - 1U)) == 0U, "Capacity of the ProducerQueue has to be a power of two");
+
+public:
+
+  inline ProducerQueue()
+      : enqueuePosition(0U), dequeuePosition(0U), contended(0U), dropped(0U)
+  {
+    for (size_t i = 0; i < Capacity; i++)
+    {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Never blocks and never logs, so it is safe to call from any task. Returns false if the queue is full.
+  // Not meant for interrupts, the copy runs from flash and callers usually serialize JSON with floats before calling it.
+  // Additional fields are passed on to the assign method of the message.
+  template <typename... Fields>
+  inline const bool tryPush(const char *topic, const char *payload, const size_t length, const Fields &...fields)
+  {
+    if (payload == nullptr || !Message::fits(topic, length))
+    {
+      return false;
+    }
+
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    Slot *slot = nullptr;
+    while (true)
+    {
+      slot = &slots[position & (Capacity - 1U)];
+      const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+      if (difference == 0)
+      {
+        // Claim the slot, if another producer was faster the position is reloaded by the failed exchange.
+        if (enqueuePosition.compare_exchange_weak(position, position + 1U, std::memory_order_relaxed))
+        {
+          break;
+        }
+        contended.fetch_add(1U, std::memory_order_relaxed);
+      }
+      else if (difference < 0)
+      {
+        dropped.fetch_add(1U, std::memory_order_relaxed);
+        return false;
+      }
+      else
+      {
+        position = enqueuePosition.load(std::memory_order_relaxed);
+      }
+    }
+
+    slot->message.assign(topic, payload, length, fields...);
+    // Hands the slot over to the consumer.
+    slot->sequence.store(position + 1U, std::memory_order_release);
+    return true;
+  }
+
+  // Oldest completely written message or nullptr if there is none, only the consumer may call front and pop.
+  // The consumer owns the message until it pops it and may modify it in place.
+  inline Message *front()
+  {
+    Slot &slot = slots[dequeuePosition & (Capacity - 1U)];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeuePosition + 1U)
+    {
+      return nullptr;
+    }
+    return &slot.message;
+  }
+
+  inline void pop()
+  {
+    Slot &slot = slots[dequeuePosition & (Capacity - 1U)];
+    // Hands the slot back to the producers for the next round through the buffer.
+    slot.sequence.store(dequeuePosition + Capacity, std::memory_order_release);
+    dequeuePosition++;
+  }
+
+  // Amount of times a producer lost the race for a slot against another producer and had to retry.
+  inline const uint32_t contention() const
+  {
+    return contended.load(std::memory_order_relaxed);
+  }
+
+  inline const uint32_t droppedMessages() const
+  {
+    return dropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Slot
+  {
+    std::atomic<size_t> sequence;
+    Message message;
+  };
+
+  Slot slots[Capacity];
+  std::atomic<size_t> enqueuePosition;
+  size_t dequeuePosition;
+  std::atomic<uint32_t> contended;
+  std::atomic<uint32_t> dropped;
+};
+
+#endif // defined(ESP8266) || defined(ESP32)
+
+#endif // QUEUE_H
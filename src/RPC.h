@@ -5,22 +5,67 @@
 
 constexpr char *RPC_TOPIC  PROGMEM = "v1/devices/me/rpc";
 constexpr char *RPC_SUBSCRIBE_TOPIC  PROGMEM = "v1/devices/me/rpc/request/+";
+constexpr char *RPC_REQUEST_TOPIC  PROGMEM = "v1/devices/me/rpc/request/%u";
+constexpr char *RPC_RESPONSE_TOPIC  PROGMEM = "v1/devices/me/rpc/response";
+constexpr char *RPC_RESPONSE_SUBSCRIBE_TOPIC  PROGMEM = "v1/devices/me/rpc/response/+";
+constexpr char *RPC_SERVER_RESPONSE_TOPIC  PROGMEM = "v1/devices/me/rpc/response/%s";
 
 constexpr char *RPC_METHOD_KEY  PROGMEM = "method";
 constexpr char *RPC_PARAMS_KEY  PROGMEM = "params";
 constexpr char *RPC_REQUEST_KEY  PROGMEM = "request";
 constexpr char *RPC_RESPONSE_KEY  PROGMEM = "response";
 
+// Amount of device side RPC requests that can await their response at once, a power of two keeps mapping ids to entries cheap.
+#ifndef MAX_PENDING_RPC_REQUESTS
+#define MAX_PENDING_RPC_REQUESTS 4
+#endif
+#define DEFAULT_RPC_REQUEST_TIMEOUT 5000U
+
 using RPCResponse = Telemetry;
 using RPCData = const JsonVariantConst;
 
+// Device side call of a server method, the callback receives the response or onTimeout is called if none arrived in time.
+class RPCRequestCallback
+{
+    template <size_t PayloadSize, typename Capacities, typename Logger, typename Encoding>
+    friend class RPCTemplate;
+
+public:
+    using processFn = InplaceFunction<void(const RPCData &data)>;
+    using timeoutFn = InplaceFunction<void()>;
+
+    inline RPCRequestCallback()
+        : callbackFunction(nullptr), timeoutFunction(nullptr), timeout(DEFAULT_RPC_REQUEST_TIMEOUT) {}
+
+    inline RPCRequestCallback(processFn callback, const uint32_t timeout = DEFAULT_RPC_REQUEST_TIMEOUT, timeoutFn onTimeout = nullptr)
+        : callbackFunction(callback), timeoutFunction(onTimeout), timeout(timeout) {}
+
+private:
+    processFn callbackFunction;
+    timeoutFn timeoutFunction;
+    uint32_t timeout;
+};
+
+// Identifies a pending device side RPC request, an id of 0 means the request could not be sent.
+struct RPCRequestHandle
+{
+    uint32_t id;
+
+    inline const bool valid() const
+    {
+        return id != 0U;
+    }
+};
+
 class RPCCallback
 {
-    template <size_t PayloadSize, size_t MaxFieldsElement, typename Logger>
+    template <size_t PayloadSize, typename Capacities, typename Logger, typename Encoding>
     friend class RPCTemplate;
+    template <size_t PayloadSize, typename Capacities, typename Logger, typename Encoding>
+    friend class GatewayTemplate;
 
 public:
-    using processFunction = std::function<RPCResponse(const RPCData &data)>;
+    using processFunction = InplaceFunction<RPCResponse(const RPCData &data)>;
 
     inline RPCCallback()
         : methodName(), callbackFunction(nullptr) {}
@@ -35,22 +80,22 @@ private:
 
 template <
     size_t PayloadSize,
-    size_t MaxFieldsElement,
-    typename Logger = Logger>
+    typename Capacities,
+    typename Logger = Logger,
+    typename Encoding = JsonEncoding>
 class RPCTemplate : public Base
 {
 
 public:
-    inline RPCTemplate(PubSubClient *mqttClient, bool *enableQos) : Base(mqttClient, enableQos)
+    inline RPCTemplate(PubSubClient *mqttClient, bool *enableQos, SubscriptionRegistry *subscriptions) : Base(mqttClient, enableQos, subscriptions)
     {
-        this->reserveCallbakSize();
         Logger::log("rpc template created");
     }
 
     inline const bool unsubscribeFromRPC()
     {
         this->rpcCallbacks.clear();
-        return (*this->mqttClient).unsubscribe(RPC_SUBSCRIBE_TOPIC);
+        return (*this->subscriptions).unsubscribe(RPC_SUBSCRIBE_TOPIC);
     }
 
     inline bool isRPCMessage(const char *const topic)
@@ -58,12 +103,152 @@ public:
         return strncmp_P(topic, RPC_TOPIC, strlen(RPC_TOPIC)) == 0;
     }
 
+    // Has to be checked before isRPCMessage, because the response topic starts with the RPC topic as well.
+    inline bool isRPCResponseMessage(const char *const topic)
+    {
+        return strncmp_P(topic, RPC_RESPONSE_TOPIC, strlen(RPC_RESPONSE_TOPIC)) == 0;
+    }
+
+    // Calls the method on the server, returns right away and passes the response to the callback once it arrives.
+    // Every id maps to exactly one entry of the pending table, so the response is matched without searching. Ids whose entry is
+    // still in use are skipped, so one slow request does not block the others, which is why ids are not always consecutive.
+    inline const RPCRequestHandle RPCRequest(const char *methodName, const JsonVariantConst &params, const RPCRequestCallback &callback)
+    {
+        const RPCRequestHandle invalid = {0U};
+        if (methodName == nullptr)
+        {
+            Logger::log(RPC_METHOD_NULL);
+            return invalid;
+        }
+        uint32_t id = this->requestId;
+        PendingRequest *free = nullptr;
+        for (size_t probe = 0U; probe < MAX_PENDING_RPC_REQUESTS && free == nullptr; probe++)
+        {
+            // 0 marks a free entry and an invalid handle, so it is never used as an id.
+            if (++id == 0U)
+            {
+                id++;
+            }
+            if (this->pendingRequests[id % MAX_PENDING_RPC_REQUESTS].id == 0U)
+            {
+                free = &this->pendingRequests[id % MAX_PENDING_RPC_REQUESTS];
+            }
+        }
+        if (free == nullptr)
+        {
+            Logger::log(MAX_RPC_REQUESTS_EXCEEDED);
+            return invalid;
+        }
+        PendingRequest &pending = *free;
+        if (!(*subscriptions).isSubscribed(RPC_RESPONSE_SUBSCRIBE_TOPIC) && !(*subscriptions).subscribe(RPC_RESPONSE_SUBSCRIBE_TOPIC))
+        {
+            return invalid;
+        }
+
+        StaticJsonDocument<JSON_OBJECT_SIZE(2)> requestBuffer;
+        requestBuffer[static_cast<const char *>(RPC_METHOD_KEY)] = methodName;
+        if (!params.isNull())
+        {
+            requestBuffer[static_cast<const char *>(RPC_PARAMS_KEY)] = params;
+        }
+        const uint32_t json_size = JSON_STRING_SIZE(Encoding::measure(requestBuffer));
+        if (json_size > PayloadSize)
+        {
+            Logger::log(LogMessage(INVALID_BUFFER_SIZE, PayloadSize, json_size).c_str());
+            return invalid;
+        }
+        char requestPayload[PayloadSize];
+        const size_t requestLength = Encoding::serialize(requestBuffer, requestPayload, sizeof(requestPayload));
+
+        const FormattedTopic topic(RPC_REQUEST_TOPIC, id);
+        if (!publish(topic.c_str(), requestPayload, requestLength, PRIORITY_RPC))
+        {
+            return invalid;
+        }
+        this->requestId = id;
+        pending.id = id;
+        pending.deadline = millis() + callback.timeout;
+        pending.callback = callback;
+        const RPCRequestHandle handle = {id};
+        return handle;
+    }
+
+    // Forgets the request, neither its callback nor its timeout is called anymore.
+    inline void cancelRPCRequest(const RPCRequestHandle &handle)
+    {
+        PendingRequest &pending = this->pendingRequests[handle.id % MAX_PENDING_RPC_REQUESTS];
+        if (handle.valid() && pending.id == handle.id)
+        {
+            pending.id = 0U;
+        }
+    }
+
+    inline void processRPCResponseMessage(char *topic, uint8_t *payload, uint32_t length)
+    {
+        const uint32_t response_id = atoi(topic + strlen(RPC_RESPONSE_TOPIC) + 1U);
+        PendingRequest &pending = this->pendingRequests[response_id % MAX_PENDING_RPC_REQUESTS];
+        if (response_id == 0U || pending.id != response_id)
+        {
+            Logger::log(LogMessage(RPC_RESPONSE_UNKNOWN, response_id).c_str());
+            return;
+        }
+
+        StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::inboundFields)> jsonBuffer;
+        DeserializationError deserializationPayloadError = Encoding::deserialize(jsonBuffer, payload, length);
+        if (deserializationPayloadError)
+        {
+            Logger::log(UNABLE_TO_DE_SERIALIZE_RPC);
+            return;
+        }
+
+        // Freed before calling, so the callback can already send the next request.
+        const RPCRequestCallback callback = pending.callback;
+        pending.id = 0U;
+        if (callback.callbackFunction != nullptr)
+        {
+            callback.callbackFunction(jsonBuffer.template as<JsonVariantConst>());
+        }
+    }
+
+    // Frees the entries of requests whose response did not arrive in time, called once per loop iteration.
+    inline void checkRPCRequestTimeouts()
+    {
+        const uint32_t now = millis();
+        for (PendingRequest &pending : this->pendingRequests)
+        {
+            if (pending.id == 0U || static_cast<int32_t>(now - pending.deadline) < 0)
+            {
+                continue;
+            }
+            Logger::log(LogMessage(RPC_REQUEST_TIMED_OUT, pending.id).c_str());
+            const RPCRequestCallback callback = pending.callback;
+            pending.id = 0U;
+            if (callback.timeoutFunction != nullptr)
+            {
+                callback.timeoutFunction();
+            }
+        }
+    }
+
+    inline const bool unsubscribeFromRPCResponses()
+    {
+        for (PendingRequest &pending : this->pendingRequests)
+        {
+            pending.id = 0U;
+        }
+        return (*subscriptions).unsubscribe(RPC_RESPONSE_SUBSCRIBE_TOPIC);
+    }
+
     inline void processRPCMessage(char *topic, uint8_t *payload, uint32_t length)
     {
         RPCResponse rpcResponse;
         {
-            StaticJsonDocument<JSON_OBJECT_SIZE(MaxFieldsElement)> jsonBuffer;
-            DeserializationError deserializationPayloadError = deserializeJson(jsonBuffer, payload, length);
+            // Only the method and the params are used, any other field the server adds is skipped while parsing.
+            StaticJsonDocument<JSON_OBJECT_SIZE(2)> filter;
+            filter[static_cast<const char *>(RPC_METHOD_KEY)] = true;
+            filter[static_cast<const char *>(RPC_PARAMS_KEY)] = true;
+            StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::inboundFields)> jsonBuffer;
+            DeserializationError deserializationPayloadError = Encoding::deserialize(jsonBuffer, payload, length, filter);
 
             if (deserializationPayloadError)
             {
@@ -73,7 +258,7 @@ public:
 
             const JsonObject &data = jsonBuffer.template as<JsonObject>();
             const char *methodName = data[RPC_METHOD_KEY].as<const char *>();
-            const char *params = data[RPC_PARAMS_KEY].as<const char *>();
+            const JsonString params = data[RPC_PARAMS_KEY].as<JsonString>();
 
             if (methodName)
             {
@@ -106,22 +291,25 @@ public:
                     Logger::log(NO_RPC_PARAMS_PASSED);
                 }
 
-                StaticJsonDocument<JSON_OBJECT_SIZE(MaxFieldsElement)> doc;
-                DeserializationError paramDeserializationError = deserializeJson(doc, params);
+                // Params sent as a string hold an encoded document themselves, in the same encoding as the request.
+                StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::inboundFields)> doc;
+                const bool encodedParams = !params.isNull() && !Encoding::deserialize(doc, params.c_str(), params.size());
                 Logger::log(RPC_PARAMS_KEY);
 
-                if (paramDeserializationError)
+                if (!encodedParams)
                 {
                     const JsonVariant &param = data[RPC_PARAMS_KEY].as<JsonVariant>();
-                    const uint32_t json_size = JSON_STRING_SIZE(measureJson(param));
-                    char json[json_size];
-                    serializeJson(param, json, json_size);
+                    char json[PayloadSize];
+                    serializeJson(param, json, sizeof(json));
                     Logger::log(json);
                     rpcResponse = callback.callbackFunction(param);
                 }
                 else
                 {
-                    Logger::log(params);
+                    if (!Encoding::binary)
+                    {
+                        Logger::log(params.c_str());
+                    }
                     const JsonObject &param = doc.template as<JsonObject>();
                     rpcResponse = callback.callbackFunction(param);
                 }
@@ -129,7 +317,7 @@ public:
             }
         }
         // Fill in response
-        char responsePayload[PayloadSize] = {0};
+        char responsePayload[Capacities::responseSize] = {0};
         StaticJsonDocument<JSON_OBJECT_SIZE(1)> responseBuffer;
         JsonVariant responseObject = responseBuffer.template to<JsonVariant>();
 
@@ -139,23 +327,24 @@ public:
             return;
         }
 
-        const uint32_t json_size = JSON_STRING_SIZE(measureJson(responseBuffer));
-        if (json_size > PayloadSize)
+        const uint32_t json_size = JSON_STRING_SIZE(Encoding::measure(responseBuffer));
+        if (json_size > Capacities::responseSize)
         {
-            char message[detectSizeOf(INVALID_BUFFER_SIZE, PayloadSize, json_size)];
-            snprintf_P(message, sizeof(message), INVALID_BUFFER_SIZE, PayloadSize, json_size);
-            Logger::log(message);
+            Logger::log(LogMessage(INVALID_BUFFER_SIZE, Capacities::responseSize, json_size).c_str());
             return;
         }
 
-        serializeJson(responseObject, responsePayload, sizeof(responsePayload));
+        const size_t responseLength = Encoding::serialize(responseObject, responsePayload, sizeof(responsePayload));
 
-        String responseTopic = topic;
-        responseTopic.replace(RPC_REQUEST_KEY, RPC_RESPONSE_KEY);
+        // The response is published under the id of the request, the last level of the request topic.
+        const FormattedTopic responseTopic(RPC_SERVER_RESPONSE_TOPIC, strrchr(topic, '/') + 1U);
         Logger::log(RPC_RESPONSE_KEY);
         Logger::log(responseTopic.c_str());
-        Logger::log(responsePayload);
-        (*this->mqttClient).publish(responseTopic.c_str(), responsePayload, this->mqttQoS);
+        if (!Encoding::binary)
+        {
+            Logger::log(responsePayload);
+        }
+        publish(responseTopic.c_str(), responsePayload, responseLength, PRIORITY_RPC);
     }
 
     template <class InputIterator>
@@ -164,10 +353,10 @@ public:
         const uint32_t size = std::distance(first_itr, last_itr);
         if (this->rpcCallbacks.size() + size > this->rpcCallbacks.capacity())
         {
-            Logger::log(MAX_RPC_EXCEEDED);
+            Logger::log(LogMessage(MAX_RPC_EXCEEDED, Capacities::rpcMethods).c_str());
             return false;
         }
-        if (!(*mqttClient).subscribe(RPC_SUBSCRIBE_TOPIC, (*mqttQoS) ? 1 : 0))
+        if (size != 0U && !(*subscriptions).subscribe(RPC_SUBSCRIBE_TOPIC))
         {
             return false;
         }
@@ -180,10 +369,10 @@ public:
     {
         if (this->rpcCallbacks.size() + 1 > this->rpcCallbacks.capacity())
         {
-            Logger::log(MAX_RPC_EXCEEDED);
+            Logger::log(LogMessage(MAX_RPC_EXCEEDED, Capacities::rpcMethods).c_str());
             return false;
         }
-        if (!(*mqttClient).subscribe(RPC_SUBSCRIBE_TOPIC, (*mqttQoS) ? 1 : 0))
+        if (!(*subscriptions).subscribe(RPC_SUBSCRIBE_TOPIC))
         {
             return false;
         }
@@ -196,16 +385,20 @@ public:
     inline const bool RPCUnsubscribe()
     {
         this->rpcCallbacks.clear();
-        return (*mqttClient).unsubscribe(RPC_SUBSCRIBE_TOPIC);
+        return (*subscriptions).unsubscribe(RPC_SUBSCRIBE_TOPIC);
     }
 
 private:
-    std::vector<RPCCallback> rpcCallbacks;
-
-    inline void reserveCallbakSize(void)
+    struct PendingRequest
     {
-        this->rpcCallbacks.reserve(MaxFieldsElement);
-    }
+        uint32_t id; // 0 if the entry is free
+        uint32_t deadline;
+        RPCRequestCallback callback;
+    };
+
+    StaticVector<RPCCallback, Capacities::rpcMethods> rpcCallbacks;
+    PendingRequest pendingRequests[MAX_PENDING_RPC_REQUESTS] = {};
+    uint32_t requestId = 0U;
 };
 
 #endif // RPC_H
\ No newline at end of file
@@ -0,0 +1,210 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "Arduino.h"
+#include "Queue.h"
+
+#ifndef MAX_SCHEDULED_MESSAGES
+#define MAX_SCHEDULED_MESSAGES 2
+#endif
+
+// Classes of outbound messages, ordered from the most to the least latency critical.
+enum MessagePriority : uint8_t
+{
+  PRIORITY_RPC,       // Responses to server side and requests of client side RPCs
+  PRIORITY_FIRMWARE,  // Firmware info and state updates
+  PRIORITY_ATTRIBUTE, // Client side attributes, shared attribute requests and gateway device announcements
+  PRIORITY_TELEMETRY, // Bulk data
+  PRIORITY_COUNT,
+};
+
+// Message that keeps the class it has to be published with, for queues that are drained by another task.
+template <size_t PayloadSize>
+struct PrioritizedMessage : public OutboundMessage<PayloadSize>
+{
+  MessagePriority priority;
+
+  inline void assign(const char *topic, const char *payload, const size_t length, const MessagePriority priority)
+  {
+    OutboundMessage<PayloadSize>::assign(topic, payload, length);
+    this->priority = priority;
+  }
+};
+
+// Allows bursts of up to burst messages and afterwards one message every refillInterval milliseconds.
+// A refillInterval of 0 disables the limit.
+class TokenBucket
+{
+
+public:
+  inline TokenBucket()
+      : burst(0U), refillInterval(0U), tokens(0U), refilledAt(0U)
+  {
+  }
+
+  inline void configure(const uint16_t burst, const uint32_t refillInterval, const uint32_t now)
+  {
+    this->burst = burst;
+    this->refillInterval = refillInterval;
+    this->tokens = burst;
+    this->refilledAt = now;
+  }
+
+  inline const bool take(const uint32_t now)
+  {
+    if (this->refillInterval == 0U)
+    {
+      return true;
+    }
+    refill(now);
+    if (this->tokens == 0U)
+    {
+      return false;
+    }
+    this->tokens--;
+    return true;
+  }
+
+  // Returns a token taken for a message that could not be published after all.
+  inline void giveBack()
+  {
+    if (this->refillInterval != 0U && this->tokens < this->burst)
+    {
+      this->tokens++;
+    }
+  }
+
+private:
+  uint16_t burst;
+  uint32_t refillInterval;
+  uint16_t tokens;
+  uint32_t refilledAt;
+
+  inline void refill(const uint32_t now)
+  {
+    const uint32_t earned = (now - this->refilledAt) / this->refillInterval;
+    if (earned == 0U)
+    {
+      return;
+    }
+    else if (earned >= static_cast<uint32_t>(this->burst - this->tokens))
+    {
+      this->tokens = this->burst;
+      this->refilledAt = now;
+      return;
+    }
+    this->tokens += earned;
+    // Keep the started interval, so the fraction of the next token is not lost.
+    this->refilledAt += earned * this->refillInterval;
+  }
+};
+
+// Holds back outbound messages per priority class and rate limits every class with its own token bucket.
+// A message is published right away if its class has nothing queued and a token left, otherwise it is queued and drained
+// by priority, so a backlog of telemetry never delays an RPC response or firmware state update. The topic is copied,
+// because responses and requests are published to topics that contain their id.
+template <size_t PayloadSize, size_t Capacity>
+class OutboundScheduler
+{
+
+public:
+  using Message = DispatchMessage<PayloadSize>;
+
+  inline OutboundScheduler()
+      : queues(), buckets()
+  {
+  }
+
+  inline void setRateLimit(const MessagePriority priority, const uint16_t burst, const uint32_t refillInterval, const uint32_t now)
+  {
+    this->buckets[priority].configure(burst, refillInterval, now);
+  }
+
+  // True if a message of the given class may be published right away, takes its token if so.
+  inline const bool admit(const MessagePriority priority, const uint32_t now)
+  {
+    return this->queues[priority].empty() && this->buckets[priority].take(now);
+  }
+
+  inline void giveBack(const MessagePriority priority)
+  {
+    this->buckets[priority].giveBack();
+  }
+
+  inline const bool push(const MessagePriority priority, const char *topic, const char *payload, const size_t length)
+  {
+    return this->queues[priority].push(topic, payload, length);
+  }
+
+  // Publishes queued messages from the highest to the lowest priority, as long as their class has tokens left.
+  // Stops at the first message that could not be published, because the connection is most likely gone.
+  template <typename Publish>
+  inline void drain(const uint32_t now, Publish publish)
+  {
+    for (size_t priority = 0U; priority < PRIORITY_COUNT; priority++)
+    {
+      Queue &queue = this->queues[priority];
+      while (!queue.empty() && this->buckets[priority].take(now))
+      {
+        if (!publish(queue.front()))
+        {
+          this->buckets[priority].giveBack();
+          return;
+        }
+        queue.pop();
+      }
+    }
+  }
+
+  // Hands every queued message to take over regardless of the rate limits and empties the queues, for example before a deep sleep.
+  template <typename Take>
+  inline void release(Take take)
+  {
+    for (Queue &queue : this->queues)
+    {
+      while (!queue.empty())
+      {
+        take(queue.front());
+        queue.pop();
+      }
+    }
+  }
+
+  inline const bool empty() const
+  {
+    for (const Queue &queue : this->queues)
+    {
+      if (!queue.empty())
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  inline const size_t size(const MessagePriority priority) const
+  {
+    return this->queues[priority].size();
+  }
+
+  inline const uint32_t droppedMessages(const MessagePriority priority) const
+  {
+    return this->queues[priority].droppedMessages();
+  }
+
+  inline void clear()
+  {
+    for (Queue &queue : this->queues)
+    {
+      queue.clear();
+    }
+  }
+
+private:
+  using Queue = OutboundQueue<PayloadSize, Capacity, Message>;
+
+  Queue queues[PRIORITY_COUNT];
+  TokenBucket buckets[PRIORITY_COUNT];
+};
+
+#endif // SCHEDULER_H
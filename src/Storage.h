@@ -0,0 +1,103 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include "Arduino.h"
+
+#if defined(ESP32)
+#include <Preferences.h>
+#elif defined(ESP8266)
+#include <LittleFS.h>
+#include "Format.h"
+
+// LittleFS file names have at most 32 characters, plus the leading slash and the null terminator.
+#define MAX_STORAGE_PATH_LENGTH 34U
+
+constexpr char *STORAGE_PATH PROGMEM = "/%s";
+#endif
+
+// Non volatile storage of named binary blobs, implement it for whatever the board offers (flash, EEPROM, FRAM or an SD card).
+class PersistentStorage
+{
+
+public:
+  virtual ~PersistentStorage() {}
+
+  // Copies the blob into the buffer, returns its length or 0 if there is none or it does not fit.
+  virtual size_t load(const char *name, uint8_t *buffer, size_t size) = 0;
+
+  virtual bool save(const char *name, const uint8_t *data, size_t length) = 0;
+};
+
+#if defined(ESP32)
+
+constexpr char *STORAGE_NAMESPACE PROGMEM = "thingspod";
+
+// Keeps every blob as one key of the thingspod namespace in the non volatile storage partition.
+class PreferencesStorage : public PersistentStorage
+{
+
+public:
+  size_t load(const char *name, uint8_t *buffer, size_t size) override
+  {
+    Preferences preferences;
+    if (!preferences.begin(STORAGE_NAMESPACE, true))
+    {
+      return 0U;
+    }
+    const size_t length = preferences.getBytesLength(name);
+    const size_t read = (length != 0U && length <= size) ? preferences.getBytes(name, buffer, size) : 0U;
+    preferences.end();
+    return read;
+  }
+
+  bool save(const char *name, const uint8_t *data, size_t length) override
+  {
+    Preferences preferences;
+    if (!preferences.begin(STORAGE_NAMESPACE, false))
+    {
+      return false;
+    }
+    const bool success = preferences.putBytes(name, data, length) == length;
+    preferences.end();
+    return success;
+  }
+};
+
+#elif defined(ESP8266)
+
+// Keeps every blob as one file in the root directory, the application has to call LittleFS.begin() beforehand.
+class LittleFSStorage : public PersistentStorage
+{
+
+public:
+  size_t load(const char *name, uint8_t *buffer, size_t size) override
+  {
+    const FormatBuffer<MAX_STORAGE_PATH_LENGTH> path(STORAGE_PATH, name);
+    File file = LittleFS.open(path.c_str(), "r");
+    if (!file)
+    {
+      return 0U;
+    }
+    const size_t length = file.size();
+    const size_t read = length <= size ? file.read(buffer, length) : 0U;
+    file.close();
+    return read;
+  }
+
+  bool save(const char *name, const uint8_t *data, size_t length) override
+  {
+    const FormatBuffer<MAX_STORAGE_PATH_LENGTH> path(STORAGE_PATH, name);
+    File file = LittleFS.open(path.c_str(), "w");
+    if (!file)
+    {
+      return false;
+    }
+    const bool success = file.write(data, length) == length;
+    file.close();
+    return success;
+  }
+};
+
+#endif
+
+#endif // STORAGE_H
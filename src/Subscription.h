@@ -0,0 +1,164 @@
+#ifndef SUBSCRIPTION_H
+#define SUBSCRIPTION_H
+
+#include "Arduino.h"
+#include "PubSubClient.h"
+#include "Hash.h"
+
+#define MAX_SUBSCRIBED_TOPICS 8
+
+constexpr uint8_t MQTT_SUBSCRIBE_PACKET PROGMEM = 0x82; // SUBSCRIBE packet type with the reserved flags (0b0010) set.
+
+// Keeps track of every topic we are subscribed to on the broker. A SUBSCRIBE is only sent if the topic is not subscribed yet,
+// the modules unsubscribe a topic once their last callback on it is gone.
+class SubscriptionRegistry
+{
+
+public:
+  inline SubscriptionRegistry(PubSubClient *mqttClient, bool *enableQos)
+      : mqttClient(mqttClient), mqttQoS(enableQos), topicCount(0U), packetId(0U), persistent(false)
+  {
+  }
+
+  // When persistent, topics registered while disconnected are kept and sent by the next resubscribe() instead of failing.
+  inline void setPersistent(const bool persistent)
+  {
+    this->persistent = persistent;
+  }
+
+  inline const bool isSubscribed(const char *topic) const
+  {
+    return findTopic(topic) < topicCount;
+  }
+
+  inline const size_t size() const
+  {
+    return topicCount;
+  }
+
+  // Changes whenever a topic is added or removed or the QoS changes, tells whether a persistent broker session still holds every topic.
+  inline const uint32_t fingerprint() const
+  {
+    uint32_t result = hashString(nullptr) ^ ((*mqttQoS) ? 1U : 0U);
+    for (size_t i = 0; i < topicCount; i++)
+    {
+      result = (result ^ hashString(topics[i])) * 16777619U;
+    }
+    return result;
+  }
+
+  // Sends a SUBSCRIBE if the topic was not subscribed yet.
+  inline const bool subscribe(const char *topic)
+  {
+    if (isSubscribed(topic))
+    {
+      return true;
+    }
+    else if (topicCount >= MAX_SUBSCRIBED_TOPICS)
+    {
+      return false;
+    }
+    const bool deferred = persistent && !(*mqttClient).connected();
+    if (!deferred && !(*mqttClient).subscribe(topic, (*mqttQoS) ? 1 : 0))
+    {
+      return false;
+    }
+
+    topics[topicCount++] = topic;
+    return true;
+  }
+
+  // Sends an UNSUBSCRIBE if the topic was subscribed.
+  inline const bool unsubscribe(const char *topic)
+  {
+    const size_t index = findTopic(topic);
+    if (index >= topicCount)
+    {
+      return true;
+    }
+
+    for (size_t i = index + 1U; i < topicCount; i++)
+    {
+      topics[i - 1U] = topics[i];
+    }
+    topicCount--;
+    return (*mqttClient).unsubscribe(topic);
+  }
+
+  // Forgets all topics without sending anything, used when the broker dropped our session (clean session connect).
+  inline void clear()
+  {
+    topicCount = 0U;
+  }
+
+  // Restores every registered topic with one single SUBSCRIBE packet, used after reconnecting with a clean session.
+  inline const bool resubscribe()
+  {
+    if (topicCount == 0U)
+    {
+      return true;
+    }
+
+    const uint8_t qos = (*mqttQoS) ? 1U : 0U;
+    uint32_t remainingLength = 2U; // Packet identifier
+    for (size_t i = 0; i < topicCount; i++)
+    {
+      remainingLength += 2U + strlen(topics[i]) + 1U; // Topic length, topic and requested QoS
+    }
+
+    packetId++;
+    if (packetId == 0U)
+    {
+      packetId++;
+    }
+
+    uint8_t header[7U];
+    uint8_t headerLength = 0U;
+    header[headerLength++] = MQTT_SUBSCRIBE_PACKET;
+    do
+    {
+      uint8_t digit = remainingLength % 128U;
+      remainingLength /= 128U;
+      if (remainingLength > 0U)
+      {
+        digit |= 0x80;
+      }
+      header[headerLength++] = digit;
+    } while (remainingLength > 0U);
+    header[headerLength++] = packetId >> 8U;
+    header[headerLength++] = packetId & 0xFF;
+
+    bool success = (*mqttClient).write(header, headerLength) == headerLength;
+    for (size_t i = 0; success && i < topicCount; i++)
+    {
+      const uint16_t topicLength = strlen(topics[i]);
+      const uint8_t length[2U] = {static_cast<uint8_t>(topicLength >> 8U), static_cast<uint8_t>(topicLength & 0xFF)};
+      success = (*mqttClient).write(length, sizeof(length)) == sizeof(length) &&
+                (*mqttClient).write(reinterpret_cast<const uint8_t *>(topics[i]), topicLength) == topicLength &&
+                (*mqttClient).write(qos) == 1U;
+    }
+    return success;
+  }
+
+private:
+  PubSubClient *mqttClient;
+  bool *mqttQoS;
+  const char *topics[MAX_SUBSCRIBED_TOPICS];
+  size_t topicCount;
+  uint16_t packetId;
+  bool persistent;
+
+  inline const size_t findTopic(const char *topic) const
+  {
+    for (size_t i = 0; i < topicCount; i++)
+    {
+      if (topics[i] == topic || strcmp(topics[i], topic) == 0)
+      {
+        return i;
+      }
+    }
+    return topicCount;
+  }
+};
+
+#endif // SUBSCRIPTION_H
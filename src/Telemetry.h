@@ -5,6 +5,8 @@
 #include <ArduinoJson.h>
 
 constexpr char *TELEMETRY_TOPIC PROGMEM = "v1/devices/me/telemetry";
+constexpr char *TELEMETRY_TS_PREFIX PROGMEM = "{\"ts\":";
+constexpr char *TELEMETRY_VALUES_PREFIX PROGMEM = ",\"values\":";
 
 class Telemetry
 {
@@ -61,4 +63,26 @@ public:
 	data value;
 };
 
+// Telemetry values sampled at the same time, sent with a client side timestamp in the {"ts":ms,"values":{...}} format.
+class TelemetryRecord
+{
+
+public:
+	inline TelemetryRecord() : ts(0U), values(NULL), valuesCount(0U) {}
+
+	inline TelemetryRecord(const uint64_t ts, const Telemetry *values, const size_t valuesCount)
+		: ts(ts), values(values), valuesCount(valuesCount) {}
+
+	// Writes the record as JSON into the given buffer, the document is used to build the values object.
+	// Returns the amount of written characters without the null terminator or 0 if the record does not fit.
+	const size_t serialize(JsonDocument &jsonBuffer, char *buffer, const size_t size) const;
+
+	// Builds only the values object of the record in the given document.
+	const bool serializeValues(JsonDocument &jsonBuffer) const;
+
+	uint64_t ts;			  // Unix timestamp in milliseconds
+	const Telemetry *values;  // Values sampled at the timestamp
+	size_t valuesCount;		  // Amount of values
+};
+
 #endif // TELEMETRY_H
\ No newline at end of file
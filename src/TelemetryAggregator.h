@@ -0,0 +1,188 @@
+#ifndef TELEMETRY_AGGREGATOR_H
+#define TELEMETRY_AGGREGATOR_H
+
+#include "Arduino.h"
+#include "Telemetry.h"
+
+#define DEFAULT_AGGREGATED_KEYS 4
+#define MAX_AGGREGATED_KEY_LENGTH 24U
+#define AGGREGATED_VALUES_COUNT 5U
+// Encoded statistics of one window, every value as its quoted key with suffix, a colon, a number of up to 24 characters and a comma.
+#define AGGREGATED_RECORD_SIZE (2U + AGGREGATED_VALUES_COUNT * (MAX_AGGREGATED_KEY_LENGTH + 7U + 28U))
+
+constexpr char *AGGREGATE_KEY PROGMEM = "%s%s";
+constexpr char *AGGREGATE_MIN_SUFFIX PROGMEM = "_min";
+constexpr char *AGGREGATE_MAX_SUFFIX PROGMEM = "_max";
+constexpr char *AGGREGATE_MEAN_SUFFIX PROGMEM = "_mean";
+constexpr char *AGGREGATE_VARIANCE_SUFFIX PROGMEM = "_var";
+constexpr char *AGGREGATE_COUNT_SUFFIX PROGMEM = "_count";
+
+// Streaming statistics over one window, uses Welford's algorithm so no sample has to be kept.
+class TelemetryStatistics
+{
+
+public:
+  inline TelemetryStatistics()
+  {
+    reset();
+  }
+
+  inline void reset()
+  {
+    count = 0U;
+    min = 0.0f;
+    max = 0.0f;
+    mean = 0.0f;
+    m2 = 0.0f;
+  }
+
+  inline void add(const float value)
+  {
+    if (count == 0U || value < min)
+    {
+      min = value;
+    }
+    if (count == 0U || value > max)
+    {
+      max = value;
+    }
+    count++;
+    const float delta = value - mean;
+    mean += delta / count;
+    m2 += delta * (value - mean);
+  }
+
+  // Population variance of the samples in the window.
+  inline const float variance() const
+  {
+    return count == 0U ? 0.0f : m2 / count;
+  }
+
+  uint32_t count;
+  float min;
+  float max;
+  float mean;
+
+private:
+  float m2; // Sum of squared differences from the mean
+};
+
+// Aggregates high rate samples of numeric telemetry keys over tumbling windows, and emits one set of statistics per key and window,
+// instead of serializing and publishing every raw sample.
+template <size_t MaxKeys = DEFAULT_AGGREGATED_KEYS>
+class TelemetryAggregatorTemplate
+{
+
+public:
+  inline TelemetryAggregatorTemplate()
+      : keysCount(0U) {}
+
+  inline const bool add(const char *key, const uint32_t window)
+  {
+    if (key == nullptr || window == 0U || strlen(key) > MAX_AGGREGATED_KEY_LENGTH)
+    {
+      return false;
+    }
+    Entry *entry = find(key);
+    if (entry == nullptr)
+    {
+      if (keysCount >= MaxKeys)
+      {
+        return false;
+      }
+      entry = &entries[keysCount++];
+      entry->key = key;
+      entry->statistics.reset();
+    }
+    entry->window = window;
+    return true;
+  }
+
+  inline const bool remove(const char *key)
+  {
+    Entry *entry = find(key);
+    if (entry == nullptr)
+    {
+      return false;
+    }
+    *entry = entries[--keysCount];
+    return true;
+  }
+
+  // Adds the sample to the window of its key, emits the previous window first if it already elapsed.
+  // Returns false if the key is not aggregated or the value is not numeric, in which case the sample should be sent as is.
+  template <typename Emitter>
+  inline const bool sample(const Telemetry &telemetry, const uint32_t now, Emitter emit)
+  {
+    if (telemetry.type != Telemetry::INT && telemetry.type != Telemetry::REAL)
+    {
+      return false;
+    }
+    Entry *entry = find(telemetry.key);
+    if (entry == nullptr)
+    {
+      return false;
+    }
+
+    emitElapsed(*entry, now, emit);
+    if (entry->statistics.count == 0U)
+    {
+      entry->windowStart = now;
+    }
+    entry->statistics.add(telemetry.type == Telemetry::INT ? telemetry.value.integer : telemetry.value.real);
+    return true;
+  }
+
+  // Emits every window that elapsed, has to be called regularly so windows close even if no new samples arrive.
+  template <typename Emitter>
+  inline void flush(const uint32_t now, Emitter emit)
+  {
+    for (size_t i = 0; i < keysCount; i++)
+    {
+      emitElapsed(entries[i], now, emit);
+    }
+  }
+
+private:
+  struct Entry
+  {
+    const char *key;
+    uint32_t window;
+    uint32_t windowStart;
+    TelemetryStatistics statistics;
+  };
+
+  Entry entries[MaxKeys == 0U ? 1U : MaxKeys];
+  size_t keysCount;
+
+  inline Entry *find(const char *key)
+  {
+    if (key == nullptr)
+    {
+      return nullptr;
+    }
+    for (size_t i = 0; i < keysCount; i++)
+    {
+      if (entries[i].key == key || strcmp(entries[i].key, key) == 0)
+      {
+        return &entries[i];
+      }
+    }
+    return nullptr;
+  }
+
+  template <typename Emitter>
+  inline void emitElapsed(Entry &entry, const uint32_t now, Emitter &emit)
+  {
+    if (entry.statistics.count == 0U || now - entry.windowStart < entry.window)
+    {
+      return;
+    }
+    emit(entry.key, entry.statistics);
+    entry.statistics.reset();
+  }
+};
+
+using TelemetryAggregator = TelemetryAggregatorTemplate<>;
+
+#endif // TELEMETRY_AGGREGATOR_H
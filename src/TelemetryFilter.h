@@ -0,0 +1,189 @@
+#ifndef TELEMETRY_FILTER_H
+#define TELEMETRY_FILTER_H
+
+#include "Arduino.h"
+#include "Telemetry.h"
+#include "Hash.h"
+
+#define DEFAULT_FILTERED_KEYS 8
+
+// Settings of the report by exception filter for one telemetry key.
+class TelemetryFilterConfig
+{
+
+public:
+  enum deadbandType
+  {
+    ABSOLUTE, // Value has to change by more than the deadband
+    PERCENT,  // Value has to change by more than the deadband in percent of the last sent value
+  };
+
+  inline TelemetryFilterConfig(const float deadband = 0.0f, const deadbandType type = ABSOLUTE, const uint32_t minInterval = 0U, const uint32_t maxSilence = 0U)
+      : deadband(deadband), type(type), minInterval(minInterval), maxSilence(maxSilence) {}
+
+  float deadband;       // Changes smaller or equal to this are suppressed, 0 publishes every change
+  deadbandType type;    // How the deadband is applied
+  uint32_t minInterval; // Minimum time in milliseconds between two publishes of the key, 0 disables it
+  uint32_t maxSilence;  // Heartbeat, the value is published after this time in milliseconds even if it did not change, 0 disables it
+};
+
+// Report by exception stage in front of the telemetry path. Keeps the last sent value of every filtered key,
+// so a suppressed sample only costs a compare instead of a serialize and publish. Keys without a filter are always sent.
+template <size_t MaxKeys = DEFAULT_FILTERED_KEYS>
+class TelemetryFilterTemplate
+{
+
+public:
+  inline TelemetryFilterTemplate()
+      : keysCount(0U), suppressedCount(0U) {}
+
+  inline const bool add(const char *key, const TelemetryFilterConfig &config)
+  {
+    if (key == nullptr)
+    {
+      return false;
+    }
+    Entry *entry = find(key);
+    if (entry == nullptr)
+    {
+      if (keysCount >= MaxKeys)
+      {
+        return false;
+      }
+      entry = &entries[keysCount++];
+      entry->key = key;
+      entry->lastType = Telemetry::NONE;
+    }
+    entry->config = config;
+    return true;
+  }
+
+  inline const bool remove(const char *key)
+  {
+    Entry *entry = find(key);
+    if (entry == nullptr)
+    {
+      return false;
+    }
+    *entry = entries[--keysCount];
+    return true;
+  }
+
+  // Amount of values that were not published, because they did not change enough.
+  inline const uint32_t suppressed() const
+  {
+    return suppressedCount;
+  }
+
+  // Returns true if the value should be published, call markSent once it actually was.
+  inline const bool filter(const Telemetry &telemetry, const uint32_t now)
+  {
+    const Entry *entry = find(telemetry.key);
+    if (entry == nullptr || shouldSend(*entry, telemetry, now))
+    {
+      return true;
+    }
+    suppressedCount++;
+    return false;
+  }
+
+  inline void markSent(const Telemetry &telemetry, const uint32_t now)
+  {
+    Entry *entry = find(telemetry.key);
+    if (entry == nullptr)
+    {
+      return;
+    }
+    entry->lastType = telemetry.type;
+    entry->lastSent = now;
+    if (telemetry.type == Telemetry::STRING)
+    {
+      entry->lastHash = hashString(telemetry.value.string);
+    }
+    else
+    {
+      entry->lastValue = telemetry.value;
+    }
+  }
+
+private:
+  struct Entry
+  {
+    const char *key;
+    TelemetryFilterConfig config;
+    Telemetry::dataType lastType; // NONE as long as the key was never sent
+    uint32_t lastSent;
+    union
+    {
+      Telemetry::data lastValue;
+      uint32_t lastHash; // Strings are compared by hash, because the caller might reuse the same buffer for the next value
+    };
+  };
+
+  Entry entries[MaxKeys == 0U ? 1U : MaxKeys];
+  size_t keysCount;
+  uint32_t suppressedCount;
+
+  inline Entry *find(const char *key)
+  {
+    if (key == nullptr)
+    {
+      return nullptr;
+    }
+    for (size_t i = 0; i < keysCount; i++)
+    {
+      if (entries[i].key == key || strcmp(entries[i].key, key) == 0)
+      {
+        return &entries[i];
+      }
+    }
+    return nullptr;
+  }
+
+  static inline const bool exceedsDeadband(const Entry &entry, const float last, const float current)
+  {
+    const float difference = fabs(current - last);
+    const float threshold = entry.config.type == TelemetryFilterConfig::PERCENT ? fabs(last) * entry.config.deadband / 100.0f : entry.config.deadband;
+    return difference > threshold;
+  }
+
+  inline const bool shouldSend(const Entry &entry, const Telemetry &telemetry, const uint32_t now) const
+  {
+    if (entry.lastType == Telemetry::NONE)
+    {
+      return true;
+    }
+
+    const uint32_t elapsed = now - entry.lastSent;
+    if (entry.config.maxSilence != 0U && elapsed >= entry.config.maxSilence)
+    {
+      return true;
+    }
+    else if (elapsed < entry.config.minInterval)
+    {
+      return false;
+    }
+    else if (entry.lastType != telemetry.type)
+    {
+      return true;
+    }
+
+    switch (telemetry.type)
+    {
+    case Telemetry::BOOL:
+      return entry.lastValue.boolean != telemetry.value.boolean;
+    case Telemetry::INT:
+      return exceedsDeadband(entry, entry.lastValue.integer, telemetry.value.integer);
+    case Telemetry::REAL:
+      return exceedsDeadband(entry, entry.lastValue.real, telemetry.value.real);
+    case Telemetry::STRING:
+      return entry.lastHash != hashString(telemetry.value.string);
+    default:
+      return true;
+    }
+  }
+};
+
+using TelemetryFilter = TelemetryFilterTemplate<>;
+
+#endif // TELEMETRY_FILTER_H
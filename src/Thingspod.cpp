@@ -1,5 +1,6 @@
 
 #include "Telemetry.h"
+#include "Format.h"
 
 const bool Telemetry::serializeKeyValue(JsonVariant &jsonObj) const {
   if (key) {
@@ -38,4 +39,42 @@ const bool Telemetry::serializeKeyValue(JsonVariant &jsonObj) const {
     }
   }
   return true;
+}
+
+const bool TelemetryRecord::serializeValues(JsonDocument &jsonBuffer) const {
+  JsonVariant object = jsonBuffer.to<JsonObject>();
+  for (size_t i = 0; i < valuesCount; ++i) {
+    if (!values[i].serializeKeyValue(object)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const size_t TelemetryRecord::serialize(JsonDocument &jsonBuffer, char *buffer, const size_t size) const {
+  if (!serializeValues(jsonBuffer)) {
+    return 0;
+  }
+
+  char tsDigits[MAX_UNSIGNED_DIGITS];
+  const size_t tsLength = formatUnsigned(tsDigits, ts);
+  const size_t tsPrefixLength = strlen(TELEMETRY_TS_PREFIX);
+  const size_t valuesPrefixLength = strlen(TELEMETRY_VALUES_PREFIX);
+  const size_t valuesLength = measureJson(jsonBuffer);
+  // Prefixes, timestamp, values, the closing brace and the null terminator.
+  if (tsPrefixLength + tsLength + valuesPrefixLength + valuesLength + 2U > size) {
+    return 0;
+  }
+
+  size_t length = 0;
+  memcpy(buffer + length, TELEMETRY_TS_PREFIX, tsPrefixLength);
+  length += tsPrefixLength;
+  memcpy(buffer + length, tsDigits, tsLength);
+  length += tsLength;
+  memcpy(buffer + length, TELEMETRY_VALUES_PREFIX, valuesPrefixLength);
+  length += valuesPrefixLength;
+  length += serializeJson(jsonBuffer, buffer + length, size - length);
+  buffer[length++] = '}';
+  buffer[length] = '\0';
+  return length;
 }
\ No newline at end of file
@@ -4,34 +4,52 @@
 #include <Arduino.h>
 #include "PubSubClient.h"
 #include "ArduinoJson.h"
-#include <vector>
 
 #include "Provisioning.h"
 #include "Firmware.h"
 #include "Claiming.h"
 #include "Attribute.h"
 #include "Telemetry.h"
+#include "TelemetryFilter.h"
+#include "TelemetryAggregator.h"
 #include "Logger.h"
 #include "RPC.h"
+#include "Connection.h"
+#include "DutyCycle.h"
+#include "Queue.h"
+#include "Gateway.h"
+#include "Coroutine.h"
+#include "BufferedPrint.h"
+#include "Features.h"
+#include "Capacities.h"
 
 #define DEFAULT_PAYLOAD_SIZE 64
 #define DEFAULT_FIELDS_ELEMENT 32
 
 constexpr char *DEFAULT_CLIENT_ID PROGMEM = "thingspodDevice";
+#if defined(ESP32)
+constexpr char *DISPATCH_TASK_NAME PROGMEM = "thingspodDispatch";
+#endif
 
+// MaxFieldsElement sizes every callback container and JSON document alike, unless independent capacities are given with CapacityTraits.
 template <
 	size_t PayloadSize = DEFAULT_PAYLOAD_SIZE,
 	size_t MaxFieldsElement = DEFAULT_FIELDS_ELEMENT,
-	typename Logger = Logger>
+	typename Logger = Logger,
+	typename Encoding = JsonEncoding,
+	typename Features = AllFeatures,
+	typename Capacities = UniformCapacities<PayloadSize, MaxFieldsElement>>
 class ThingspodTemplate
 {
 
 public:
-	inline ThingspodTemplate(Client &wifiClient, PubSubClient *mqttClient, const bool &enableQoS = false)
-		: attribute(mqttClient, &mqttQoS),
-		  rpc(mqttClient, &mqttQoS),
-		  provisioning(mqttClient, &mqttQoS),
-		  firmware(mqttClient, &mqttQoS, &attribute)
+	inline ThingspodTemplate(Client &, PubSubClient *mqttClient, const bool &enableQoS = false)
+		: subscriptions(mqttClient, &mqttQoS),
+		  rpc(mqttClient, &mqttQoS, &subscriptions),
+		  attribute(mqttClient, &mqttQoS, &subscriptions),
+		  provisioning(mqttClient, &mqttQoS, &subscriptions),
+		  firmware(mqttClient, &mqttQoS, &subscriptions, &attribute),
+		  gateway(mqttClient, &mqttQoS, &subscriptions)
 	{
 		this->mqttQoS = enableQoS;
 		this->mqttClient = mqttClient;
@@ -39,10 +57,12 @@ public:
 
 	inline ThingspodTemplate(const bool &enableQoS = false)
 		: mqttClient(),
-		  attribute(&mqttClient, &mqttQoS),
-		  rpc(&mqttClient, &mqttQoS),
-		  provisioning(&mqttClient, &mqttQoS),
-		  firmware(&mqttClient, &mqttQoS, &attribute)
+		  subscriptions(mqttClient, &mqttQoS),
+		  rpc(mqttClient, &mqttQoS, &subscriptions),
+		  attribute(mqttClient, &mqttQoS, &subscriptions),
+		  provisioning(mqttClient, &mqttQoS, &subscriptions),
+		  firmware(mqttClient, &mqttQoS, &subscriptions, &attribute),
+		  gateway(mqttClient, &mqttQoS, &subscriptions)
 	{
 		this->mqttQoS = enableQoS;
 	}
@@ -62,32 +82,170 @@ public:
 		this->mqttQoS = enableQoS;
 	}
 
-	inline const bool connect(const char *host, int port = 1883, const String accessToken = PROVISION_ACCESS_TOKEN, const String clientId = DEFAULT_CLIENT_ID, const char *password = NULL)
+	// In managed mode the connection is watched by mqttClientLoop and re-established with jittered exponential backoff.
+	// Registered callbacks and subscriptions are kept over reconnects and restored in one batch, data sent while offline is queued
+	// if the Offline parameter of the feature policy is set.
+	inline void enableManagedConnection(const uint32_t minReconnectDelay = DEFAULT_RECONNECT_MIN_DELAY, const uint32_t maxReconnectDelay = DEFAULT_RECONNECT_MAX_DELAY)
+	{
+		this->managedConnection = true;
+		this->reconnectBackoff.setDelays(minReconnectDelay, maxReconnectDelay);
+		this->subscriptions.setPersistent(true);
+	}
+
+	inline void disableManagedConnection()
+	{
+		this->managedConnection = false;
+		this->subscriptions.setPersistent(false);
+		this->outboundQueue.clear();
+	}
+
+	inline const ConnectionStats &getConnectionStats() const
+	{
+		return this->connectionStats;
+	}
+
+	//----------------------------------------------------------------------------
+	// Duty cycle API
+
+	// For devices that wake, sample, publish and go back to sleep. Data sent while disconnected is queued, wake connects and publishes
+	// it in one batch, sleep disconnects and persists what is left together with the session state, so the next boot continues from there.
+	// With a persistent broker session the subscriptions are only sent again if they changed, the mirrored attributes are only reconciled
+	// and the firmware info only resent every refreshInterval wakes. Has to be called before subscribing any callbacks, so their topics
+	// are only remembered until wake. Returns false if no session was persisted yet. Needs the Offline parameter of the feature policy.
+	inline const bool beginDutyCycle(PersistentStorage &storage, const bool persistentSession = true, const uint16_t refreshInterval = DEFAULT_SESSION_REFRESH_WAKES)
+	{
+		static_assert(Features::offline, "The duty cycle keeps the data of a wake in the offline queue and therefore needs it");
+		this->sessionStorage = &storage;
+		this->dutyCycle.persistentSession = persistentSession;
+		this->dutyCycle.refreshInterval = refreshInterval;
+		this->subscriptions.setPersistent(true);
+		return loadSession();
+	}
+
+	inline void endDutyCycle()
+	{
+		this->sessionStorage = nullptr;
+		this->subscriptions.setPersistent(this->managedConnection);
+	}
+
+	// Connects and restores only the parts of the session the broker and the server do not remember anyway,
+	// then publishes everything queued while asleep. Callbacks are kept, so nothing is unsubscribed.
+	// The credentials are handled like the ones of connect.
+	inline const bool wake(const char *host, int port = 1883, const char *accessToken = PROVISION_ACCESS_TOKEN, const char *clientId = DEFAULT_CLIENT_ID, const char *password = NULL)
 	{
-		if (!host)
+		static_assert(Features::offline, "The duty cycle keeps the data of a wake in the offline queue and therefore needs it");
+		if (this->sessionStorage == nullptr || !host)
 		{
 			return false;
 		}
 
-		(*mqttClient).setServer(host, port);
-		const bool connection = (*mqttClient).connect(clientId.c_str(), accessToken.c_str(), password);
-		if (connection)
+		this->dutyCycle.wokeAt = millis();
+		if (!rememberCredentials(host, port, accessToken, clientId, password))
 		{
-			this->rpc.unsubscribeFromRPC();
-			this->unsubscribeFromSharedAttribute();
-			this->unsubscribeFromSharedAttributeRequest();
-#if defined(ESP8266) || defined(ESP32) || defined(ARDUINO_AVR_MEGA)
-			this->unsubscribeFromProvisioning();
+			return false;
+		}
+
+		(*mqttClient).setServer(this->host, this->port);
+		const bool connection = this->dutyCycle.persistentSession
+									? (*mqttClient).connect(this->clientId, this->accessToken, this->password, nullptr, 0U, false, nullptr, false)
+									: (*mqttClient).connect(this->clientId, this->accessToken, this->password);
+		this->dutyCycle.stats.lastConnectDuration = millis() - this->dutyCycle.wokeAt;
+		if (!connection)
+		{
+			Logger::log(CONNECT_FAILED);
+			return false;
+		}
+		this->dutyCycle.session.wakes++;
+
+		// PubSubClient does not tell whether the broker resumed the session, so a persistent session is trusted to hold the topics it was given.
+		const uint32_t fingerprint = this->subscriptions.fingerprint();
+		this->dutyCycle.stats.lastResubscribed = !this->dutyCycle.persistentSession || this->dutyCycle.session.subscriptions != fingerprint;
+		if (this->dutyCycle.stats.lastResubscribed)
+		{
+			this->subscriptions.resubscribe();
+			this->dutyCycle.session.subscriptions = fingerprint;
+		}
+
+		this->dutyCycle.session.wakesSinceRefresh++;
+		this->dutyCycle.stats.lastRefreshed = this->dutyCycle.session.wakesSinceRefresh >= this->dutyCycle.refreshInterval;
+		if (this->dutyCycle.stats.lastRefreshed)
+		{
+			if (this->attribute.mirrorEnabled())
+			{
+				this->attribute.reconcileMirror();
+			}
+#if defined(ESP8266) || defined(ESP32)
+			this->firmware.resendFirmwareInfo();
 #endif
+			this->dutyCycle.session.wakesSinceRefresh = 0U;
+		}
+		this->gateway.reconnectDevices();
+
+		const size_t queued = this->outboundQueue.size();
+		this->flushOutboundQueue();
+		this->dutyCycle.stats.lastFlushed = queued - this->outboundQueue.size();
 #if defined(ESP8266) || defined(ESP32)
-			this->firmware.unsubscribeFromOTAFirmware();
+		this->drainProducerQueue();
 #endif
+		return true;
+	}
+
+	inline const bool wake(const char *host, int port, const String &accessToken, const String &clientId = DEFAULT_CLIENT_ID, const char *password = NULL)
+	{
+		return wake(host, port, accessToken.c_str(), clientId.c_str(), password);
+	}
+
+	// Publishes what is still pending, handles the responses that already arrived and disconnects.
+	// Messages that could not be published are persisted with the session. Returns false if the session could not be persisted.
+	inline const bool sleep()
+	{
+		static_assert(Features::offline, "The duty cycle keeps the data of a wake in the offline queue and therefore needs it");
+		if (this->sessionStorage == nullptr)
+		{
+			return false;
 		}
-		else
+
+		if ((*mqttClient).connected())
 		{
-			Logger::log(CONNECT_FAILED);
+#if defined(ESP8266) || defined(ESP32)
+			this->drainProducerQueue();
+			this->drainOutboundScheduler();
+#endif
+			this->attribute.flushSharedAttributesRequests();
+			this->flushOutboundQueue();
+			(*mqttClient).loop();
+			(*mqttClient).disconnect();
 		}
-		return connection;
+#if defined(ESP8266) || defined(ESP32)
+		// Data held back by a rate limit is persisted too, the next wake publishes it with the rest of the queue.
+		this->outboundScheduler.release([this](const DispatchMessage<PayloadSize> &message)
+										{ this->keepForNextSession(message.topic, message.payload, message.length); });
+#endif
+		const bool saved = saveSession();
+		this->dutyCycle.stats.lastWakeDuration = millis() - this->dutyCycle.wokeAt;
+		return saved;
+	}
+
+	inline const DutyCycleStats &getDutyCycleStats() const
+	{
+		static_assert(Features::offline, "The duty cycle keeps the data of a wake in the offline queue and therefore needs it");
+		return this->dutyCycle.stats;
+	}
+
+	// The access token and client id are copied, so the managed connection can reconnect on its own without allocating.
+	// The host and password are only referenced and have to stay valid as long as the connection is managed or duty cycled.
+	inline const bool connect(const char *host, int port = 1883, const char *accessToken = PROVISION_ACCESS_TOKEN, const char *clientId = DEFAULT_CLIENT_ID, const char *password = NULL)
+	{
+		if (!host || !rememberCredentials(host, port, accessToken, clientId, password))
+		{
+			return false;
+		}
+		return establishConnection();
+	}
+
+	inline const bool connect(const char *host, int port, const String &accessToken, const String &clientId = DEFAULT_CLIENT_ID, const char *password = NULL)
+	{
+		return connect(host, port, accessToken.c_str(), clientId.c_str(), password);
 	}
 
 	inline void disconnect()
@@ -102,6 +260,24 @@ public:
 
 	inline void mqttClientLoop()
 	{
+		this->telemetryAggregator.flush(millis(), StatisticsEmitter(this));
+#if defined(ESP8266) || defined(ESP32)
+		this->drainProducerQueue();
+#endif
+#if defined(__cpp_impl_coroutine)
+		this->scheduler.poll();
+#endif
+		if (this->managedConnection && !(*mqttClient).connected())
+		{
+			this->reconnect();
+			return;
+		}
+#if defined(ESP8266) || defined(ESP32)
+		this->drainOutboundScheduler();
+#endif
+		this->attribute.flushSharedAttributesRequests();
+		this->attribute.checkSharedAttributesRequestTimeouts();
+		this->rpc.checkRPCRequestTimeouts();
 		(*mqttClient).loop();
 	}
 
@@ -115,14 +291,17 @@ public:
 		StaticJsonDocument<JSON_OBJECT_SIZE(2)> requestBuffer;
 		JsonObject responseObject = requestBuffer.to<JsonObject>();
 
-		String secret = SECRET_KEY;
-		String durationKey = DURATION_KEY;
-		responseObject[secret.c_str()] = secretKey;
-		responseObject[durationKey.c_str()] = durationMs;
+		responseObject[static_cast<const char *>(SECRET_KEY)] = secretKey;
+		responseObject[static_cast<const char *>(DURATION_KEY)] = durationMs;
 
-		uint8_t objectSize = JSON_STRING_SIZE(measureJson(requestBuffer));
-		char responsePayload[objectSize];
-		serializeJson(responseObject, responsePayload, objectSize);
+		const uint32_t json_size = JSON_STRING_SIZE(measureJson(requestBuffer));
+		if (json_size > CLAIM_REQUEST_SIZE)
+		{
+			Logger::log(LogMessage(CLAIM_REQUEST_TOO_BIG, json_size, CLAIM_REQUEST_SIZE).c_str());
+			return false;
+		}
+		char responsePayload[CLAIM_REQUEST_SIZE];
+		serializeJson(responseObject, responsePayload, sizeof(responsePayload));
 
 		return (*mqttClient).publish(CLAIM_TOPIC, responsePayload, this->mqttQoS);
 	}
@@ -168,6 +347,80 @@ public:
 		return sendDataArray(data, data_count);
 	}
 
+	// Only publish the key if it changed by more than the deadband, at most every minInterval and at least every maxSilence milliseconds.
+	// Applies to the key value and array telemetry API, suppressed values still return true. Returns false without the Shaping parameter of the feature policy.
+	inline const bool setTelemetryFilter(const char *key, const TelemetryFilterConfig &config)
+	{
+		return this->telemetryFilter.add(key, config);
+	}
+
+	inline const bool removeTelemetryFilter(const char *key)
+	{
+		return this->telemetryFilter.remove(key);
+	}
+
+	inline const uint32_t suppressedTelemetryCount() const
+	{
+		return this->telemetryFilter.suppressed();
+	}
+
+	// Samples of the key are no longer published one by one, instead min, max, mean, variance and count over every window of the given
+	// milliseconds are sent as <key>_min, <key>_max, <key>_mean, <key>_var and <key>_count. Only numeric values are aggregated.
+	// Returns false without the Shaping parameter of the feature policy.
+	inline const bool setTelemetryAggregation(const char *key, const uint32_t window)
+	{
+		return this->telemetryAggregator.add(key, window);
+	}
+
+	inline const bool removeTelemetryAggregation(const char *key)
+	{
+		return this->telemetryAggregator.remove(key);
+	}
+
+	// Sends the values with the given unix timestamp in milliseconds, instead of the time the server received them.
+	inline const bool sendTelemetryTs(const uint64_t ts, const Telemetry *data, size_t data_count)
+	{
+		const TelemetryRecord record(ts, data, data_count);
+		return sendTelemetrySeries(&record, 1U);
+	}
+
+	// Packs all records into one [{"ts":ms,"values":{...}},...] payload, so buffered samples cost one publish instead of one per sample.
+	inline const bool sendTelemetrySeries(const TelemetryRecord *records, size_t records_count)
+	{
+		if (records == nullptr || records_count == 0U)
+		{
+			return false;
+		}
+
+		char payload[PayloadSize];
+		size_t length = Encoding::serializeArrayBegin(payload, sizeof(payload), records_count);
+		StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::outboundFields)> jsonBuffer;
+		for (size_t i = 0; i < records_count; ++i)
+		{
+			if (records[i].valuesCount > Capacities::outboundFields)
+			{
+				Logger::log(LogMessage(TOO_MANY_JSON_FIELDS, records[i].valuesCount, Capacities::outboundFields).c_str());
+				return false;
+			}
+			if (i > 0U)
+			{
+				length += Encoding::serializeArraySeparator(payload + length, sizeof(payload) - length);
+			}
+			// Keep space for the end of the array.
+			const size_t written = Encoding::serializeRecord(records[i], jsonBuffer, payload + length, sizeof(payload) - length - 1U);
+			if (written == 0U)
+			{
+				Logger::log(LogMessage(TELEMETRY_SERIES_TOO_BIG, i, PayloadSize).c_str());
+				return false;
+			}
+			length += written;
+		}
+		length += Encoding::serializeArrayEnd(payload + length, sizeof(payload) - length);
+		return publishPayload(TELEMETRY_TOPIC, payload, length, PRIORITY_TELEMETRY);
+	}
+
+	// Publishes the given JSON text as is, independent of the configured Encoding. Text bigger than PayloadSize is streamed
+	// into the connection in chunks instead of being copied, which is only possible while connected.
 	inline const bool sendTelemetryJsonChar(const char *json)
 	{
 		if (json == nullptr)
@@ -178,30 +431,96 @@ public:
 		const uint32_t json_size = JSON_STRING_SIZE(strlen(json));
 		if (json_size > PayloadSize)
 		{
-			char message[detectSizeOf(INVALID_BUFFER_SIZE, PayloadSize, json_size)];
-			snprintf_P(message, sizeof(message), INVALID_BUFFER_SIZE, PayloadSize, json_size);
-			Logger::log(message);
-			return false;
+			return streamPayload(TELEMETRY_TOPIC, json, strlen(json));
 		}
-		return (*mqttClient).publish(TELEMETRY_TOPIC, json, this->mqttQoS);
+		return publishPayload(TELEMETRY_TOPIC, json, strlen(json), PRIORITY_TELEMETRY);
 	}
 
 	inline const bool sendTelemetryJson(const JsonObject &jsonObject)
 	{
-		const uint32_t json_object_size = jsonObject.size();
-		if (MaxFieldsElement < json_object_size)
-		{
-			char message[detectSizeOf(TOO_MANY_JSON_FIELDS, json_object_size, MaxFieldsElement)];
-			snprintf_P(message, sizeof(message), TOO_MANY_JSON_FIELDS, json_object_size, MaxFieldsElement);
-			Logger::log(message);
-			return false;
-		}
-		const uint32_t json_size = JSON_STRING_SIZE(measureJson(jsonObject));
-		char json[json_size];
-		serializeJson(jsonObject, json, json_size);
-		return sendTelemetryJsonChar(json);
+		return sendEncoded(TELEMETRY_TOPIC, jsonObject, PRIORITY_TELEMETRY);
+	}
+
+#if defined(ESP8266) || defined(ESP32)
+
+	//----------------------------------------------------------------------------
+	// Thread safe API
+
+	// Can be called from any task while one network task runs mqttClientLoop, the values are serialized on the stack of the caller
+	// into a lock free queue and published by the next mqttClientLoop. Filter and aggregation are not applied and nothing is logged.
+	// Not safe to call from interrupts, serializing uses ArduinoJson and floats, which are neither placed in IRAM nor allowed in an ISR.
+	// Returns false if the queue is full or the values do not fit into PayloadSize, always without the Producers parameter of the feature policy.
+	inline const bool trySendTelemetry(const Telemetry *data, size_t data_count)
+	{
+		return tryEnqueue(TELEMETRY_TOPIC, PRIORITY_TELEMETRY, data, data_count);
+	}
+
+	inline const bool trySendAttributes(const Attribute *data, size_t data_count)
+	{
+		return tryEnqueue(ATTRIBUTE_TOPIC, PRIORITY_ATTRIBUTE, data, data_count);
 	}
 
+	// Amount of times a producer lost the race for a queue slot against another producer and had to retry.
+	inline const uint32_t producerContention() const
+	{
+		return this->producerQueue.contention();
+	}
+
+	// Amount of messages producers could not enqueue, because mqttClientLoop did not keep up.
+	inline const uint32_t droppedProducerMessages() const
+	{
+		return this->producerQueue.droppedMessages();
+	}
+
+	//----------------------------------------------------------------------------
+	// Outbound scheduler API
+
+	// Publishes by priority instead of in call order, RPC messages first, then firmware states, attributes and telemetry.
+	// Every class is rate limited by its own token bucket, a message over the limit is queued and published by mqttClientLoop
+	// once its class earned a token again, so a backlog of telemetry never holds back a more critical message.
+	// Up to MAX_SCHEDULED_MESSAGES are queued per class, beyond that the oldest one is dropped. While disconnected attributes and
+	// telemetry are queued just like without the scheduler, so a duty cycle persists them with the session. Payloads bigger than PayloadSize do not fit into a queue and are still streamed right away.
+	// Without the Scheduling parameter of the feature policy every message is published right away and no limit applies.
+	inline void enableOutboundScheduler()
+	{
+		this->scheduling = true;
+		this->rpc.setOutboundSink(&this->scheduledOutbound);
+		this->attribute.setOutboundSink(&this->scheduledOutbound);
+		this->firmware.setOutboundSink(&this->scheduledOutbound);
+		this->gateway.setOutboundSink(&this->scheduledOutbound);
+	}
+
+	// Drops every message that is still queued.
+	inline void disableOutboundScheduler()
+	{
+		this->scheduling = false;
+		this->rpc.setOutboundSink(nullptr);
+		this->attribute.setOutboundSink(nullptr);
+		this->firmware.setOutboundSink(nullptr);
+		this->gateway.setOutboundSink(nullptr);
+		this->outboundScheduler.clear();
+	}
+
+	// Allows burst messages of the class at once and afterwards one every refillInterval milliseconds, 0 removes the limit.
+	// For example setRateLimit(PRIORITY_TELEMETRY, 10U, 1000U) stays below a server limit of 10 messages per second.
+	inline void setRateLimit(const MessagePriority priority, const uint16_t burst, const uint32_t refillInterval)
+	{
+		this->outboundScheduler.setRateLimit(priority, burst, refillInterval, millis());
+	}
+
+	inline const size_t scheduledMessages(const MessagePriority priority) const
+	{
+		return this->outboundScheduler.size(priority);
+	}
+
+	// Amount of messages of the class that were dropped, because its queue was full.
+	inline const uint32_t droppedScheduledMessages(const MessagePriority priority) const
+	{
+		return this->outboundScheduler.droppedMessages(priority);
+	}
+
+#endif
+
 	//----------------------------------------------------------------------------
 	// Attribute API
 
@@ -236,6 +555,8 @@ public:
 		return sendDataArray(data, data_count, false);
 	}
 
+	// Publishes the given JSON text as is, independent of the configured Encoding. Text bigger than PayloadSize is streamed
+	// into the connection in chunks instead of being copied, which is only possible while connected.
 	inline const bool sendAttributeJSONChar(const char *json)
 	{
 		if (json == nullptr)
@@ -246,28 +567,14 @@ public:
 		const uint32_t json_size = JSON_STRING_SIZE(strlen(json));
 		if (json_size > PayloadSize)
 		{
-			char message[detectSizeOf(INVALID_BUFFER_SIZE, PayloadSize, json_size)];
-			snprintf_P(message, sizeof(message), INVALID_BUFFER_SIZE, PayloadSize, json_size);
-			Logger::log(message);
-			return false;
+			return streamPayload(ATTRIBUTE_TOPIC, json, strlen(json));
 		}
-		return (*mqttClient).publish(ATTRIBUTE_TOPIC, json, this->mqttQoS);
+		return publishPayload(ATTRIBUTE_TOPIC, json, strlen(json), PRIORITY_ATTRIBUTE);
 	}
 
 	inline const bool sendAttributeJSON(const JsonObject &jsonObject)
 	{
-		const uint32_t json_object_size = jsonObject.size();
-		if (MaxFieldsElement < json_object_size)
-		{
-			char message[detectSizeOf(TOO_MANY_JSON_FIELDS, json_object_size, MaxFieldsElement)];
-			snprintf_P(message, sizeof(message), TOO_MANY_JSON_FIELDS, json_object_size, MaxFieldsElement);
-			Logger::log(message);
-			return false;
-		}
-		const uint32_t json_size = JSON_STRING_SIZE(measureJson(jsonObject));
-		char json[json_size];
-		serializeJson(jsonObject, json, json_size);
-		return sendAttributeJSONChar(json);
+		return sendEncoded(ATTRIBUTE_TOPIC, jsonObject, PRIORITY_ATTRIBUTE);
 	}
 
 	//----------------------------------------------------------------------------
@@ -289,16 +596,57 @@ public:
 		return this->rpc.RPCUnsubscribe();
 	}
 
+	// Calls a method on the server, the response is passed to the callback from within mqttClientLoop.
+	// Up to MAX_PENDING_RPC_REQUESTS requests can await their response at once.
+	inline const RPCRequestHandle RPCRequest(const char *methodName, const JsonVariantConst &params, const RPCRequestCallback &callback)
+	{
+		return this->rpc.RPCRequest(methodName, params, callback);
+	}
+
+	inline const RPCRequestHandle RPCRequest(const char *methodName, const RPCRequestCallback &callback)
+	{
+		return this->rpc.RPCRequest(methodName, JsonVariantConst(), callback);
+	}
+
+	inline void cancelRPCRequest(const RPCRequestHandle &handle)
+	{
+		this->rpc.cancelRPCRequest(handle);
+	}
+
+	inline const bool unsubscribeFromRPCResponses()
+	{
+		return this->rpc.unsubscribeFromRPCResponses();
+	}
+
 	//----------------------------------------------------------------------------
 	// Firmware OTA API
 #if defined(ESP8266) || defined(ESP32)
 
-	inline const bool startFirmwareUpdate(const char *currFwTitle, const char *currFwVersion, const std::function<void(const bool &)> &updatedCallback)
+	// Subscribes to firmware assignments and requests the current one. The callback is called once for every check, with true only if
+	// a new image was written, and with false if it failed or if no other firmware is assigned. Calling it again replaces the callback
+	// and checks again.
+	inline const bool startFirmwareUpdate(const char *currFwTitle, const char *currFwVersion, const FirmwareUpdateCallback &updatedCallback)
 	{
-
 		return this->firmware.startFirmwareUpdate(currFwTitle, currFwVersion, updatedCallback);
 	}
 
+	// Writes the image with the given writer instead of the Update library, nullptr restores the Update library.
+	inline void setFirmwareWriter(FirmwareWriter *writer)
+	{
+		this->firmware.setFirmwareWriter(writer);
+	}
+
+	// Requests the following chunks while the current one is written to flash, one chunk per buffer of the stage is received ahead.
+	inline void enableFirmwareWriteBehind(FirmwareWriteBehind &writeBehind)
+	{
+		this->firmware.setWriteBehind(&writeBehind);
+	}
+
+	inline void disableFirmwareWriteBehind()
+	{
+		this->firmware.setWriteBehind(nullptr);
+	}
+
 	inline const bool unsubscribeFromOTAFirmware()
 	{
 		return this->firmware.unsubscribeFromOTAFirmware();
@@ -309,12 +657,21 @@ public:
 	//----------------------------------------------------------------------------
 	// Shared attributes API
 
+	// Requests the given keys, the request is only merged with others and queued here, it is published by the next mqttClientLoop call.
+	// Returning true therefore does not mean the request was sent, if publishing it fails or no response arrives within the timeout
+	// of the callback, the failed callback is called instead and the callback frees its slot.
 	template <class InputIterator>
 	inline const bool sharedAttributesRequest(const InputIterator &first_itr, const InputIterator &last_itr, SharedAttributeRequestCallback &callback)
 	{
 		return this->attribute.sharedAttributesRequest(first_itr, last_itr, callback);
 	}
 
+	// Stops waiting for the response of a request the callback was passed to, neither of its callbacks is called anymore.
+	inline void cancelSharedAttributesRequest(const SharedAttributeRequestCallback &callback)
+	{
+		this->attribute.cancelSharedAttributesRequest(callback);
+	}
+
 	// Subscribes multiple Shared attributes callbacks.
 	template <class InputIterator>
 	inline const bool sharedAttributesSubscribe(const InputIterator &first_itr, const InputIterator &last_itr)
@@ -338,6 +695,32 @@ public:
 		return this->attribute.unsubscribeFromSharedAttributeRequest();
 	}
 
+	// Requests for keys contained in a response younger than the given milliseconds are answered from it directly, 0 disables the cache.
+	inline void setSharedAttributesRequestCacheTTL(const uint32_t ttl)
+	{
+		this->attribute.setSharedAttributesRequestCacheTTL(ttl);
+	}
+
+	// Mirrors the shared attribute values into the storage, so subscribed callbacks receive the last known values right away after a reset.
+	// The values are requested from the server in the background and callbacks are only called again for values that changed.
+	// Returns false if no values were mirrored yet.
+	inline const bool enableAttributeMirror(PersistentStorage &storage)
+	{
+#if defined(ESP8266) || defined(ESP32)
+		if (this->dispatching)
+		{
+			Logger::log(DISPATCH_WITH_MIRROR);
+			return false;
+		}
+#endif
+		return this->attribute.enableMirror(&storage);
+	}
+
+	inline void disableAttributeMirror()
+	{
+		this->attribute.disableMirror();
+	}
+
 	// -------------------------------------------------------------------------------
 	// Provisioning API
 
@@ -351,86 +734,1059 @@ public:
 		return this->provisioning.unsubscribeFromProvisioning();
 	}
 
-	inline void onMessage(char *topic, uint8_t *payload, uint32_t length)
+	//----------------------------------------------------------------------------
+	// Gateway API
+
+	// Announces the sub device to the server, the name and type have to stay valid until the device is disconnected.
+	// In managed mode every connected sub device is announced again after reconnecting.
+	inline const bool gatewayConnectDevice(const char *deviceName, const char *deviceType = nullptr)
 	{
-		char message[JSON_STRING_SIZE(strlen(CALLBACK_FUNCTION_CALLED_MESSAGE)) + JSON_STRING_SIZE(strlen(topic))];
-		snprintf_P(message, sizeof(message), CALLBACK_FUNCTION_CALLED_MESSAGE, topic);
-		Logger::log(message);
+		return this->gateway.connectDevice(deviceName, deviceType);
+	}
 
-		if (this->rpc.isRPCMessage(topic))
-		{
-			this->rpc.processRPCMessage(topic, payload, length);
-		}
-		else if (this->attribute.isAttributeResponseMessage(topic))
-		{
-			this->attribute.processSharedAttributeRequestMessage(topic, payload, length);
-		}
-		else if (this->attribute.isAttributeMessage(topic))
-		{
-			this->attribute.processSharedAttributeUpdateMessage(topic, payload, length);
-		}
-#if defined(ESP8266) || defined(ESP32) || defined(ARDUINO_AVR_MEGA)
-		else if (this->provisioning.isProvisionResponseTopic(topic))
-		{
-			this->provisioning.processProvisioningResponseMessage(topic, payload, length);
-		}
-#endif
-#if defined(ESP8266) || defined(ESP32)
-		else if (this->firmware.isFirmwareResponseTopic(topic))
-		{
-			this->firmware.processFirmwareResponseMessage(topic, payload, length);
-		}
-#endif
+	inline const bool gatewayDisconnectDevice(const char *deviceName)
+	{
+		return this->gateway.disconnectDevice(deviceName);
 	}
 
-private:
-	PubSubClient *mqttClient;
-	bool mqttQoS;
-	RPCTemplate<PayloadSize, MaxFieldsElement, Logger> rpc;
-	AttributeTemplate<PayloadSize, MaxFieldsElement, Logger> attribute;
-	ProvisioningTemplate<PayloadSize, MaxFieldsElement, Logger> provisioning;
-	FirmwareTemplate<PayloadSize, MaxFieldsElement, Logger> firmware;
+	inline const bool isGatewayDeviceConnected(const char *deviceName) const
+	{
+		return this->gateway.isDeviceConnected(deviceName);
+	}
 
-	inline const uint8_t detectSizeOf(const char *msg, ...)
+	// Name of the sub device whose gateway callback is currently running, nullptr outside of gateway callbacks.
+	inline const char *gatewayDevice() const
 	{
-		va_list args;
-		va_start(args, msg);
-		const int32_t result = JSON_STRING_SIZE(vsnprintf_P(nullptr, 0U, msg, args));
-		assert(result >= 0);
-		va_end(args);
-		return result;
+		return this->gateway.gatewayDevice();
 	}
 
-	template <typename T>
-	inline const bool sendKeyval(const char *key, T value, bool telemetry = true)
+	// Publishes the values of several sub devices in one message.
+	inline const bool sendGatewayTelemetry(const GatewayDeviceValues *data, size_t data_count)
 	{
-		Telemetry t(key, value);
-		StaticJsonDocument<JSON_OBJECT_SIZE(1)> jsonBuffer;
-		JsonVariant object = jsonBuffer.template to<JsonVariant>();
-		if (!t.serializeKeyValue(object))
-		{
-			Logger::log(UNABLE_TO_SERIALIZE);
-			return false;
-		}
+		char payload[PayloadSize];
+		const size_t length = this->gateway.serializeTelemetry(data, data_count, payload, sizeof(payload));
+		return length != 0U && publishPayload(GATEWAY_TELEMETRY_TOPIC, payload, length, PRIORITY_TELEMETRY);
+	}
+
+	// Publishes the client side attributes of several sub devices in one message.
+	inline const bool sendGatewayAttributes(const GatewayDeviceValues *data, size_t data_count)
+	{
+		char payload[PayloadSize];
+		const size_t length = this->gateway.serializeAttributes(data, data_count, payload, sizeof(payload));
+		return length != 0U && publishPayload(GATEWAY_ATTRIBUTE_TOPIC, payload, length, PRIORITY_ATTRIBUTE);
+	}
 
-		return telemetry ? sendTelemetryJson(object) : sendAttributeJSON(object);
+	// Subscribes the callback for RPCs sent to the given sub device, nullptr subscribes it for every sub device.
+	inline const bool gatewayRPCSubscribe(const char *deviceName, const RPCCallback &callback)
+	{
+		return this->gateway.gatewayRPCSubscribe(deviceName, callback);
 	}
 
-	inline const bool sendDataArray(const Telemetry *data, size_t data_count, bool telemetry = true)
+	inline const bool gatewayRPCUnsubscribe()
 	{
-		StaticJsonDocument<JSON_OBJECT_SIZE(MaxFieldsElement)> jsonBuffer;
-		JsonVariant object = jsonBuffer.template to<JsonVariant>();
+		return this->gateway.unsubscribeFromGatewayRPC();
+	}
 
-		for (size_t i = 0; i < data_count; ++i)
-		{
-			if (data[i].serializeKeyValue(object) == false)
-			{
-				Logger::log(UNABLE_TO_SERIALIZE);
-				return false;
-			}
-		}
+	// Subscribes the callback for shared attribute updates of the given sub device, nullptr subscribes it for every sub device.
+	inline const bool gatewaySharedAttributesSubscribe(const char *deviceName, const SharedAttributeCallback &callback)
+	{
+		return this->gateway.gatewaySharedAttributesSubscribe(deviceName, callback);
+	}
 
-		return telemetry ? sendTelemetryJson(object) : sendAttributeJSON(object);
+	inline const bool unsubscribeFromGatewaySharedAttributes()
+	{
+		return this->gateway.unsubscribeFromGatewaySharedAttributes();
+	}
+
+#if defined(ESP8266) || defined(ESP32)
+
+	//----------------------------------------------------------------------------
+	// Dispatch API
+
+	// RPC and shared attribute update messages, of the device and of the gateway devices, are no longer handled inside onMessage.
+	// They are copied into a bounded queue instead and their callbacks run once processDispatchedMessages is called on a worker task,
+	// so a slow callback never delays keep alives or other messages. Responses of the callbacks are published by mqttClientLoop.
+	// Responses to shared attribute requests are still handled on the network task, because they share the request state with it,
+	// which is also why dispatching can not be combined with the attribute mirror. The firmware update callback runs on the network task
+	// as well, because the download uses the client. Messages bigger than MAX_DISPATCH_PAYLOAD_SIZE are logged and skipped.
+	// Returns false without the Dispatch parameter of the feature policy, because there are no queues to dispatch through.
+	inline const bool enableDispatch()
+	{
+		if (!Features::dispatch)
+		{
+			return false;
+		}
+		if (this->attribute.mirrorEnabled())
+		{
+			Logger::log(DISPATCH_WITH_MIRROR);
+			return false;
+		}
+		this->dispatching = true;
+		this->rpc.setResponseSink(&this->dispatchResponses);
+		this->gateway.setResponseSink(&this->dispatchResponses);
+		return true;
+	}
+
+	// Has to be called while no worker is processing dispatched messages, already queued messages can still be processed afterwards.
+	inline void disableDispatch()
+	{
+		this->dispatching = false;
+		this->rpc.setResponseSink(nullptr);
+		this->gateway.setResponseSink(nullptr);
+	}
+
+	// Runs the callbacks of all dispatched messages, has to be called from one single worker task. Returns the amount of processed messages.
+	inline const size_t processDispatchedMessages()
+	{
+		size_t processed = 0U;
+		DispatchMessage<MAX_DISPATCH_PAYLOAD_SIZE> *message = nullptr;
+		while ((message = this->dispatchQueue.front()) != nullptr)
+		{
+			processMessage(message->topic, reinterpret_cast<uint8_t *>(message->payload), message->length, DISPATCHED_CALLBACKS);
+			this->dispatchQueue.pop();
+			processed++;
+		}
+		return processed;
+	}
+
+	// Amount of messages that were skipped, because the worker did not keep up with processing them.
+	inline const uint32_t droppedDispatchMessages() const
+	{
+		return this->dispatchQueue.droppedMessages();
+	}
+
+#if defined(ESP32)
+
+	// Starts a FreeRTOS task that sleeps until messages are dispatched and then processes them, the stack size has to fit
+	// Footprint::dispatchStackSize and the biggest callback. Enables dispatching if it was not enabled yet.
+	inline const bool startDispatchTask(const uint32_t stackSize, const UBaseType_t priority = 1U, const BaseType_t core = tskNO_AFFINITY)
+	{
+		if (this->dispatchTask != nullptr)
+		{
+			return true;
+		}
+		if (!this->dispatching && !enableDispatch())
+		{
+			return false;
+		}
+		return xTaskCreatePinnedToCore(&ThingspodTemplate::dispatchTaskLoop, DISPATCH_TASK_NAME, stackSize, this, priority, &this->dispatchTask, core) == pdPASS;
+	}
+
+#endif
+
+#endif
+
+#if defined(__cpp_impl_coroutine)
+
+	//----------------------------------------------------------------------------
+	// Coroutine API
+
+	// Values of an awaited response, converts to false if the operation timed out or could not be started.
+	using AwaitedValues = AwaitedJson<PayloadSize, Capacities::inboundFields>;
+
+	// Operation that completes with the JSON values of a response.
+	class JsonOperation : public AwaitedOperation
+	{
+	public:
+		inline JsonOperation(ThingspodTemplate *thingspod, const uint32_t timeout)
+			: thingspod(thingspod), timeout(timeout), values()
+		{
+		}
+
+		inline const bool await_ready() const
+		{
+			return false;
+		}
+
+		inline AwaitedValues await_resume()
+		{
+			return this->values;
+		}
+
+	protected:
+		ThingspodTemplate *thingspod;
+		uint32_t timeout;
+		AwaitedValues values;
+
+		// Callback that copies the response into the operation, as long as it is still awaited.
+		inline auto completion(const uint32_t ticket) const
+		{
+			ThingspodTemplate *thingspod = this->thingspod;
+			return [thingspod, ticket](const JsonVariantConst &data)
+			{
+				JsonOperation *operation = static_cast<JsonOperation *>((*thingspod).scheduler.find(ticket));
+				if (operation != nullptr)
+				{
+					operation->values.assign(data);
+					(*thingspod).scheduler.complete(operation);
+				}
+			};
+		}
+
+		// Callback that completes the operation without values, if its request could not be sent.
+		inline auto failure(const uint32_t ticket) const
+		{
+			ThingspodTemplate *thingspod = this->thingspod;
+			return [thingspod, ticket]()
+			{
+				AwaitedOperation *operation = (*thingspod).scheduler.find(ticket);
+				if (operation != nullptr)
+				{
+					(*thingspod).scheduler.complete(operation);
+				}
+			};
+		}
+
+		// Resumes right away instead of suspending, if the operation could not be started or completed synchronously.
+		inline const bool suspend(const bool started)
+		{
+			if (started && !this->completed)
+			{
+				return true;
+			}
+			(*this->thingspod).scheduler.cancel(this);
+			return false;
+		}
+	};
+
+	template <class InputIterator>
+	class SharedAttributesOperation : public JsonOperation
+	{
+	public:
+		inline SharedAttributesOperation(ThingspodTemplate *thingspod, const InputIterator &first_itr, const InputIterator &last_itr, const uint32_t timeout)
+			: JsonOperation(thingspod, timeout), first_itr(first_itr), last_itr(last_itr), request()
+		{
+		}
+
+		inline bool await_suspend(const std::coroutine_handle<> handle)
+		{
+			const uint32_t ticket = (*this->thingspod).scheduler.wait(this, handle, this->timeout);
+			if (ticket == 0U)
+			{
+				return false;
+			}
+			this->request = SharedAttributeRequestCallback(this->completion(ticket), this->failure(ticket), this->timeout);
+			return this->suspend((*this->thingspod).sharedAttributesRequest(this->first_itr, this->last_itr, this->request));
+		}
+
+		// A request that timed out still waits for its response, it is cancelled so it does not keep its slot.
+		inline AwaitedValues await_resume()
+		{
+			if (this->timedOut())
+			{
+				(*this->thingspod).cancelSharedAttributesRequest(this->request);
+			}
+			return this->values;
+		}
+
+	private:
+		InputIterator first_itr;
+		InputIterator last_itr;
+		SharedAttributeRequestCallback request;
+	};
+
+	// Requests the shared attributes and resumes the awaiting coroutine with their values.
+	template <class InputIterator>
+	inline SharedAttributesOperation<InputIterator> requestShared(const InputIterator &first_itr, const InputIterator &last_itr, const uint32_t timeout = ATTRIBUTE_REQUEST_TIMEOUT)
+	{
+		return SharedAttributesOperation<InputIterator>(this, first_itr, last_itr, timeout);
+	}
+
+	// Requests every key of the array, for example
+	// static const char *const keys[] = {"interval", "mode"};
+	// AwaitedValues response = co_await thingspod.requestShared(keys);
+	template <typename Key, size_t Count>
+	inline SharedAttributesOperation<const Key *> requestShared(const Key (&keys)[Count], const uint32_t timeout = ATTRIBUTE_REQUEST_TIMEOUT)
+	{
+		return SharedAttributesOperation<const Key *>(this, keys, keys + Count, timeout);
+	}
+
+	class RPCRequestOperation : public JsonOperation
+	{
+	public:
+		inline RPCRequestOperation(ThingspodTemplate *thingspod, const char *methodName, const JsonVariantConst &params, const uint32_t timeout)
+			: JsonOperation(thingspod, timeout), methodName(methodName), params(params)
+		{
+		}
+
+		inline bool await_suspend(const std::coroutine_handle<> handle)
+		{
+			const uint32_t ticket = (*this->thingspod).scheduler.wait(this, handle, this->timeout);
+			if (ticket == 0U)
+			{
+				return false;
+			}
+			// The scheduler resumes the coroutine on timeout, so the request itself never waits longer than the operation.
+			return this->suspend((*this->thingspod).RPCRequest(this->methodName, this->params, RPCRequestCallback(this->completion(ticket), this->timeout)).valid());
+		}
+
+	private:
+		const char *methodName;
+		JsonVariantConst params;
+	};
+
+	// Calls the method on the server and resumes the awaiting coroutine with the response, for example
+	// AwaitedValues response = co_await thingspod.rpcCall("getCurrentTime");
+	inline RPCRequestOperation rpcCall(const char *methodName, const JsonVariantConst &params = JsonVariantConst(), const uint32_t timeout = DEFAULT_RPC_REQUEST_TIMEOUT)
+	{
+		return RPCRequestOperation(this, methodName, params, timeout);
+	}
+
+#if defined(ESP8266) || defined(ESP32) || defined(ARDUINO_AVR_MEGA)
+
+	class ProvisionOperation : public JsonOperation
+	{
+	public:
+		inline ProvisionOperation(ThingspodTemplate *thingspod, const char *deviceName, const char *provisionDeviceKey, const char *provisionDeviceSecret, const uint32_t timeout)
+			: JsonOperation(thingspod, timeout), deviceName(deviceName), provisionDeviceKey(provisionDeviceKey), provisionDeviceSecret(provisionDeviceSecret)
+		{
+		}
+
+		inline bool await_suspend(const std::coroutine_handle<> handle)
+		{
+			const uint32_t ticket = (*this->thingspod).scheduler.wait(this, handle, this->timeout);
+			if (ticket == 0U)
+			{
+				return false;
+			}
+			return this->suspend((*this->thingspod).provisionSubscribe(ProvisionCallback(this->completion(ticket))) &&
+								 (*this->thingspod).sendProvisionRequest(this->deviceName, this->provisionDeviceKey, this->provisionDeviceSecret));
+		}
+
+	private:
+		const char *deviceName;
+		const char *provisionDeviceKey;
+		const char *provisionDeviceSecret;
+	};
+
+	// Sends the provision request and resumes the awaiting coroutine with the response containing the credentials.
+	inline ProvisionOperation provision(const char *deviceName, const char *provisionDeviceKey, const char *provisionDeviceSecret, const uint32_t timeout = DEFAULT_AWAIT_TIMEOUT)
+	{
+		return ProvisionOperation(this, deviceName, provisionDeviceKey, provisionDeviceSecret, timeout);
+	}
+
+#endif
+
+#if defined(ESP8266) || defined(ESP32)
+
+	class FirmwareOperation : public AwaitedOperation
+	{
+	public:
+		inline FirmwareOperation(ThingspodTemplate *thingspod, const char *currFwTitle, const char *currFwVersion, const uint32_t timeout)
+			: thingspod(thingspod), currFwTitle(currFwTitle), currFwVersion(currFwVersion), timeout(timeout), success(false)
+		{
+		}
+
+		inline const bool await_ready() const
+		{
+			return false;
+		}
+
+		inline bool await_suspend(const std::coroutine_handle<> handle)
+		{
+			const uint32_t ticket = (*this->thingspod).scheduler.wait(this, handle, this->timeout);
+			if (ticket == 0U)
+			{
+				return false;
+			}
+			ThingspodTemplate *thingspod = this->thingspod;
+			const FirmwareUpdateCallback callback = [thingspod, ticket](const bool &success)
+			{
+				FirmwareOperation *operation = static_cast<FirmwareOperation *>((*thingspod).scheduler.find(ticket));
+				if (operation != nullptr)
+				{
+					operation->success = success;
+					(*thingspod).scheduler.complete(operation);
+				}
+			};
+			if ((*this->thingspod).startFirmwareUpdate(this->currFwTitle, this->currFwVersion, callback) && !this->completed)
+			{
+				return true;
+			}
+			(*this->thingspod).scheduler.cancel(this);
+			return false;
+		}
+
+		// False if the update failed, timed out or could not be started.
+		inline const bool await_resume() const
+		{
+			return this->success;
+		}
+
+	private:
+		ThingspodTemplate *thingspod;
+		const char *currFwTitle;
+		const char *currFwVersion;
+		uint32_t timeout;
+		bool success;
+	};
+
+	// Resumes the awaiting coroutine once the firmware update finished. A timed out update is not aborted, only no longer awaited.
+	inline FirmwareOperation updateFirmware(const char *currFwTitle, const char *currFwVersion, const uint32_t timeout)
+	{
+		return FirmwareOperation(this, currFwTitle, currFwVersion, timeout);
+	}
+
+#endif
+
+#endif
+
+	inline void onMessage(char *topic, uint8_t *payload, uint32_t length)
+	{
+		Logger::log(LogMessage(CALLBACK_FUNCTION_CALLED_MESSAGE, topic).c_str());
+
+		const bool attributeUpdate = !this->attribute.isAttributeResponseMessage(topic) && this->attribute.isAttributeMessage(topic);
+		if (attributeUpdate)
+		{
+			this->attribute.invalidateRequestCache();
+		}
+#if defined(ESP8266) || defined(ESP32)
+		// Responses to our own RPC requests share the pending table with mqttClientLoop and are therefore never dispatched.
+		if (this->dispatching && (attributeUpdate || (this->rpc.isRPCMessage(topic) && !this->rpc.isRPCResponseMessage(topic)) || this->gateway.isGatewayRPCMessage(topic) || this->gateway.isGatewayAttributeMessage(topic)))
+		{
+			// Callbacks that use the client themselves, like the firmware update, still run here and only the others on the worker.
+			if (attributeUpdate && this->attribute.hasNetworkTaskCallbacks())
+			{
+				this->attribute.processSharedAttributeUpdateMessage(topic, payload, length, NETWORK_TASK_CALLBACKS);
+			}
+			dispatch(topic, payload, length);
+			return;
+		}
+#endif
+		processMessage(topic, payload, length);
+	}
+
+private:
+	// Passes the message to the module subscribed to its topic.
+	inline void processMessage(char *topic, uint8_t *payload, uint32_t length, const AttributeCallbackSelection selection = ALL_CALLBACKS)
+	{
+		if (this->gateway.isGatewayRPCMessage(topic))
+		{
+			this->gateway.processGatewayRPCMessage(topic, payload, length);
+		}
+		else if (this->gateway.isGatewayAttributeMessage(topic))
+		{
+			this->gateway.processGatewayAttributeMessage(topic, payload, length);
+		}
+		else if (this->rpc.isRPCResponseMessage(topic))
+		{
+			this->rpc.processRPCResponseMessage(topic, payload, length);
+		}
+		else if (this->rpc.isRPCMessage(topic))
+		{
+			this->rpc.processRPCMessage(topic, payload, length);
+		}
+		else if (this->attribute.isAttributeResponseMessage(topic))
+		{
+			this->attribute.processSharedAttributeRequestMessage(topic, payload, length);
+		}
+		else if (this->attribute.isAttributeMessage(topic))
+		{
+			this->attribute.processSharedAttributeUpdateMessage(topic, payload, length, selection);
+		}
+#if defined(ESP8266) || defined(ESP32) || defined(ARDUINO_AVR_MEGA)
+		else if (this->provisioning.isProvisionResponseTopic(topic))
+		{
+			this->provisioning.processProvisioningResponseMessage(topic, payload, length);
+		}
+#endif
+#if defined(ESP8266) || defined(ESP32)
+		else if (this->firmware.isFirmwareResponseTopic(topic))
+		{
+			this->firmware.processFirmwareResponseMessage(topic, payload, length);
+		}
+#endif
+	}
+
+	PubSubClient *mqttClient;
+	bool mqttQoS;
+	const char *host = nullptr;
+	int port = 1883;
+	char accessToken[MAX_ACCESS_TOKEN_LENGTH + 1U] = {};
+	char clientId[MAX_CLIENT_ID_LENGTH + 1U] = {};
+	const char *password = nullptr;
+	bool managedConnection = false;
+	bool reconnecting = false;
+	uint32_t disconnectedAt = 0U;
+	uint32_t nextReconnectAt = 0U;
+	ReconnectBackoff reconnectBackoff;
+	ConnectionStats connectionStats = {};
+	PersistentStorage *sessionStorage = nullptr;
+	FeatureModule<Features::offline, DutyCycleState, NullDutyCycleState> dutyCycle;
+	// The session and every queued message, persisted on the stack of sleep and of beginDutyCycle.
+	static constexpr size_t sessionBlobSize = sizeof(DutyCycleSession) + DEFAULT_OUTBOUND_QUEUE_SIZE * (SESSION_MESSAGE_OVERHEAD + PayloadSize);
+	using OfflineQueue = FeatureModule<Features::offline, OutboundQueue<PayloadSize, DEFAULT_OUTBOUND_QUEUE_SIZE>, NullOutboundQueue>;
+	OfflineQueue outboundQueue;
+#if defined(ESP8266) || defined(ESP32)
+	FeatureModule<Features::producers, ProducerQueue<PrioritizedMessage<PayloadSize>, DEFAULT_PRODUCER_QUEUE_SIZE>, NullProducerQueue<PrioritizedMessage<PayloadSize>>> producerQueue;
+
+	// Hands the responses of dispatched callbacks back to the network task.
+	class DispatchResponses : public ResponseSink
+	{
+	public:
+		inline const bool push(const char *topic, const char *payload, const size_t length) override
+		{
+			return this->queue.tryPush(topic, payload, length);
+		}
+
+		FeatureModule<Features::dispatch, ProducerQueue<DispatchMessage<PayloadSize>, DEFAULT_DISPATCH_QUEUE_SIZE>, NullProducerQueue<DispatchMessage<PayloadSize>>> queue;
+	};
+	bool dispatching = false;
+	FeatureModule<Features::dispatch, ProducerQueue<DispatchMessage<MAX_DISPATCH_PAYLOAD_SIZE>, DEFAULT_DISPATCH_QUEUE_SIZE>, NullProducerQueue<DispatchMessage<MAX_DISPATCH_PAYLOAD_SIZE>>> dispatchQueue;
+	DispatchResponses dispatchResponses;
+#if defined(ESP32)
+	TaskHandle_t dispatchTask = nullptr;
+#endif
+
+	// Lets the modules publish through the outbound scheduler.
+	class ScheduledOutbound : public OutboundSink
+	{
+	public:
+		inline explicit ScheduledOutbound(ThingspodTemplate *client)
+			: client(client)
+		{
+		}
+
+		inline const bool publish(const char *topic, const char *payload, const size_t length, const MessagePriority priority) override
+		{
+			return (*this->client).schedulePublish(topic, payload, length, priority);
+		}
+
+	private:
+		ThingspodTemplate *client;
+	};
+	bool scheduling = false;
+	FeatureModule<Features::scheduling, OutboundScheduler<PayloadSize, MAX_SCHEDULED_MESSAGES>, NullOutboundScheduler> outboundScheduler;
+	ScheduledOutbound scheduledOutbound = ScheduledOutbound(this);
+#endif
+	FeatureModule<Features::shaping, TelemetryFilter, NullTelemetryFilter> telemetryFilter;
+	FeatureModule<Features::shaping, TelemetryAggregator, NullTelemetryAggregator> telemetryAggregator;
+#if defined(__cpp_impl_coroutine)
+	CoroutineScheduler scheduler;
+#endif
+
+	// Publishes the statistics of an elapsed aggregation window.
+	class StatisticsEmitter
+	{
+	public:
+		inline StatisticsEmitter(ThingspodTemplate *thingspod) : thingspod(thingspod) {}
+
+		// The record is encoded into a buffer of its own and published like any other payload, so it is queued while disconnected
+		// as long as it fits into PayloadSize, instead of only ever being streamed. A record that could not be sent is logged.
+		inline void operator()(const char *key, const TelemetryStatistics &statistics)
+		{
+			const FormatBuffer<MAX_AGGREGATED_KEY_LENGTH + 7U> keys[AGGREGATED_VALUES_COUNT] = {
+				FormatBuffer<MAX_AGGREGATED_KEY_LENGTH + 7U>(AGGREGATE_KEY, key, AGGREGATE_MIN_SUFFIX),
+				FormatBuffer<MAX_AGGREGATED_KEY_LENGTH + 7U>(AGGREGATE_KEY, key, AGGREGATE_MAX_SUFFIX),
+				FormatBuffer<MAX_AGGREGATED_KEY_LENGTH + 7U>(AGGREGATE_KEY, key, AGGREGATE_MEAN_SUFFIX),
+				FormatBuffer<MAX_AGGREGATED_KEY_LENGTH + 7U>(AGGREGATE_KEY, key, AGGREGATE_VARIANCE_SUFFIX),
+				FormatBuffer<MAX_AGGREGATED_KEY_LENGTH + 7U>(AGGREGATE_KEY, key, AGGREGATE_COUNT_SUFFIX),
+			};
+			StaticJsonDocument<JSON_OBJECT_SIZE(AGGREGATED_VALUES_COUNT)> jsonBuffer;
+			JsonObject object = jsonBuffer.template to<JsonObject>();
+			object[keys[0].c_str()] = statistics.min;
+			object[keys[1].c_str()] = statistics.max;
+			object[keys[2].c_str()] = statistics.mean;
+			object[keys[3].c_str()] = statistics.variance();
+			object[keys[4].c_str()] = statistics.count;
+
+			char payload[AGGREGATED_RECORD_SIZE];
+			const size_t length = Encoding::measure(object);
+			if (length >= sizeof(payload) || Encoding::serialize(object, payload, sizeof(payload)) != length
+				|| !(*thingspod).publishPayload(TELEMETRY_TOPIC, payload, length, PRIORITY_TELEMETRY))
+			{
+				Logger::log(LogMessage(AGGREGATE_NOT_SENT, key).c_str());
+			}
+		}
+
+	private:
+		ThingspodTemplate *thingspod;
+	};
+	SubscriptionRegistry subscriptions;
+	// Modules disabled by the feature policy are empty stand-ins, their calls below are resolved at compile time.
+	FeatureModule<Features::rpc, RPCTemplate<PayloadSize, Capacities, Logger, Encoding>, NullRPC> rpc;
+	FeatureModule<Features::attributes, AttributeTemplate<PayloadSize, Capacities, Logger, Encoding>, NullAttribute> attribute;
+	FeatureModule<Features::provisioning, ProvisioningTemplate<PayloadSize, Capacities, Logger>, NullProvisioning> provisioning;
+	FeatureModule<Features::firmware, FirmwareTemplate<PayloadSize, Capacities, Logger, Encoding>, NullFirmware> firmware;
+	FeatureModule<Features::gateway, GatewayTemplate<PayloadSize, Capacities, Logger, Encoding>, NullGateway> gateway;
+
+	inline void reconnect()
+	{
+		const uint32_t now = millis();
+		if (!this->reconnecting)
+		{
+			this->reconnecting = true;
+			this->disconnectedAt = now;
+			this->nextReconnectAt = now;
+			this->reconnectBackoff.reset();
+		}
+		if (static_cast<int32_t>(now - this->nextReconnectAt) < 0)
+		{
+			return;
+		}
+
+		if (this->host != nullptr && this->establishConnection())
+		{
+			this->reconnecting = false;
+			this->connectionStats.reconnects++;
+			this->connectionStats.lastReconnectDuration = millis() - this->disconnectedAt;
+			Logger::log(LogMessage(RECONNECT_SUCCESS, this->connectionStats.lastReconnectDuration).c_str());
+			return;
+		}
+
+		const uint32_t backoff = this->reconnectBackoff.nextDelay();
+		this->nextReconnectAt = millis() + backoff;
+		this->connectionStats.failedAttempts++;
+		Logger::log(LogMessage(RECONNECT_FAILED, backoff).c_str());
+	}
+
+	// Connects with the remembered credentials, restores the session in managed mode and forgets it otherwise.
+	inline const bool establishConnection()
+	{
+		(*mqttClient).setServer(this->host, this->port);
+		const bool connection = (*mqttClient).connect(this->clientId, this->accessToken, this->password);
+		if (connection && this->managedConnection)
+		{
+			this->restoreSession();
+		}
+		else if (connection)
+		{
+			// Connecting with a clean session means the broker holds no subscriptions for us anymore,
+			// forget them locally so clearing the callbacks below does not send any UNSUBSCRIBE.
+			this->subscriptions.clear();
+			this->rpc.unsubscribeFromRPC();
+			this->rpc.unsubscribeFromRPCResponses();
+			this->unsubscribeFromSharedAttribute();
+			this->unsubscribeFromSharedAttributeRequest();
+#if defined(ESP8266) || defined(ESP32) || defined(ARDUINO_AVR_MEGA)
+			this->unsubscribeFromProvisioning();
+#endif
+#if defined(ESP8266) || defined(ESP32)
+			this->firmware.unsubscribeFromOTAFirmware();
+#endif
+			this->gateway.clear();
+		}
+		else
+		{
+			Logger::log(CONNECT_FAILED);
+		}
+		return connection;
+	}
+
+	// Copies the credentials into fixed buffers instead of String members, so reconnecting and waking never touch the heap.
+	inline const bool rememberCredentials(const char *host, const int port, const char *accessToken, const char *clientId, const char *password)
+	{
+		if (accessToken == nullptr || clientId == nullptr || strlen(accessToken) > MAX_ACCESS_TOKEN_LENGTH || strlen(clientId) > MAX_CLIENT_ID_LENGTH)
+		{
+			Logger::log(LogMessage(CREDENTIALS_TOO_LONG, MAX_ACCESS_TOKEN_LENGTH, MAX_CLIENT_ID_LENGTH).c_str());
+			return false;
+		}
+		this->host = host;
+		this->port = port;
+		// Reconnecting passes nothing new, copying a buffer onto itself is skipped.
+		if (accessToken != this->accessToken)
+		{
+			strcpy(this->accessToken, accessToken);
+		}
+		if (clientId != this->clientId)
+		{
+			strcpy(this->clientId, clientId);
+		}
+		this->password = password;
+		return true;
+	}
+
+	// Restores everything the application registered before the connection was lost.
+	inline void restoreSession()
+	{
+		const uint32_t start = millis();
+		this->subscriptions.resubscribe();
+		// Without the mirror there is nothing to compare against, requesting every subscribed key would only cost traffic.
+		if (this->attribute.mirrorEnabled())
+		{
+			this->attribute.reconcileMirror();
+		}
+#if defined(ESP8266) || defined(ESP32)
+		this->firmware.resendFirmwareInfo();
+#endif
+		this->gateway.reconnectDevices();
+		this->flushOutboundQueue();
+		this->connectionStats.lastRestoreDuration = millis() - start;
+	}
+
+	// Publishes the messages queued while disconnected, oldest first.
+	inline void flushOutboundQueue()
+	{
+		while (!this->outboundQueue.empty())
+		{
+			const typename OfflineQueue::Message &message = this->outboundQueue.front();
+			if (!(*mqttClient).publish(message.topic, reinterpret_cast<const uint8_t *>(message.payload), message.length, this->mqttQoS))
+			{
+				break;
+			}
+			this->outboundQueue.pop();
+		}
+	}
+
+	// Data is queued while disconnected in managed mode and between the wakes of a duty cycle.
+	inline const bool queuesWhileDisconnected() const
+	{
+		return this->managedConnection || this->sessionStorage != nullptr;
+	}
+
+	// Queued messages are persisted with the index of their topic instead of its address, because the address may change with the next firmware.
+	static inline const char *persistedTopic(const uint8_t index)
+	{
+		const char *const topics[PERSISTED_TOPIC_COUNT] = {TELEMETRY_TOPIC, ATTRIBUTE_TOPIC, GATEWAY_TELEMETRY_TOPIC, GATEWAY_ATTRIBUTE_TOPIC};
+		return index < PERSISTED_TOPIC_COUNT ? topics[index] : nullptr;
+	}
+
+	static inline const uint8_t persistedTopicIndex(const char *topic)
+	{
+		for (uint8_t i = 0U; i < PERSISTED_TOPIC_COUNT; i++)
+		{
+			if (strcmp(persistedTopic(i), topic) == 0)
+			{
+				return i;
+			}
+		}
+		return PERSISTED_TOPIC_COUNT;
+	}
+
+	// Restores the session and the messages that were still queued when the device went to sleep.
+	inline const bool loadSession()
+	{
+		uint8_t blob[sessionBlobSize];
+		const size_t length = (*this->sessionStorage).load(DUTY_CYCLE_SESSION_NAME, blob, sizeof(blob));
+		DutyCycleSession stored;
+		if (length >= sizeof(stored))
+		{
+			memcpy(&stored, blob, sizeof(stored));
+		}
+		if (length < sizeof(stored) || stored.layout != DUTY_CYCLE_LAYOUT_VERSION)
+		{
+			// Refreshed on the first wake, because the server may not know anything about us yet.
+			this->dutyCycle.session = {};
+			this->dutyCycle.session.wakesSinceRefresh = this->dutyCycle.refreshInterval;
+			return false;
+		}
+
+		this->dutyCycle.session = stored;
+		size_t offset = sizeof(stored);
+		for (uint8_t i = 0U; i < stored.queued && offset + SESSION_MESSAGE_OVERHEAD <= length; i++)
+		{
+			uint16_t messageLength = 0U;
+			memcpy(&messageLength, blob + offset + 1U, sizeof(messageLength));
+			const char *topic = persistedTopic(blob[offset]);
+			offset += SESSION_MESSAGE_OVERHEAD;
+			if (topic == nullptr || offset + messageLength > length)
+			{
+				break;
+			}
+			this->outboundQueue.push(topic, reinterpret_cast<const char *>(blob + offset), messageLength);
+			offset += messageLength;
+		}
+		return true;
+	}
+
+	// Persists the session and every queued message, the queue itself is kept in case the device does not actually reset.
+	inline const bool saveSession()
+	{
+		uint8_t blob[sessionBlobSize];
+		size_t offset = sizeof(this->dutyCycle.session);
+		this->dutyCycle.session.layout = DUTY_CYCLE_LAYOUT_VERSION;
+		this->dutyCycle.session.queued = 0U;
+		for (size_t i = 0; i < this->outboundQueue.size(); i++)
+		{
+			const typename OfflineQueue::Message &message = this->outboundQueue.at(i);
+			const uint8_t topic = persistedTopicIndex(message.topic);
+			if (topic == PERSISTED_TOPIC_COUNT)
+			{
+				continue;
+			}
+			blob[offset] = topic;
+			memcpy(blob + offset + 1U, &message.length, sizeof(message.length));
+			memcpy(blob + offset + SESSION_MESSAGE_OVERHEAD, message.payload, message.length);
+			offset += SESSION_MESSAGE_OVERHEAD + message.length;
+			this->dutyCycle.session.queued++;
+		}
+		memcpy(blob, &this->dutyCycle.session, sizeof(this->dutyCycle.session));
+		return (*this->sessionStorage).save(DUTY_CYCLE_SESSION_NAME, blob, offset);
+	}
+
+#if defined(ESP8266) || defined(ESP32)
+
+	inline const bool tryEnqueue(const char *topic, const MessagePriority priority, const Telemetry *data, size_t data_count)
+	{
+		if (data == nullptr || data_count > Capacities::outboundFields)
+		{
+			return false;
+		}
+
+		StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::outboundFields)> jsonBuffer;
+		JsonVariant object = jsonBuffer.template to<JsonVariant>();
+		for (size_t i = 0; i < data_count; ++i)
+		{
+			if (!data[i].serializeKeyValue(object))
+			{
+				return false;
+			}
+		}
+		if (JSON_STRING_SIZE(Encoding::measure(jsonBuffer)) > PayloadSize)
+		{
+			return false;
+		}
+		char payload[PayloadSize];
+		const size_t length = Encoding::serialize(jsonBuffer, payload, sizeof(payload));
+		return this->producerQueue.tryPush(topic, payload, length, priority);
+	}
+
+	// Publishes what other tasks enqueued, so only the task running mqttClientLoop ever touches the client.
+	inline void drainProducerQueue()
+	{
+		const PrioritizedMessage<PayloadSize> *message = nullptr;
+		while ((message = this->producerQueue.front()) != nullptr)
+		{
+			if (!publishPayload(message->topic, message->payload, message->length, message->priority))
+			{
+				break;
+			}
+			this->producerQueue.pop();
+		}
+		// Responses of dispatched callbacks answer a request of the current session, so they are dropped instead of queued while offline.
+		const DispatchMessage<PayloadSize> *response = nullptr;
+		while ((response = this->dispatchResponses.queue.front()) != nullptr)
+		{
+			if ((*mqttClient).connected() && !(this->scheduling ? schedulePublish(response->topic, response->payload, response->length, PRIORITY_RPC)
+																: (*mqttClient).publish(response->topic, reinterpret_cast<const uint8_t *>(response->payload), response->length, this->mqttQoS)))
+			{
+				break;
+			}
+			this->dispatchResponses.queue.pop();
+		}
+	}
+
+	// Publishes right away if the class of the message has nothing queued and a token left, queues it otherwise.
+	inline const bool schedulePublish(const char *topic, const char *payload, const size_t length, const MessagePriority priority)
+	{
+		if (!(*mqttClient).connected())
+		{
+			// Only data is kept for the next session, responses and firmware states belong to the lost one and are sent again on restore.
+			return queuesWhileDisconnected() && priority >= PRIORITY_ATTRIBUTE && keepForNextSession(topic, payload, length);
+		}
+		else if (!this->outboundScheduler.admit(priority, millis()))
+		{
+			return this->outboundScheduler.push(priority, topic, payload, length);
+		}
+		else if (!(*mqttClient).publish(topic, reinterpret_cast<const uint8_t *>(payload), length, this->mqttQoS))
+		{
+			this->outboundScheduler.giveBack(priority);
+			return false;
+		}
+		return true;
+	}
+
+	// Queues data for the next connection the same way as without the scheduler. Other topics, like shared attribute requests or
+	// gateway device announcements, contain state of the current session and are sent again on restore, so they are dropped.
+	inline const bool keepForNextSession(const char *topic, const char *payload, const size_t length)
+	{
+		const char *persisted = persistedTopic(persistedTopicIndex(topic));
+		return persisted != nullptr && this->outboundQueue.push(persisted, payload, length);
+	}
+
+	inline void drainOutboundScheduler()
+	{
+		if (this->outboundScheduler.empty())
+		{
+			return;
+		}
+		this->outboundScheduler.drain(millis(), [this](const DispatchMessage<PayloadSize> &message)
+									  { return (*this->mqttClient).publish(message.topic, reinterpret_cast<const uint8_t *>(message.payload), message.length, this->mqttQoS); });
+	}
+
+	inline void dispatch(const char *topic, const uint8_t *payload, const uint32_t length)
+	{
+		if (!DispatchMessage<MAX_DISPATCH_PAYLOAD_SIZE>::fits(topic, length))
+		{
+			Logger::log(LogMessage(DISPATCH_MESSAGE_TOO_BIG, topic, length).c_str());
+			return;
+		}
+		else if (this->dispatchQueue.tryPush(topic, reinterpret_cast<const char *>(payload), length))
+		{
+#if defined(ESP32)
+			if (this->dispatchTask != nullptr)
+			{
+				xTaskNotifyGive(this->dispatchTask);
+			}
+#endif
+			return;
+		}
+		Logger::log(LogMessage(DISPATCH_QUEUE_FULL, topic).c_str());
+	}
+
+#if defined(ESP32)
+	static void dispatchTaskLoop(void *parameter)
+	{
+		ThingspodTemplate *thingspod = static_cast<ThingspodTemplate *>(parameter);
+		while (true)
+		{
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			(*thingspod).processDispatchedMessages();
+		}
+	}
+#endif
+
+#endif
+
+	// Serializes the object with the configured Encoding and publishes it.
+	inline const bool sendEncoded(const char *topic, const JsonObject &jsonObject, const MessagePriority priority)
+	{
+		const uint32_t json_object_size = jsonObject.size();
+		if (Capacities::outboundFields < json_object_size)
+		{
+			Logger::log(LogMessage(TOO_MANY_JSON_FIELDS, json_object_size, Capacities::outboundFields).c_str());
+			return false;
+		}
+		const uint32_t json_size = JSON_STRING_SIZE(Encoding::measure(jsonObject));
+		if (json_size > PayloadSize)
+		{
+			return streamEncoded(topic, jsonObject, json_size - 1U);
+		}
+		char json[PayloadSize];
+		const size_t length = Encoding::serialize(jsonObject, json, sizeof(json));
+		return publishPayload(topic, json, length, priority);
+	}
+
+	// Payloads bigger than PayloadSize are written directly into the connection instead of being copied into a buffer first,
+	// the MQTT header needs the length upfront, which is why the payload has to be measured before.
+	inline const bool beginStream(const char *topic, const size_t length)
+	{
+		if (!(*mqttClient).connected())
+		{
+			Logger::log(STREAMED_PAYLOAD_OFFLINE);
+			return false;
+		}
+		return (*mqttClient).beginPublish(topic, length, this->mqttQoS);
+	}
+
+	inline const bool streamPayload(const char *topic, const char *payload, const size_t length)
+	{
+		if (!beginStream(topic, length))
+		{
+			return false;
+		}
+		const size_t written = (*mqttClient).write(reinterpret_cast<const uint8_t *>(payload), length);
+		return (*mqttClient).endPublish() && written == length;
+	}
+
+	// Serializes the source a second time straight into the connection, only one chunk of the payload is ever kept in RAM.
+	template <typename Source>
+	inline const bool streamEncoded(const char *topic, const Source &source, const size_t length)
+	{
+		if (!beginStream(topic, length))
+		{
+			return false;
+		}
+		BufferedPrint<> output(*mqttClient);
+		Encoding::serialize(source, output);
+		output.flush();
+		return (*mqttClient).endPublish() && output.flushed() == length;
+	}
+
+	// Publishes with an explicit length, because binary encoded payloads may contain null bytes.
+	// In managed mode and between the wakes of a duty cycle the payload is queued while disconnected and replayed once connected again.
+	inline const bool publishPayload(const char *topic, const char *payload, const size_t length, const MessagePriority priority)
+	{
+#if defined(ESP8266) || defined(ESP32)
+		if (this->scheduling)
+		{
+			return schedulePublish(topic, payload, length, priority);
+		}
+#endif
+		if (queuesWhileDisconnected() && !(*mqttClient).connected())
+		{
+			return this->outboundQueue.push(topic, payload, length);
+		}
+		return (*mqttClient).publish(topic, reinterpret_cast<const uint8_t *>(payload), length, this->mqttQoS);
+	}
+
+	template <typename T>
+	inline const bool sendKeyval(const char *key, T value, bool telemetry = true)
+	{
+		Telemetry t(key, value);
+		const uint32_t now = millis();
+		if (telemetry && this->telemetryAggregator.sample(t, now, StatisticsEmitter(this)))
+		{
+			return true;
+		}
+		else if (telemetry && !this->telemetryFilter.filter(t, now))
+		{
+			return true;
+		}
+
+		StaticJsonDocument<JSON_OBJECT_SIZE(1)> jsonBuffer;
+		JsonVariant object = jsonBuffer.template to<JsonVariant>();
+		if (!t.serializeKeyValue(object))
+		{
+			Logger::log(UNABLE_TO_SERIALIZE);
+			return false;
+		}
+
+		if (!telemetry)
+		{
+			return sendAttributeJSON(object);
+		}
+		else if (!sendTelemetryJson(object))
+		{
+			return false;
+		}
+		this->telemetryFilter.markSent(t, now);
+		return true;
+	}
+
+	inline const bool sendDataArray(const Telemetry *data, size_t data_count, bool telemetry = true)
+	{
+		StaticJsonDocument<JSON_OBJECT_SIZE(Capacities::outboundFields)> jsonBuffer;
+		JsonVariant object = jsonBuffer.template to<JsonVariant>();
+		const uint32_t now = millis();
+		StaticVector<const Telemetry *, Capacities::outboundFields> filtered;
+
+		for (size_t i = 0; i < data_count; ++i)
+		{
+			if (telemetry && this->telemetryAggregator.sample(data[i], now, StatisticsEmitter(this)))
+			{
+				continue;
+			}
+			else if (telemetry && !this->telemetryFilter.filter(data[i], now))
+			{
+				continue;
+			}
+			if (data[i].serializeKeyValue(object) == false)
+			{
+				Logger::log(UNABLE_TO_SERIALIZE);
+				return false;
+			}
+			filtered.push_back(&data[i]);
+		}
+
+		if (!telemetry)
+		{
+			return sendAttributeJSON(object);
+		}
+		// Every value was suppressed by the filter, nothing to publish.
+		else if (filtered.empty())
+		{
+			return true;
+		}
+		else if (!sendTelemetryJson(object))
+		{
+			return false;
+		}
+		for (const Telemetry *sent : filtered)
+		{
+			this->telemetryFilter.markSent(*sent, now);
+		}
+		return true;
 	}
 };
 
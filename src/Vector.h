@@ -0,0 +1,149 @@
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include "Arduino.h"
+
+// Vector with a fixed capacity and the elements stored inline, replaces std::vector where the maximum size is known upfront,
+// to ensure no heap allocation is ever done after construction.
+template <typename T, size_t Capacity>
+class StaticVector
+{
+
+public:
+  using iterator = T *;
+  using const_iterator = const T *;
+
+  inline StaticVector()
+      : elements(), count(0U)
+  {
+  }
+
+  template <class InputIterator>
+  inline StaticVector(const InputIterator &first_itr, const InputIterator &last_itr)
+      : elements(), count(0U)
+  {
+    insert(end(), first_itr, last_itr);
+  }
+
+  inline const size_t size() const
+  {
+    return count;
+  }
+
+  inline const size_t capacity() const
+  {
+    return Capacity;
+  }
+
+  inline const bool empty() const
+  {
+    return count == 0U;
+  }
+
+  inline const bool full() const
+  {
+    return count == Capacity;
+  }
+
+  inline iterator begin()
+  {
+    return elements;
+  }
+
+  inline iterator end()
+  {
+    return elements + count;
+  }
+
+  inline const_iterator begin() const
+  {
+    return elements;
+  }
+
+  inline const_iterator end() const
+  {
+    return elements + count;
+  }
+
+  inline const_iterator cbegin() const
+  {
+    return elements;
+  }
+
+  inline const_iterator cend() const
+  {
+    return elements + count;
+  }
+
+  inline T &at(const size_t index)
+  {
+    return elements[index];
+  }
+
+  inline const T &at(const size_t index) const
+  {
+    return elements[index];
+  }
+
+  inline T &operator[](const size_t index)
+  {
+    return elements[index];
+  }
+
+  inline const T &operator[](const size_t index) const
+  {
+    return elements[index];
+  }
+
+  inline const bool push_back(const T &element)
+  {
+    if (full())
+    {
+      return false;
+    }
+    elements[count++] = element;
+    return true;
+  }
+
+  // Only appending is supported, inserted elements exceeding the capacity are dropped.
+  template <class InputIterator>
+  inline const bool insert(const_iterator position, const InputIterator &first_itr, const InputIterator &last_itr)
+  {
+    (void)position;
+    for (InputIterator itr = first_itr; itr != last_itr; ++itr)
+    {
+      if (!push_back(*itr))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  inline iterator erase(iterator position)
+  {
+    for (iterator itr = position + 1; itr != end(); ++itr)
+    {
+      *(itr - 1) = *itr;
+    }
+    count--;
+    // Reset the now unused element, to release whatever it was holding.
+    elements[count] = T();
+    return position;
+  }
+
+  inline void clear()
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      elements[i] = T();
+    }
+    count = 0U;
+  }
+
+private:
+  T elements[Capacity == 0U ? 1U : Capacity];
+  size_t count;
+};
+
+#endif // VECTOR_H
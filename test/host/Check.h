@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdio>
+
+// Counts failed checks, every test returns the count from main, so any failure makes the run script fail.
+inline int &failedChecks()
+{
+  static int failed = 0;
+  return failed;
+}
+
+#define CHECK(condition)                                                   \
+  do                                                                       \
+  {                                                                        \
+    if (!(condition))                                                      \
+    {                                                                      \
+      std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      failedChecks()++;                                                    \
+    }                                                                      \
+  } while (false)
@@ -0,0 +1,79 @@
+// Counts heap allocations while the client handles messages after setup, the callback containers and callables have to store
+// everything inline, so the count has to stay at zero.
+#include <cstdlib>
+#include <new>
+#include "Check.h"
+#include <Thingspod.h>
+
+static size_t allocations = 0U;
+
+void *operator new(size_t size)
+{
+  allocations++;
+  void *memory = std::malloc(size);
+  if (memory == nullptr)
+  {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+  std::free(memory);
+}
+
+static Client wifiClient;
+static PubSubClient mqttClient(wifiClient);
+static Thingspod thingspod(wifiClient, &mqttClient);
+
+int main()
+{
+  static const char *const keys[] = {"interval", "threshold"};
+  static const char *const tooManyKeys[] = {"k0", "k1", "k2", "k3", "k4", "k5", "k6", "k7", "k8"};
+  static_assert(sizeof(tooManyKeys) / sizeof(tooManyKeys[0]) > MAX_SHARED_ATTRIBUTE_KEYS, "The test needs more keys than a callback holds");
+  const char *const *const keysBegin = keys;
+  const char *const *const keysEnd = keys + 2;
+  const char *const *const tooManyBegin = tooManyKeys;
+  const char *const *const tooManyEnd = tooManyKeys + 9;
+
+  // Setup.
+  size_t calls = 0U;
+  const RPCCallback rpc("echo", [&calls](const RPCData &) { calls++; return RPCResponse("echo", 1); });
+  CHECK(thingspod.RPCSubscribe(&rpc, &rpc + 1));
+  CHECK(thingspod.sharedAttributesSubscribe(SharedAttributeCallback(keysBegin, keysEnd, [&calls](const SharedAttributeData &) { calls++; })));
+  CHECK(thingspod.startFirmwareUpdate("title", "1.0.0", [](const bool &) {}));
+
+  // Keys that do not fit are refused instead of being silently dropped.
+  CHECK(!thingspod.sharedAttributesSubscribe(SharedAttributeCallback(tooManyBegin, tooManyEnd, [](const SharedAttributeData &) {})));
+
+  const size_t before = allocations;
+  char rpcTopic[] = "v1/devices/me/rpc/request/17";
+  uint8_t rpcPayload[] = "{\"method\":\"echo\",\"params\":{}}";
+  thingspod.onMessage(rpcTopic, rpcPayload, sizeof(rpcPayload) - 1U);
+  char attributeTopic[] = "v1/devices/me/attributes";
+  uint8_t attributePayload[] = "{\"interval\":10,\"fw_title\":\"title\",\"fw_version\":\"1.0.0\"}";
+  thingspod.onMessage(attributeTopic, attributePayload, sizeof(attributePayload) - 1U);
+
+  const Telemetry values[] = {Telemetry("temperature", 21.5f), Telemetry("door", true), Telemetry("state", "idle")};
+  thingspod.sendTelemetry(values, 3U);
+  thingspod.sendAttributes(values, 3U);
+  CHECK(thingspod.sendTelemetryJsonChar("{\"temperature\":21.5}"));
+  SharedAttributeRequestCallback request([](const SharedAttributeData &) {});
+  thingspod.sharedAttributesRequest(keysBegin, keysEnd, request);
+  // One shot requests are bounded by their own sizes, the provisioning request of the example is about twice the PayloadSize.
+  CHECK(thingspod.sendProvisionRequest("ProvisionedDevice", "glvrlhqffkongkik8w5h", "ltzbcv2voso4fkbmu4pl"));
+  CHECK(thingspod.sendClaimingRequest("claimingSecret", 60000U));
+  thingspod.mqttClientLoop();
+
+  std::printf("allocations after setup: %zu\n", allocations - before);
+  CHECK(allocations == before);
+  // Without this a callback that never ran would pass as well.
+  CHECK(calls == 2U);
+  return failedChecks();
+}
@@ -0,0 +1,67 @@
+// Shared attribute requests whose response never arrives have to give their slot back once their timeout passed, otherwise a few
+// lost responses would make every later request fail. The failed callback has to be called instead of the response callback.
+#include "Check.h"
+#include <Thingspod.h>
+
+static constexpr size_t PENDING_REQUESTS = 2U;
+
+using Capacities = CapacityTraits<2U, 2U, PENDING_REQUESTS, 8U, 8U, 64U>;
+static Client wifiClient;
+static PubSubClient mqttClient(wifiClient);
+static ThingspodTemplate<64U, 8U, Logger, JsonEncoding, AllFeatures, Capacities> thingspod(wifiClient, &mqttClient);
+
+static size_t responses = 0U;
+static size_t failures = 0U;
+
+static const bool request(const char *key)
+{
+  const char *const keys[] = {key};
+  const char *const *const keysBegin = keys;
+  const char *const *const keysEnd = keys + 1U;
+  SharedAttributeRequestCallback callback([](const SharedAttributeData &)
+                                          { responses++; },
+                                          []()
+                                          { failures++; });
+  const bool requested = thingspod.sharedAttributesRequest(keysBegin, keysEnd, callback);
+  thingspod.mqttClientLoop();
+  return requested;
+}
+
+static void respond(const uint32_t id, const char *payload)
+{
+  char topic[64];
+  snprintf(topic, sizeof(topic), "v1/devices/me/attributes/response/%u", id);
+  char copy[64];
+  snprintf(copy, sizeof(copy), "%s", payload);
+  thingspod.onMessage(topic, reinterpret_cast<uint8_t *>(copy), strlen(copy));
+}
+
+int main()
+{
+  // Every slot waits for a response that is lost.
+  CHECK(request("interval"));
+  CHECK(request("mode"));
+  CHECK(!request("threshold"));
+  CHECK(failures == 0U);
+
+  // Nothing expires early.
+  fakeMillis() += ATTRIBUTE_REQUEST_TIMEOUT - 1U;
+  thingspod.mqttClientLoop();
+  CHECK(failures == 0U);
+
+  fakeMillis() += 1U;
+  thingspod.mqttClientLoop();
+  CHECK(failures == PENDING_REQUESTS);
+  CHECK(responses == 0U);
+
+  // The slots are free again and the keys of the expired request are asked for again, instead of waiting for the lost response.
+  CHECK(request("mode"));
+  CHECK(strcmp(mqttClient.lastTopic, "v1/devices/me/attributes/request/3") == 0);
+  respond(3U, "{\"shared\":{\"mode\":\"eco\"}}");
+  CHECK(responses == 1U);
+
+  // A response arriving after its request expired is not passed to anybody.
+  respond(1U, "{\"shared\":{\"interval\":10}}");
+  CHECK(responses == 1U && failures == PENDING_REQUESTS);
+  return failedChecks();
+}
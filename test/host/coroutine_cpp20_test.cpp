@@ -0,0 +1,104 @@
+// Awaits shared attribute requests from coroutines. A coroutine has to be resumed with the values once the response arrived and
+// without values once its timeout passed, in which case the request has to give its slot back right away. Coroutines started
+// while every frame of the pool is taken must not start at all.
+// Frames big enough for the awaited values with any ArduinoJson build, the test is about how the pool is used and not its size.
+#define COROUTINE_FRAME_SIZE 16384
+#include "Check.h"
+#include <Thingspod.h>
+
+static constexpr uint32_t TIMEOUT = 1000U;
+static_assert(TIMEOUT < ATTRIBUTE_REQUEST_TIMEOUT, "The slot has to be given back by the cancelled operation, not by the expired request");
+
+// One pending request per frame, so every coroutine of the pool can wait at once.
+static constexpr size_t PENDING_REQUESTS = MAX_COROUTINE_FRAMES;
+using Capacities = CapacityTraits<2U, 2U, PENDING_REQUESTS, 4U, 4U, 64U>;
+using Client_t = ThingspodTemplate<64U, 4U, Logger, JsonEncoding, AllFeatures, Capacities>;
+
+static Client wifiClient;
+static PubSubClient mqttClient(wifiClient);
+static Client_t thingspod(wifiClient, &mqttClient);
+
+static const char *const KEYS[] = {"interval"};
+
+struct Result
+{
+  bool resumed;
+  bool success;
+  int interval;
+};
+
+static CoroutineTask awaitInterval(Result &result)
+{
+  const Client_t::AwaitedValues values = co_await thingspod.requestShared(KEYS, TIMEOUT);
+  result.resumed = true;
+  result.success = static_cast<bool>(values);
+  result.interval = values ? values.values()["interval"].as<int>() : 0;
+}
+
+static void respond(const char *topic, const char *payload)
+{
+  char topicCopy[64];
+  char payloadCopy[64];
+  snprintf(topicCopy, sizeof(topicCopy), "%s", topic);
+  snprintf(payloadCopy, sizeof(payloadCopy), "%s", payload);
+  thingspod.onMessage(topicCopy, reinterpret_cast<uint8_t *>(payloadCopy), strlen(payloadCopy));
+}
+
+int main()
+{
+  // Resumed with the values of the response by the next loop.
+  Result answered = {};
+  CHECK(awaitInterval(answered).started());
+  thingspod.mqttClientLoop();
+  CHECK(strcmp(mqttClient.lastTopic, "v1/devices/me/attributes/request/1") == 0);
+  CHECK(!answered.resumed);
+  respond("v1/devices/me/attributes/response/1", "{\"shared\":{\"interval\":10}}");
+  thingspod.mqttClientLoop();
+  CHECK(answered.resumed && answered.success && answered.interval == 10);
+
+  // Resumed without values once the timeout passed, every request slot is free again right away.
+  Result lost[PENDING_REQUESTS] = {};
+  for (Result &result : lost)
+  {
+    CHECK(awaitInterval(result).started());
+  }
+  thingspod.mqttClientLoop();
+  fakeMillis() += TIMEOUT;
+  thingspod.mqttClientLoop();
+  SharedAttributeRequestCallback requests[PENDING_REQUESTS];
+  const char *const *const keysBegin = KEYS;
+  const char *const *const keysEnd = KEYS + 1U;
+  for (size_t i = 0U; i < PENDING_REQUESTS; i++)
+  {
+    CHECK(lost[i].resumed && !lost[i].success);
+    CHECK(thingspod.sharedAttributesRequest(keysBegin, keysEnd, requests[i]));
+  }
+  for (const SharedAttributeRequestCallback &request : requests)
+  {
+    thingspod.cancelSharedAttributesRequest(request);
+  }
+
+  // Every frame of the pool is taken by a suspended coroutine, the next one is not started.
+  Result waiting[MAX_COROUTINE_FRAMES] = {};
+  for (Result &result : waiting)
+  {
+    CHECK(awaitInterval(result).started());
+  }
+  Result rejected = {};
+  CHECK(!awaitInterval(rejected).started());
+  CHECK(!rejected.resumed);
+
+  // Finished coroutines give their frame back.
+  fakeMillis() += TIMEOUT;
+  thingspod.mqttClientLoop();
+  for (const Result &result : waiting)
+  {
+    CHECK(result.resumed);
+  }
+  Result restarted = {};
+  CHECK(awaitInterval(restarted).started());
+  fakeMillis() += TIMEOUT;
+  thingspod.mqttClientLoop();
+  CHECK(restarted.resumed);
+  return failedChecks();
+}
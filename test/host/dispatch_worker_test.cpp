@@ -0,0 +1,119 @@
+// Dispatches RPC requests to a worker std::thread whose callback blocks, like a callback driving slow hardware. mqttClientLoop on
+// the main thread has to keep returning quickly while the callback blocks, and the responses have to be routed back through the
+// dispatch response queue and published by mqttClientLoop on the main thread, in the order of the requests.
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include "Check.h"
+#include <Thingspod.h>
+
+static constexpr auto BLOCKED_FOR = std::chrono::milliseconds(200);
+static constexpr auto MAX_LOOP_LATENCY = std::chrono::milliseconds(20);
+static constexpr auto RESPONSE_TIMEOUT = std::chrono::seconds(5);
+static constexpr size_t REQUESTS = 2U;
+
+// The worker must not print through the stdio buffers the main thread prints through.
+struct QuietLogger
+{
+  static void log(const char *) {}
+};
+
+static Client wifiClient;
+static PubSubClient mqttClient(wifiClient);
+static ThingspodTemplate<64U, 8U, QuietLogger> thingspod(wifiClient, &mqttClient);
+
+static std::atomic<bool> released(false);
+static std::atomic<bool> stopped(false);
+static std::atomic<size_t> started(0U);
+static std::thread::id mainThread;
+static std::thread::id callbackThread;
+static char responses[REQUESTS][64];
+static size_t responseCount = 0U;
+static bool publishedOffMainThread = false;
+
+static void rememberResponse(PubSubClient &, const char *topic, const char *, size_t)
+{
+  publishedOffMainThread = publishedOffMainThread || std::this_thread::get_id() != mainThread;
+  if (strncmp(topic, "v1/devices/me/rpc/response/", strlen("v1/devices/me/rpc/response/")) == 0 && responseCount < REQUESTS)
+  {
+    snprintf(responses[responseCount++], sizeof(responses[0]), "%s", topic);
+  }
+}
+
+static void work()
+{
+  while (!stopped)
+  {
+    if (thingspod.processDispatchedMessages() == 0U)
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+static void deliver(const char *topic, const char *payload)
+{
+  char topicCopy[64];
+  char payloadCopy[64];
+  snprintf(topicCopy, sizeof(topicCopy), "%s", topic);
+  snprintf(payloadCopy, sizeof(payloadCopy), "%s", payload);
+  thingspod.onMessage(topicCopy, reinterpret_cast<uint8_t *>(payloadCopy), strlen(payloadCopy));
+}
+
+int main()
+{
+  mainThread = std::this_thread::get_id();
+  mqttClient.publishHook = rememberResponse;
+  CHECK(thingspod.RPCSubscribe(RPCCallback("move", [](const RPCData &)
+                                           {
+                                             callbackThread = std::this_thread::get_id();
+                                             started++;
+                                             const auto start = std::chrono::steady_clock::now();
+                                             while (!released || std::chrono::steady_clock::now() - start < BLOCKED_FOR)
+                                             {
+                                               std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                                             }
+                                             return RPCResponse("done", true); })));
+  CHECK(thingspod.enableDispatch());
+  std::thread worker(work);
+
+  deliver("v1/devices/me/rpc/request/1", "{\"method\":\"move\",\"params\":{}}");
+  deliver("v1/devices/me/rpc/request/2", "{\"method\":\"move\",\"params\":{}}");
+
+  // The first callback blocks the worker, the network loop keeps running meanwhile.
+  std::chrono::steady_clock::duration slowest = std::chrono::steady_clock::duration::zero();
+  const auto blockedAt = std::chrono::steady_clock::now();
+  while (std::chrono::steady_clock::now() - blockedAt < BLOCKED_FOR)
+  {
+    const auto before = std::chrono::steady_clock::now();
+    thingspod.mqttClientLoop();
+    const auto took = std::chrono::steady_clock::now() - before;
+    slowest = took > slowest ? took : slowest;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  std::printf("slowest mqttClientLoop while the callback blocked: %.3f ms\n", std::chrono::duration<double, std::milli>(slowest).count());
+  CHECK(slowest < MAX_LOOP_LATENCY);
+  CHECK(started == 1U);
+  CHECK(responseCount == 0U);
+
+  // Released, both responses are published by the loop of the main thread.
+  released = true;
+  const auto releasedAt = std::chrono::steady_clock::now();
+  while (responseCount < REQUESTS && std::chrono::steady_clock::now() - releasedAt < RESPONSE_TIMEOUT)
+  {
+    thingspod.mqttClientLoop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  stopped = true;
+  worker.join();
+
+  CHECK(started == REQUESTS);
+  CHECK(callbackThread != mainThread);
+  CHECK(!publishedOffMainThread);
+  CHECK(responseCount == REQUESTS);
+  CHECK(strcmp(responses[0], "v1/devices/me/rpc/response/1") == 0);
+  CHECK(strcmp(responses[1], "v1/devices/me/rpc/response/2") == 0);
+  CHECK(thingspod.droppedDispatchMessages() == 0U);
+  return failedChecks();
+}
@@ -0,0 +1,134 @@
+// Runs duty cycles against the fake broker and compares their MQTT traffic with the classic connect, subscribe, publish and
+// disconnect cycle. A resumed wake has to skip the SUBSCRIBE and the refresh, and data sent while asleep or held back by a
+// rate limit has to survive the sleep and be published by the next wake, with and without the outbound scheduler.
+#include <cstdio>
+#include "Check.h"
+#include <Thingspod.h>
+
+// Keeps the one session blob in RAM, like the RTC memory of a deep sleeping ESP32.
+class RamStorage : public PersistentStorage
+{
+public:
+  size_t load(const char *, uint8_t *buffer, size_t size) override
+  {
+    if (length == 0U || length > size)
+    {
+      return 0U;
+    }
+    memcpy(buffer, blob, length);
+    return length;
+  }
+
+  bool save(const char *, const uint8_t *data, size_t size) override
+  {
+    if (size > sizeof(blob))
+    {
+      return false;
+    }
+    memcpy(blob, data, size);
+    length = size;
+    return true;
+  }
+
+private:
+  uint8_t blob[4096];
+  size_t length = 0U;
+};
+
+enum class Mode
+{
+  OFFLINE,
+  ONLINE,
+  RATE_LIMITED,
+};
+
+static Client wifiClient;
+static RamStorage storage;
+static const char *KEYS[] = {"interval"};
+static const char *const *const keysBegin = KEYS;
+static const char *const *const keysEnd = KEYS + 1U;
+
+static PubSubClient classic()
+{
+  PubSubClient client(wifiClient);
+  Thingspod thingspod(wifiClient, &client);
+  thingspod.connect("host", 1883, "token");
+  thingspod.RPCSubscribe(RPCCallback("reboot", [](const RPCData &)
+                                     { return RPCResponse(); }));
+  thingspod.sharedAttributesSubscribe(SharedAttributeCallback(keysBegin, keysEnd, [](const SharedAttributeData &) {}));
+  thingspod.sendTelemetryJsonChar("{\"temperature\":21.5}");
+  thingspod.mqttClientLoop();
+  thingspod.disconnect();
+  return client;
+}
+
+// One boot of a duty cycled device: callbacks are registered before waking, the sample is queued and sent in one batch.
+// Rate limited boots send two more samples while connected, the scheduler has to hold back the second one until sleep.
+static PubSubClient dutyCycle(const bool persistent, const bool scheduled, const Mode mode, DutyCycleStats &stats)
+{
+  PubSubClient client(wifiClient);
+  client.online = false;
+  Thingspod thingspod(wifiClient, &client);
+  thingspod.beginDutyCycle(storage, persistent, 4U);
+  if (scheduled)
+  {
+    thingspod.enableOutboundScheduler();
+    thingspod.setRateLimit(PRIORITY_TELEMETRY, 1U, 60000U);
+  }
+  thingspod.RPCSubscribe(RPCCallback("reboot", [](const RPCData &)
+                                     { return RPCResponse(); }));
+  thingspod.sharedAttributesSubscribe(SharedAttributeCallback(keysBegin, keysEnd, [](const SharedAttributeData &) {}));
+  CHECK(thingspod.sendTelemetryJsonChar("{\"temperature\":21.5}"));
+  if (mode != Mode::OFFLINE)
+  {
+    CHECK(thingspod.wake("host", 1883, "token"));
+  }
+  if (mode == Mode::RATE_LIMITED)
+  {
+    CHECK(thingspod.sendTelemetryJsonChar("{\"temperature\":22.5}"));
+    CHECK(thingspod.sendTelemetryJsonChar("{\"temperature\":23.5}"));
+    CHECK(thingspod.scheduledMessages(PRIORITY_TELEMETRY) == 1U);
+  }
+  CHECK(thingspod.sleep());
+  stats = thingspod.getDutyCycleStats();
+  return client;
+}
+
+int main()
+{
+  const PubSubClient reference = classic();
+  std::printf("classic cycle: %zu bytes, %d publishes, %d subscribes\n", reference.wireBytes, reference.publishCount, reference.subscribeCount);
+
+  DutyCycleStats stats;
+  const PubSubClient first = dutyCycle(true, false, Mode::ONLINE, stats);
+  CHECK(stats.lastResubscribed && stats.lastRefreshed && stats.lastFlushed == 1U);
+  // The topics go out in one batched SUBSCRIBE written with the raw client, instead of one subscribe call each.
+  std::printf("first wake: %zu bytes, %d publishes, %d subscribes\n", first.wireBytes, first.publishCount, first.subscribeCount);
+  CHECK(first.subscribeCount == 0);
+
+  const PubSubClient resumed = dutyCycle(true, false, Mode::ONLINE, stats);
+  std::printf("resumed wake: %zu bytes, %d publishes, %d subscribes\n", resumed.wireBytes, resumed.publishCount, resumed.subscribeCount);
+  CHECK(!stats.lastResubscribed && !stats.lastRefreshed);
+  CHECK(resumed.publishCount == 1 && resumed.subscribeCount == 0);
+  CHECK(resumed.wireBytes < first.wireBytes && resumed.wireBytes < reference.wireBytes);
+
+  // A boot without connection keeps its sample, the next wake sends both.
+  dutyCycle(true, false, Mode::OFFLINE, stats);
+  const PubSubClient late = dutyCycle(true, false, Mode::ONLINE, stats);
+  CHECK(late.publishCount == 2 && stats.lastFlushed == 2U);
+
+  // The same with the scheduler, whose queues are not persisted, so offline data has to end up in the persisted queue.
+  dutyCycle(true, true, Mode::OFFLINE, stats);
+  const PubSubClient scheduledLate = dutyCycle(true, true, Mode::ONLINE, stats);
+  CHECK(scheduledLate.publishCount == 2 && stats.lastFlushed == 2U);
+
+  // A sample held back by the rate limit is persisted at sleep and published by the next wake.
+  const PubSubClient limited = dutyCycle(true, true, Mode::RATE_LIMITED, stats);
+  CHECK(limited.publishCount == 2);
+  dutyCycle(true, true, Mode::ONLINE, stats);
+  CHECK(stats.lastFlushed == 2U);
+
+  const PubSubClient clean = dutyCycle(false, false, Mode::ONLINE, stats);
+  CHECK(stats.lastResubscribed && clean.cleanSessions == 1);
+  return failedChecks();
+}
@@ -0,0 +1,90 @@
+// Compares the JSON and the MessagePack encoding on a telemetry sample, an attribute update and an RPC request: the encoded size
+// and the time to encode and decode each of them. Every payload has to survive the round trip through both encodings and the
+// binary one has to be smaller. Also delivers an RPC request whose params are a string holding a MessagePack document to a
+// MessagePack client, which has to decode the params with the same encoding as the request.
+#include <chrono>
+#include <cstdio>
+#include "Check.h"
+#include <Thingspod.h>
+
+static constexpr size_t ITERATIONS = 20000U;
+
+using SampleDocument = StaticJsonDocument<512U>;
+
+struct Figures
+{
+  size_t size;
+  double encodeMicroseconds;
+  double decodeMicroseconds;
+};
+
+static const char *const SAMPLES[][2] = {
+    {"telemetry", "{\"temperature\":21.5,\"humidity\":48,\"pressure\":1013,\"battery\":87,\"charging\":false,\"mode\":\"eco\"}"},
+    {"attribute update", "{\"shared\":{\"interval\":60,\"threshold\":-12,\"label\":\"greenhouse north\"}}"},
+    {"rpc request", "{\"method\":\"setLevel\",\"params\":{\"level\":3,\"ramp\":1.25,\"persist\":true}}"},
+};
+
+// Encodes and decodes the document ITERATIONS times, the decoded document is written back as JSON text for the comparison.
+template <typename Encoding>
+static Figures measure(const SampleDocument &source, char *roundTrip, const size_t roundTripSize)
+{
+  Figures figures = {};
+  uint8_t encoded[256];
+  figures.size = Encoding::measure(source);
+  CHECK(figures.size > 0U && figures.size <= sizeof(encoded));
+
+  size_t written = 0U;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0U; i < ITERATIONS; i++)
+  {
+    written = Encoding::serialize(source, reinterpret_cast<char *>(encoded), sizeof(encoded));
+  }
+  figures.encodeMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+  CHECK(written == figures.size);
+
+  SampleDocument decoded;
+  bool decodedAll = true;
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0U; i < ITERATIONS; i++)
+  {
+    decodedAll = !Encoding::deserialize(decoded, static_cast<const uint8_t *>(encoded), written) && decodedAll;
+  }
+  figures.decodeMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+  CHECK(decodedAll);
+  serializeJson(decoded, roundTrip, roundTripSize);
+  return figures;
+}
+
+static Client wifiClient;
+static PubSubClient mqttClient(wifiClient);
+static ThingspodTemplate<64U, 8U, Logger, MsgPackEncoding> thingspod(wifiClient, &mqttClient);
+
+int main()
+{
+  std::printf("%-18s %10s %10s %12s %12s %12s %12s\n", "payload", "json B", "msgpack B", "json enc us", "mp enc us", "json dec us", "mp dec us");
+  for (const auto &sample : SAMPLES)
+  {
+    SampleDocument source;
+    CHECK(!deserializeJson(source, sample[1]));
+    char json[256];
+    char msgPack[256];
+    const Figures text = measure<JsonEncoding>(source, json, sizeof(json));
+    const Figures binary = measure<MsgPackEncoding>(source, msgPack, sizeof(msgPack));
+    std::printf("%-18s %10zu %10zu %12.3f %12.3f %12.3f %12.3f\n", sample[0], text.size, binary.size,
+                text.encodeMicroseconds, binary.encodeMicroseconds, text.decodeMicroseconds, binary.decodeMicroseconds);
+    CHECK(strcmp(json, sample[1]) == 0);
+    CHECK(strcmp(msgPack, sample[1]) == 0);
+    CHECK(binary.size < text.size);
+  }
+
+  // {"method":"setLevel","params":"<{"level":3} as MessagePack>"}
+  static int level = 0;
+  CHECK(thingspod.RPCSubscribe(RPCCallback("setLevel", [](const RPCData &data)
+                                           { level = data["level"].as<int>(); return RPCResponse(); })));
+  uint8_t request[] = {0x82U, 0xA6U, 'm', 'e', 't', 'h', 'o', 'd', 0xA8U, 's', 'e', 't', 'L', 'e', 'v', 'e', 'l',
+                       0xA6U, 'p', 'a', 'r', 'a', 'm', 's', 0xA8U, 0x81U, 0xA5U, 'l', 'e', 'v', 'e', 'l', 0x03U};
+  char topic[] = "v1/devices/me/rpc/request/1";
+  thingspod.onMessage(topic, request, sizeof(request));
+  CHECK(level == 3);
+  return failedChecks();
+}
@@ -0,0 +1,74 @@
+#pragma once
+// Minimal host fake of the Arduino core, only what the library uses. millis() is driven by the test through fakeMillis().
+#include <cstdint>
+#include <math.h>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdarg>
+#include <cassert>
+#include <string>
+#include <functional>
+#include <array>
+#include <limits>
+#define PROGMEM
+#define F(x) (reinterpret_cast<const __FlashStringHelper *>(x))
+class __FlashStringHelper;
+typedef bool boolean;
+typedef uint8_t byte;
+#define strncmp_P strncmp
+#define strcmp_P strcmp
+#define strlen_P strlen
+#define memcpy_P memcpy
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+inline unsigned long &fakeMillis() { static unsigned long v = 0; return v; }
+inline unsigned long millis() { return fakeMillis(); }
+inline unsigned long micros() { return 0; }
+// Waiting only advances the fake clock, so timeouts of blocking loops expire without slowing the test down.
+inline void delay(unsigned long ms) { fakeMillis() += ms; }
+inline void yield() {}
+inline long random(long a, long b) { return a + (b > a ? std::rand() % (b - a) : 0); }
+inline long random(long b) { return b ? std::rand() % b : 0; }
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t) = 0;
+  virtual size_t write(const uint8_t *b, size_t n) { size_t r = 0; while (n--) r += write(*b++); return r; }
+  size_t print(const char *) { return 0; }
+  size_t print(const __FlashStringHelper *) { return 0; }
+  size_t println(const char *) { return 0; }
+  size_t println(const __FlashStringHelper *) { return 0; }
+};
+class String {
+public:
+  String(const char *s = "") : s(s ? s : "") {}
+  const char *c_str() const { return s.c_str(); }
+  unsigned int length() const { return s.size(); }
+  void replace(const char *, const char *) {}
+  std::string s;
+};
+class Stream : public Print { public: size_t write(uint8_t) override { return 1; } };
+class HardwareSerial : public Stream { public: void begin(unsigned long) {} };
+extern HardwareSerial Serial;
+class Client : public Stream {
+public:
+  virtual int connect(const char *, uint16_t) { return 0; }
+  virtual uint8_t connected() { return 0; }
+  virtual void stop() {}
+};
+#if defined(ESP32)
+typedef void *TaskHandle_t;
+typedef unsigned int UBaseType_t;
+typedef int BaseType_t;
+typedef void (*TaskFunction_t)(void *);
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define pdPASS 1
+#define pdTRUE 1
+#define portMAX_DELAY 0xFFFFFFFF
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *h, BaseType_t) { *h = (void *)1; return pdPASS; }
+inline uint32_t ulTaskNotifyTake(BaseType_t, uint32_t) { return 1; }
+inline void xTaskNotifyGive(TaskHandle_t) {}
+#endif
@@ -0,0 +1,7 @@
+#include "Arduino.h"
+#include "Update.h"
+#include "LittleFS.h"
+
+HardwareSerial Serial;
+UpdateClass Update;
+FS LittleFS;
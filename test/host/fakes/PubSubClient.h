@@ -0,0 +1,153 @@
+#pragma once
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include "Arduino.h"
+
+#define MQTT_MAX_PACKET_SIZE 256
+
+// Records what would go over the wire instead of talking to a broker. wireBytes approximates the MQTT packet sizes
+// (fixed header, lengths, topic and payload), so host tests can compare the traffic of two code paths.
+class PubSubClient : public Print
+{
+public:
+  PubSubClient() {}
+  PubSubClient(Client &) {}
+  PubSubClient &setServer(const char *, uint16_t) { return *this; }
+  PubSubClient &setCallback(std::function<void(char *, uint8_t *, unsigned int)> received)
+  {
+    callback = received;
+    return *this;
+  }
+  PubSubClient &setClient(Client &) { return *this; }
+  boolean setBufferSize(uint16_t size) { bufferSize = size; return true; }
+  uint16_t getBufferSize() { return bufferSize; }
+
+  boolean connect(const char *id) { return connect(id, nullptr, nullptr); }
+  boolean connect(const char *id, const char *user, const char *pass) { return connect(id, user, pass, nullptr, 0U, false, nullptr, true); }
+  boolean connect(const char *id, const char *user, const char *pass, const char *, uint8_t, boolean, const char *, boolean cleanSession)
+  {
+    wireBytes += 14U + 2U + strlen(id) + (user ? 2U + strlen(user) : 0U) + (pass ? 2U + strlen(pass) : 0U);
+    if (connectCount < sizeof(connectedAt) / sizeof(connectedAt[0]))
+    {
+      connectedAt[connectCount] = millis();
+    }
+    connectCount++;
+    if (refusedConnects > 0)
+    {
+      refusedConnects--;
+      return false;
+    }
+    cleanSessions += cleanSession ? 1 : 0;
+    online = true;
+    return true;
+  }
+  void disconnect() { wireBytes += 2U; online = false; }
+  boolean connected() { return online; }
+  int state() { return 0; }
+  boolean loop()
+  {
+    if (online && loopHook != nullptr)
+    {
+      loopHook(*this);
+    }
+    return online;
+  }
+
+  // Passes a message to the callback, like a message received from the broker inside of loop.
+  void deliver(const char *topic, const uint8_t *payload, const size_t length)
+  {
+    char topicCopy[128];
+    snprintf(topicCopy, sizeof(topicCopy), "%s", topic);
+    uint8_t payloadCopy[8192];
+    memcpy(payloadCopy, payload, length);
+    callback(topicCopy, payloadCopy, length);
+  }
+
+  boolean publish(const char *topic, const char *payload) { return publish(topic, reinterpret_cast<const uint8_t *>(payload), strlen(payload), false); }
+  boolean publish(const char *topic, const char *payload, boolean retained) { return publish(topic, reinterpret_cast<const uint8_t *>(payload), strlen(payload), retained); }
+  boolean publish(const char *topic, const uint8_t *payload, unsigned int length) { return publish(topic, payload, length, false); }
+  boolean publish(const char *topic, const uint8_t *payload, unsigned int length, boolean)
+  {
+    if (!online)
+    {
+      return false;
+    }
+    remember(topic, reinterpret_cast<const char *>(payload), length);
+    publishCount++;
+    wireBytes += 2U + 2U + strlen(topic) + length;
+    if (publishHook != nullptr)
+    {
+      publishHook(*this, topic, reinterpret_cast<const char *>(payload), length);
+    }
+    return true;
+  }
+  boolean beginPublish(const char *topic, unsigned int, boolean)
+  {
+    remember(topic, "", 0U);
+    wireBytes += 2U + 2U + strlen(topic);
+    return online;
+  }
+  int endPublish() { publishCount++; return 1; }
+  size_t write(uint8_t) override { wireBytes++; return 1U; }
+  size_t write(const uint8_t *buffer, size_t size) override
+  {
+    // Batched SUBSCRIBE packets are written raw, their first byte is the packet type.
+    if (size > 0U && buffer[0] == 0x82)
+    {
+      rawSubscribes++;
+    }
+    wireBytes += size;
+    return size;
+  }
+
+  boolean subscribe(const char *topic) { return subscribe(topic, 0U); }
+  boolean subscribe(const char *topic, uint8_t)
+  {
+    wireBytes += 2U + 2U + 2U + strlen(topic) + 1U;
+    subscribeCount++;
+    return online;
+  }
+  boolean unsubscribe(const char *topic)
+  {
+    wireBytes += 2U + 2U + 2U + strlen(topic);
+    unsubscribeCount++;
+    return online;
+  }
+
+  // Let a test act as the broker, for example answer requests once the client is looped.
+  void (*publishHook)(PubSubClient &client, const char *topic, const char *payload, size_t length) = nullptr;
+  void (*loopHook)(PubSubClient &client) = nullptr;
+  std::function<void(char *, uint8_t *, unsigned int)> callback;
+
+  bool online = true;
+  uint16_t bufferSize = 256U;
+  int publishCount = 0;
+  int subscribeCount = 0;
+  int unsubscribeCount = 0;
+  int cleanSessions = 0;
+  int rawSubscribes = 0;
+  // Amount of connects that fail before the broker accepts one again, and when every attempt was made.
+  int refusedConnects = 0;
+  size_t connectCount = 0U;
+  unsigned long connectedAt[16] = {};
+  size_t wireBytes = 0U;
+  // Fixed buffers instead of std::string, so the fake never shows up in the allocation counts of a test.
+  char lastTopic[128] = {};
+  char lastPayload[512] = {};
+
+private:
+  // Copies without formatting, the stdio functions would add their own stack usage to every publish of the stack usage test.
+  void remember(const char *topic, const char *payload, const size_t length)
+  {
+    copy(lastTopic, sizeof(lastTopic), topic, strlen(topic));
+    copy(lastPayload, sizeof(lastPayload), payload, length);
+  }
+
+  static void copy(char *destination, const size_t size, const char *source, const size_t length)
+  {
+    const size_t copied = length < size - 1U ? length : size - 1U;
+    memcpy(destination, source, copied);
+    destination[copied] = '\0';
+  }
+};
@@ -0,0 +1,3 @@
+#pragma once
+#include "Update.h"
+#include "MD5Builder.h"
@@ -0,0 +1,164 @@
+// Downloads a firmware image with the write behind stage into a file backed FirmwareWriter, while the fake broker answers
+// chunk requests out of order and loses one of them, so the download has to time out and request it again.
+// The file has to contain the image byte for byte afterwards and every announcement has to end with one updated callback.
+#include <cstdio>
+#include "Check.h"
+#include <Thingspod.h>
+
+static constexpr size_t IMAGE_SIZE = 3U * FIRMWARE_CHUNK_SIZE + 100U;
+static constexpr size_t IMAGE_CHUNKS = IMAGE_SIZE / FIRMWARE_CHUNK_SIZE + 1U;
+static constexpr uint16_t LOST_CHUNK = 2U;
+
+static const char CHUNK_REQUEST_TOPIC[] = "v2/fw/request/0/chunk/";
+
+// Writes the image into a temporary file instead of the OTA partition.
+class FileWriter : public FirmwareWriter
+{
+public:
+  bool begin(size_t size) override
+  {
+    if (file != nullptr)
+    {
+      std::fclose(file);
+    }
+    file = std::tmpfile();
+    begun++;
+    return file != nullptr && size == IMAGE_SIZE;
+  }
+
+  size_t write(uint8_t *data, size_t length) override
+  {
+    return std::fwrite(data, 1U, length, file);
+  }
+
+  bool end() override
+  {
+    ended++;
+    return true;
+  }
+
+  void abort() override
+  {
+    aborted++;
+  }
+
+  void printError() override {}
+
+  const bool contains(const uint8_t *image, const size_t size)
+  {
+    static uint8_t written[IMAGE_SIZE + 1U];
+    std::fflush(file);
+    std::rewind(file);
+    return std::fread(written, 1U, sizeof(written), file) == size && memcmp(written, image, size) == 0;
+  }
+
+  std::FILE *file = nullptr;
+  int begun = 0;
+  int ended = 0;
+  int aborted = 0;
+};
+
+static Client wifiClient;
+static PubSubClient mqttClient(wifiClient);
+static Thingspod thingspod(wifiClient, &mqttClient);
+static StaticFirmwareWriteBehind<2U> writeBehind;
+static FileWriter writer;
+static uint8_t image[IMAGE_SIZE];
+
+static int requests[IMAGE_CHUNKS];
+static uint16_t queued[2U * IMAGE_CHUNKS];
+static size_t queuedCount = 0U;
+static bool loseChunk = false;
+
+static int results[4];
+static size_t resultCount = 0U;
+
+// Remembers the requested chunks, the first request of LOST_CHUNK is never answered while loseChunk is set.
+static void receivePublish(PubSubClient &, const char *topic, const char *, size_t)
+{
+  if (strncmp(topic, CHUNK_REQUEST_TOPIC, strlen(CHUNK_REQUEST_TOPIC)) != 0)
+  {
+    return;
+  }
+  const uint16_t chunk = atoi(topic + strlen(CHUNK_REQUEST_TOPIC));
+  requests[chunk]++;
+  if (loseChunk && chunk == LOST_CHUNK && requests[chunk] == 1)
+  {
+    return;
+  }
+  queued[queuedCount++] = chunk;
+}
+
+// Answers the requests newest first, so chunks requested ahead arrive before the one that is written next.
+static void answerRequests(PubSubClient &client)
+{
+  while (queuedCount > 0U)
+  {
+    const uint16_t chunk = queued[--queuedCount];
+    char topic[64];
+    snprintf(topic, sizeof(topic), "v2/fw/response/0/chunk/%u", chunk);
+    const size_t offset = chunk * FIRMWARE_CHUNK_SIZE;
+    const size_t length = (IMAGE_SIZE - offset < FIRMWARE_CHUNK_SIZE) ? IMAGE_SIZE - offset : FIRMWARE_CHUNK_SIZE;
+    client.deliver(topic, image + offset, length);
+  }
+}
+
+static void announce(const char *version, const char *checksum)
+{
+  memset(requests, 0, sizeof(requests));
+  queuedCount = 0U;
+  char topic[] = "v1/devices/me/attributes";
+  char payload[256];
+  const int length = snprintf(payload, sizeof(payload), "{\"fw_title\":\"title\",\"fw_version\":\"%s\",\"fw_size\":%zu,\"fw_checksum\":\"%s\",\"fw_checksum_algorithm\":\"MD5\"}",
+                              version, IMAGE_SIZE, checksum);
+  thingspod.onMessage(topic, reinterpret_cast<uint8_t *>(payload), length);
+}
+
+int main()
+{
+  for (size_t i = 0U; i < IMAGE_SIZE; i++)
+  {
+    image[i] = static_cast<uint8_t>(i * 31U + (i >> 8));
+  }
+  MD5Builder md5;
+  md5.begin();
+  md5.add(image, IMAGE_SIZE);
+  md5.calculate();
+  char checksum[MD5_CHECKSUM_LENGTH + 1U];
+  md5.getChars(checksum);
+
+  mqttClient.setCallback([](char *topic, uint8_t *payload, unsigned int length)
+                         { thingspod.onMessage(topic, payload, length); });
+  mqttClient.publishHook = receivePublish;
+  mqttClient.loopHook = answerRequests;
+  thingspod.setFirmwareWriter(&writer);
+  thingspod.enableFirmwareWriteBehind(writeBehind);
+  CHECK(thingspod.startFirmwareUpdate("title", "1.0.0", [](const bool &success)
+                                      { results[resultCount++] = success; }));
+
+  // Out of order and with one lost request, which is only requested again after the download timed out.
+  loseChunk = true;
+  announce("2.0.0", checksum);
+  CHECK(resultCount == 1U && results[0] == true);
+  CHECK(writer.begun == 1 && writer.ended == 1 && writer.aborted == 0);
+  CHECK(writer.contains(image, IMAGE_SIZE));
+  CHECK(requests[LOST_CHUNK] == 2);
+  for (size_t chunk = 0U; chunk < IMAGE_CHUNKS; chunk++)
+  {
+    CHECK(chunk == LOST_CHUNK || requests[chunk] == 1);
+  }
+
+  // The installed version is reported as up to date without downloading anything.
+  loseChunk = false;
+  announce("2.0.0", checksum);
+  CHECK(resultCount == 2U && results[1] == false);
+  CHECK(writer.begun == 1);
+
+  // A checksum that does not match the reassembled image aborts the writer instead of ending it.
+  announce("3.0.0", "00000000000000000000000000000000");
+  CHECK(resultCount == 3U && results[2] == false);
+  CHECK(writer.begun == 2 && writer.ended == 1 && writer.aborted == 1);
+
+  std::printf("chunk requests of the last download: %d %d %d %d, updated callbacks: %zu\n", requests[0], requests[1], requests[2], requests[3], resultCount);
+  return failedChecks();
+}
@@ -0,0 +1,59 @@
+// Prints the size of the client for a range of feature policies, from telemetry only over every module without the optional
+// services up to every module and service, next to the worst case stack of Footprint. Every step may only add to the size and
+// the telemetry only client has to stay well below a quarter of the complete one. A telemetry only client still has to publish,
+// while the services it did not opt into refuse their calls.
+#include <cstdio>
+#include "Check.h"
+#include <Thingspod.h>
+#include <Footprint.h>
+
+using Modules = FeaturePolicy<true, true, true, true, true>;
+using Offline = FeaturePolicy<true, true, true, true, true, true>;
+using Producers = FeaturePolicy<true, true, true, true, true, true, true>;
+using Dispatch = FeaturePolicy<true, true, true, true, true, true, true, true>;
+using Scheduling = FeaturePolicy<true, true, true, true, true, true, true, true, true>;
+
+template <typename Features>
+static size_t report(const char *name)
+{
+  using Footprint_t = FootprintTemplate<DEFAULT_PAYLOAD_SIZE, DEFAULT_FIELDS_ELEMENT, Logger, JsonEncoding, Features>;
+  std::printf("%-22s %8zu bytes, worst case stack %6zu bytes\n", name, Footprint_t::staticRamSize, Footprint_t::worstCaseStackSize);
+  return Footprint_t::staticRamSize;
+}
+
+static Client wifiClient;
+static PubSubClient mqttClient(wifiClient);
+static ThingspodTemplate<DEFAULT_PAYLOAD_SIZE, DEFAULT_FIELDS_ELEMENT, Logger, JsonEncoding, TelemetryOnly> thingspod(wifiClient, &mqttClient);
+
+int main()
+{
+  const size_t telemetryOnly = report<TelemetryOnly>("telemetry only");
+  const size_t modules = report<Modules>("every module");
+  const size_t offline = report<Offline>("+ offline queue");
+  const size_t producers = report<Producers>("+ producer queue");
+  const size_t dispatch = report<Dispatch>("+ dispatch queues");
+  const size_t scheduling = report<Scheduling>("+ outbound scheduler");
+  const size_t all = report<AllFeatures>("+ telemetry shaping");
+
+  CHECK(telemetryOnly < modules);
+  CHECK(modules < offline);
+  CHECK(offline < producers);
+  CHECK(producers < dispatch);
+  CHECK(dispatch < scheduling);
+  CHECK(scheduling < all);
+  CHECK(telemetryOnly * 4U < all);
+
+  CHECK(!thingspod.setTelemetryFilter("temperature", TelemetryFilterConfig(0.5f)));
+  CHECK(!thingspod.setTelemetryAggregation("temperature", 1000U));
+  CHECK(!thingspod.enableDispatch());
+  thingspod.enableOutboundScheduler();
+  thingspod.setRateLimit(PRIORITY_TELEMETRY, 1U, 1000U);
+  const Telemetry values[] = {Telemetry("temperature", 21.5f)};
+  CHECK(!thingspod.trySendTelemetry(values, 1U));
+  CHECK(thingspod.sendTelemetryData("temperature", 21.5f));
+  CHECK(thingspod.sendTelemetryData("temperature", 21.6f));
+  thingspod.mqttClientLoop();
+  CHECK(mqttClient.publishCount == 2);
+  CHECK(strcmp(mqttClient.lastTopic, "v1/devices/me/telemetry") == 0);
+  return failedChecks();
+}
@@ -0,0 +1,97 @@
+// Drops the connection of a managed client while the fake broker refuses the first reconnect attempts. The attempts have to
+// follow the jittered exponential backoff, the reconnect has to restore every subscription in one batched SUBSCRIBE and replay
+// the data sent while offline, all without touching the heap. Prints the measured reconnect and restore time.
+#include <cstdlib>
+#include <new>
+#include "Check.h"
+#include <Thingspod.h>
+
+static size_t allocations = 0U;
+
+void *operator new(size_t size)
+{
+  allocations++;
+  void *memory = std::malloc(size);
+  if (memory == nullptr)
+  {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+  std::free(memory);
+}
+
+static constexpr uint32_t MIN_DELAY = 1000U;
+static constexpr uint32_t MAX_DELAY = 8000U;
+static constexpr int REFUSED_CONNECTS = 5;
+static constexpr unsigned long LOOP_INTERVAL = 10U;
+
+static Client wifiClient;
+static PubSubClient mqttClient(wifiClient);
+static Thingspod thingspod(wifiClient, &mqttClient);
+
+int main()
+{
+  static const char *const keys[] = {"interval"};
+  const char *const *const keysBegin = keys;
+  const char *const *const keysEnd = keys + 1U;
+
+  thingspod.enableManagedConnection(MIN_DELAY, MAX_DELAY);
+  CHECK(thingspod.connect("host", 1883, "token"));
+  CHECK(thingspod.RPCSubscribe(RPCCallback("reboot", [](const RPCData &)
+                                           { return RPCResponse(); })));
+  CHECK(thingspod.sharedAttributesSubscribe(SharedAttributeCallback(keysBegin, keysEnd, [](const SharedAttributeData &) {})));
+  const int subscribes = mqttClient.subscribeCount;
+  CHECK(subscribes > 1);
+
+  // The broker goes away, the sample sent meanwhile is queued.
+  fakeMillis() = 100000U;
+  const unsigned long droppedAt = fakeMillis();
+  mqttClient.online = false;
+  mqttClient.refusedConnects = REFUSED_CONNECTS;
+  CHECK(thingspod.sendTelemetryJsonChar("{\"temperature\":21.5}"));
+  const size_t firstAttempt = mqttClient.connectCount;
+  const int publishes = mqttClient.publishCount;
+
+  const size_t before = allocations;
+  while (!mqttClient.connected() && fakeMillis() - droppedAt < 10U * MAX_DELAY * REFUSED_CONNECTS)
+  {
+    thingspod.mqttClientLoop();
+    fakeMillis() += LOOP_INTERVAL;
+  }
+  CHECK(allocations == before);
+  CHECK(mqttClient.connected());
+
+  // The first attempt is made right away, every following one waits between half and all of the doubled delay.
+  const ConnectionStats &stats = thingspod.getConnectionStats();
+  CHECK(mqttClient.connectCount - firstAttempt == REFUSED_CONNECTS + 1U);
+  CHECK(stats.failedAttempts == static_cast<uint32_t>(REFUSED_CONNECTS) && stats.reconnects == 1U);
+  CHECK(mqttClient.connectedAt[firstAttempt] == droppedAt);
+  uint32_t delay = MIN_DELAY;
+  for (size_t attempt = firstAttempt + 1U; attempt < mqttClient.connectCount; attempt++)
+  {
+    const unsigned long waited = mqttClient.connectedAt[attempt] - mqttClient.connectedAt[attempt - 1U];
+    std::printf("attempt %zu after %lu ms, backoff %u ms\n", attempt - firstAttempt, waited, delay);
+    CHECK(waited >= delay / 2U && waited <= delay + LOOP_INTERVAL);
+    delay = delay * 2U > MAX_DELAY ? MAX_DELAY : delay * 2U;
+  }
+
+  // Every topic is restored with one SUBSCRIBE packet and the queued sample is replayed.
+  CHECK(mqttClient.rawSubscribes == 1);
+  CHECK(mqttClient.subscribeCount == subscribes);
+  CHECK(mqttClient.publishCount == publishes + 1);
+  CHECK(strcmp(mqttClient.lastTopic, "v1/devices/me/telemetry") == 0 && strcmp(mqttClient.lastPayload, "{\"temperature\":21.5}") == 0);
+
+  const unsigned long lastAttempt = mqttClient.connectedAt[mqttClient.connectCount - 1U];
+  std::printf("reconnected after %u ms, restored in %u ms, %zu allocations\n", stats.lastReconnectDuration, stats.lastRestoreDuration, allocations - before);
+  CHECK(stats.lastReconnectDuration == lastAttempt - droppedAt);
+  return failedChecks();
+}
@@ -0,0 +1,84 @@
+// Several std::thread producers push into one ProducerQueue while the main thread consumes, like application tasks calling
+// trySendTelemetry while the network task runs mqttClientLoop. Every message has to arrive exactly once and in the order
+// its producer pushed it. Prints the throughput and how often producers lost the race for a slot.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "Check.h"
+#include <Thingspod.h>
+
+static constexpr size_t PRODUCERS = 4U;
+static constexpr size_t MESSAGES_PER_PRODUCER = 200000U;
+
+static const char TOPIC[] = "v1/devices/me/telemetry";
+static ProducerQueue<OutboundMessage<64U>, 16U> queue;
+
+static void produce(const size_t producer)
+{
+  char payload[32];
+  for (size_t sequence = 0U; sequence < MESSAGES_PER_PRODUCER; sequence++)
+  {
+    const int length = std::snprintf(payload, sizeof(payload), "%zu:%zu", producer, sequence);
+    // A full queue is the expected back pressure, the producer retries until the consumer made room.
+    while (!queue.tryPush(TOPIC, payload, static_cast<size_t>(length)))
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+int main()
+{
+  std::vector<size_t> expected(PRODUCERS, 0U);
+  size_t received = 0U;
+  size_t corrupted = 0U;
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> producers;
+  for (size_t producer = 0U; producer < PRODUCERS; producer++)
+  {
+    producers.emplace_back(produce, producer);
+  }
+
+  while (received < PRODUCERS * MESSAGES_PER_PRODUCER)
+  {
+    OutboundMessage<64U> *message = queue.front();
+    if (message == nullptr)
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    size_t producer = 0U;
+    size_t sequence = 0U;
+    if (message->topic != TOPIC || std::sscanf(message->payload, "%zu:%zu", &producer, &sequence) != 2 || producer >= PRODUCERS || sequence != expected[producer])
+    {
+      corrupted++;
+    }
+    else
+    {
+      expected[producer]++;
+    }
+    queue.pop();
+    received++;
+  }
+
+  for (std::thread &producer : producers)
+  {
+    producer.join();
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::printf("%zu producers, %zu messages in %.3f s, %.0f messages/s\n", PRODUCERS, received, seconds, received / seconds);
+  std::printf("contention: %u retries (%.4f per message), full queue rejections: %u\n", queue.contention(),
+              static_cast<double>(queue.contention()) / received, queue.droppedMessages());
+
+  CHECK(corrupted == 0U);
+  for (size_t producer = 0U; producer < PRODUCERS; producer++)
+  {
+    CHECK(expected[producer] == MESSAGES_PER_PRODUCER);
+  }
+  CHECK(queue.front() == nullptr);
+  return failedChecks();
+}
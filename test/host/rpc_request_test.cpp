@@ -0,0 +1,54 @@
+// Device side RPC requests take the next id whose entry of the pending table is free, so an unanswered request does not block
+// the ones after it, while responses are still matched by their id alone.
+#include "Check.h"
+#include <Thingspod.h>
+
+static Client wifiClient;
+static PubSubClient mqttClient(wifiClient);
+static Thingspod thingspod(wifiClient, &mqttClient);
+
+static size_t responses = 0U;
+
+static RPCRequestHandle request()
+{
+  return thingspod.RPCRequest("getTime", RPCRequestCallback([](const RPCData &)
+                                                            { responses++; }));
+}
+
+static void respond(const uint32_t id)
+{
+  char topic[64];
+  snprintf(topic, sizeof(topic), "v1/devices/me/rpc/response/%u", id);
+  uint8_t payload[] = "{}";
+  thingspod.onMessage(topic, payload, sizeof(payload) - 1U);
+}
+
+int main()
+{
+  RPCRequestHandle handles[MAX_PENDING_RPC_REQUESTS];
+  for (size_t i = 0U; i < MAX_PENDING_RPC_REQUESTS; i++)
+  {
+    handles[i] = request();
+    CHECK(handles[i].id == i + 1U);
+  }
+  CHECK(!request().valid());
+
+  // Only the entry of the second request is freed, the next id whose entry is free is skipped ahead to.
+  respond(handles[1].id);
+  CHECK(responses == 1U);
+  const RPCRequestHandle skipped = request();
+  CHECK(skipped.id == handles[1].id + MAX_PENDING_RPC_REQUESTS);
+  CHECK(strcmp(mqttClient.lastTopic, "v1/devices/me/rpc/request/6") == 0);
+  CHECK(!request().valid());
+
+  // The old id no longer matches, the new one does.
+  respond(handles[1].id);
+  CHECK(responses == 1U);
+  respond(skipped.id);
+  CHECK(responses == 2U);
+
+  // Ids continue after the highest one that was handed out.
+  thingspod.cancelRPCRequest(handles[0]);
+  CHECK(request().id == skipped.id + MAX_PENDING_RPC_REQUESTS - 1U);
+  return failedChecks();
+}
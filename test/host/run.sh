@@ -0,0 +1,24 @@
+#!/bin/sh
+# Builds and runs every host test against the fakes of the Arduino core and PubSubClient in fakes/.
+# ArduinoJson 6 is used as is, point ARDUINOJSON_INCLUDE at its src directory, for example
+#   ARDUINOJSON_INCLUDE=~/Arduino/libraries/ArduinoJson/src test/host/run.sh
+# Every warning fails the build. Only const qualified return values and char * PROGMEM constants are accepted, they are
+# how the whole library declares its functions and log messages. Symbols are bound at load time, otherwise the first call of a
+# C library function from a thread runs the dynamic linker on its stack, which the stack usage test would count.
+set -e
+HERE=$(cd "$(dirname "$0")" && pwd)
+SRC="$HERE/../../src"
+OUT="${OUT:-$HERE/build}"
+mkdir -p "$OUT"
+for test in "$HERE"/*_test.cpp; do
+  name=$(basename "$test" .cpp)
+  # The library targets C++11, only the coroutine API needs C++20 and is tested by the tests named *_cpp20_test.cpp.
+  case "$name" in
+  *_cpp20_test) standard=gnu++20 ;;
+  *) standard=gnu++11 ;;
+  esac
+  ${CXX:-g++} -std=$standard -O1 -pthread -Wall -Wextra -Werror -Wno-ignored-qualifiers -Wno-write-strings -DESP32 -Wl,-z,now -I"$HERE/fakes" ${ARDUINOJSON_INCLUDE:+-isystem "$ARDUINOJSON_INCLUDE"} -I"$SRC" \
+    "$test" "$SRC/Thingspod.cpp" "$HERE/fakes/Globals.cpp" -o "$OUT/$name"
+  echo "$name"
+  "$OUT/$name"
+done
@@ -0,0 +1,226 @@
+// Paints the stack of a thread, runs one inbound message path on it and measures how deep the paint was overwritten, for RPC,
+// shared attribute updates, firmware downloads and gateway RPC. The measured figures have to stay within the matching constant
+// of Footprint, plus an allowance for the frames Footprint leaves out on purpose (compiler temporaries and the callbacks of this
+// test). Prints the measured figures next to the constants.
+#include <pthread.h>
+#include <cstdio>
+#include "Check.h"
+#include <Thingspod.h>
+#include <Footprint.h>
+
+static constexpr size_t STACK_SIZE = 256U * 1024U;
+static constexpr uint8_t PAINT = 0xA5U;
+// Frames of the library functions themselves, of the fakes and of the callbacks, none of which Footprint counts.
+static constexpr size_t FRAME_ALLOWANCE = 2048U;
+
+// Printing to the host console goes through the stdio buffers of the C library, which a device never does.
+struct QuietLogger
+{
+  static void log(const char *) {}
+};
+
+using Client_t = ThingspodTemplate<DEFAULT_PAYLOAD_SIZE, DEFAULT_FIELDS_ELEMENT, QuietLogger>;
+using Footprint_t = FootprintTemplate<DEFAULT_PAYLOAD_SIZE, DEFAULT_FIELDS_ELEMENT, QuietLogger>;
+
+static constexpr size_t IMAGE_SIZE = FIRMWARE_CHUNK_SIZE + 100U;
+static const char CHUNK_REQUEST_TOPIC[] = "v2/fw/request/0/chunk/";
+
+// Accepts and discards the image, the firmware path is measured up to the writer.
+class NullWriter : public FirmwareWriter
+{
+public:
+  bool begin(size_t) override
+  {
+    return true;
+  }
+
+  size_t write(uint8_t *, size_t length) override
+  {
+    return length;
+  }
+
+  bool end() override
+  {
+    return true;
+  }
+
+  void abort() override {}
+
+  void printError() override {}
+};
+
+// Keeps the mirrored attributes in RAM, the attribute path is measured with the mirror, which is its deepest variant.
+class RamStorage : public PersistentStorage
+{
+public:
+  size_t load(const char *, uint8_t *buffer, size_t size) override
+  {
+    if (length == 0U || length > size)
+    {
+      return 0U;
+    }
+    memcpy(buffer, blob, length);
+    return length;
+  }
+
+  bool save(const char *, const uint8_t *data, size_t size) override
+  {
+    if (size > sizeof(blob))
+    {
+      return false;
+    }
+    memcpy(blob, data, size);
+    length = size;
+    return true;
+  }
+
+private:
+  uint8_t blob[1024];
+  size_t length = 0U;
+};
+
+static Client wifiClient;
+static PubSubClient mqttClient(wifiClient);
+static Client_t thingspod(wifiClient, &mqttClient);
+static NullWriter writer;
+static RamStorage storage;
+static uint8_t image[IMAGE_SIZE];
+static char checksum[MD5_CHECKSUM_LENGTH + 1U];
+static int requestedChunks[4];
+static size_t requestedCount = 0U;
+static size_t calls = 0U;
+static bool updated = false;
+
+alignas(16) static uint8_t stack[STACK_SIZE];
+
+static void *run(void *path)
+{
+  reinterpret_cast<void (*)()>(path)();
+  return nullptr;
+}
+
+// Runs the path on a freshly painted stack and returns the bytes below the top that were written to.
+static size_t measure(void (*path)())
+{
+  memset(stack, PAINT, sizeof(stack));
+  pthread_attr_t attributes;
+  pthread_attr_init(&attributes);
+  pthread_attr_setstack(&attributes, stack, sizeof(stack));
+  pthread_t thread;
+  CHECK(pthread_create(&thread, &attributes, run, reinterpret_cast<void *>(path)) == 0);
+  pthread_join(thread, nullptr);
+  pthread_attr_destroy(&attributes);
+  size_t untouched = 0U;
+  while (untouched < sizeof(stack) && stack[untouched] == PAINT)
+  {
+    untouched++;
+  }
+  return sizeof(stack) - untouched;
+}
+
+static void deliver(const char *topic, const char *payload)
+{
+  char topicCopy[64];
+  char payloadCopy[256];
+  snprintf(topicCopy, sizeof(topicCopy), "%s", topic);
+  const int length = snprintf(payloadCopy, sizeof(payloadCopy), "%s", payload);
+  thingspod.onMessage(topicCopy, reinterpret_cast<uint8_t *>(payloadCopy), length);
+}
+
+static void idle() {}
+
+static void rpc()
+{
+  deliver("v1/devices/me/rpc/request/1", "{\"method\":\"setLevel\",\"params\":{\"level\":3}}");
+}
+
+static void attributeUpdate()
+{
+  deliver("v1/devices/me/attributes", "{\"interval\":10}");
+}
+
+static void firmware()
+{
+  char payload[256];
+  snprintf(payload, sizeof(payload), "{\"fw_title\":\"title\",\"fw_version\":\"2.0.0\",\"fw_size\":%zu,\"fw_checksum\":\"%s\",\"fw_checksum_algorithm\":\"MD5\"}",
+           IMAGE_SIZE, checksum);
+  deliver("v1/devices/me/attributes", payload);
+}
+
+static void gatewayRPC()
+{
+  deliver("v1/gateway/rpc", "{\"device\":\"sensor\",\"data\":{\"id\":1,\"method\":\"setLevel\",\"params\":{\"level\":3}}}");
+}
+
+// Remembers the requested chunks and answers them from within the loop of the download, like a broker would. The chunks are
+// passed from a static buffer, like PubSubClient passes its heap buffer, instead of the stack buffer of the fake client.
+static void receivePublish(PubSubClient &, const char *topic, const char *, size_t)
+{
+  if (strncmp(topic, CHUNK_REQUEST_TOPIC, strlen(CHUNK_REQUEST_TOPIC)) == 0 && requestedCount < 4U)
+  {
+    requestedChunks[requestedCount++] = atoi(topic + strlen(CHUNK_REQUEST_TOPIC));
+  }
+}
+
+static void answerRequests(PubSubClient &)
+{
+  static uint8_t chunk[FIRMWARE_CHUNK_SIZE];
+  for (size_t i = 0U; i < requestedCount; i++)
+  {
+    char topic[64];
+    snprintf(topic, sizeof(topic), "v2/fw/response/0/chunk/%d", requestedChunks[i]);
+    const size_t offset = requestedChunks[i] * FIRMWARE_CHUNK_SIZE;
+    const size_t length = IMAGE_SIZE - offset < FIRMWARE_CHUNK_SIZE ? IMAGE_SIZE - offset : FIRMWARE_CHUNK_SIZE;
+    memcpy(chunk, image + offset, length);
+    thingspod.onMessage(topic, chunk, length);
+  }
+  requestedCount = 0U;
+}
+
+static void report(const char *path, const size_t measured, const size_t footprint)
+{
+  std::printf("%-18s measured %6zu bytes, Footprint %6zu bytes\n", path, measured, footprint);
+  CHECK(measured <= footprint + FRAME_ALLOWANCE);
+}
+
+int main()
+{
+  static const char *const keys[] = {"interval"};
+  const char *const *const keysBegin = keys;
+  const char *const *const keysEnd = keys + 1U;
+  for (size_t i = 0U; i < IMAGE_SIZE; i++)
+  {
+    image[i] = static_cast<uint8_t>(i * 31U);
+  }
+  MD5Builder md5;
+  md5.begin();
+  md5.add(image, IMAGE_SIZE);
+  md5.calculate();
+  md5.getChars(checksum);
+
+  mqttClient.publishHook = receivePublish;
+  mqttClient.loopHook = answerRequests;
+  CHECK(thingspod.RPCSubscribe(RPCCallback("setLevel", [](const RPCData &data)
+                                           { calls++; return RPCResponse("level", data["level"].as<int>()); })));
+  CHECK(thingspod.sharedAttributesSubscribe(SharedAttributeCallback(keysBegin, keysEnd, [](const SharedAttributeData &)
+                                                                    { calls++; })));
+  thingspod.enableAttributeMirror(storage);
+  thingspod.setFirmwareWriter(&writer);
+  CHECK(thingspod.startFirmwareUpdate("title", "1.0.0", [](const bool &success)
+                                      { updated = success; }));
+  CHECK(thingspod.gatewayConnectDevice("sensor"));
+  CHECK(thingspod.gatewayRPCSubscribe("sensor", RPCCallback("setLevel", [](const RPCData &data)
+                                                            { calls++; return RPCResponse("level", data["level"].as<int>()); })));
+
+  // The thread start itself writes to the stack as well, it is measured once and left out of every figure.
+  const size_t baseline = measure(idle);
+  report("rpc", measure(rpc) - baseline, Footprint_t::rpcStackSize);
+  CHECK(calls == 1U);
+  report("attribute update", measure(attributeUpdate) - baseline, Footprint_t::attributeUpdateStackSize);
+  CHECK(calls == 2U);
+  report("firmware", measure(firmware) - baseline, Footprint_t::firmwareStackSize);
+  CHECK(updated);
+  report("gateway rpc", measure(gatewayRPC) - baseline, Footprint_t::gatewayRPCStackSize);
+  CHECK(calls == 3U);
+  return failedChecks();
+}
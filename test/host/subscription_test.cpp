@@ -0,0 +1,47 @@
+// Subscribes shared topics from several callbacks and removes them again. A topic has to be subscribed once, no matter how many
+// callbacks use it, and unsubscribed once its last callback is gone: for the gateway topics that is when the last device with a
+// callback disconnects, for the RPC topic when its callbacks are unsubscribed.
+#include "Check.h"
+#include <Thingspod.h>
+
+static Client wifiClient;
+static PubSubClient mqttClient(wifiClient);
+static Thingspod thingspod(wifiClient, &mqttClient);
+
+static RPCResponse respond(const RPCData &)
+{
+  return RPCResponse();
+}
+
+int main()
+{
+  CHECK(thingspod.connect("host", 1883, "token"));
+  const int subscribes = mqttClient.subscribeCount;
+
+  // Two RPC methods share one topic.
+  CHECK(thingspod.RPCSubscribe(RPCCallback("first", respond)));
+  CHECK(thingspod.RPCSubscribe(RPCCallback("second", respond)));
+  CHECK(mqttClient.subscribeCount == subscribes + 1);
+  CHECK(thingspod.RPCUnsubscribe());
+  CHECK(mqttClient.unsubscribeCount == 1);
+  CHECK(thingspod.RPCSubscribe(RPCCallback("first", respond)));
+  CHECK(mqttClient.subscribeCount == subscribes + 2);
+
+  // Two gateway devices share one topic, it stays subscribed until the second device disconnects.
+  CHECK(thingspod.gatewayConnectDevice("first"));
+  CHECK(thingspod.gatewayConnectDevice("second"));
+  CHECK(thingspod.gatewayRPCSubscribe("first", RPCCallback("reboot", respond)));
+  CHECK(thingspod.gatewayRPCSubscribe("second", RPCCallback("reboot", respond)));
+  CHECK(thingspod.gatewayRPCSubscribe("second", RPCCallback("reset", respond)));
+  CHECK(mqttClient.subscribeCount == subscribes + 3);
+  CHECK(thingspod.gatewayDisconnectDevice("second"));
+  CHECK(mqttClient.unsubscribeCount == 1);
+  CHECK(thingspod.gatewayDisconnectDevice("first"));
+  CHECK(mqttClient.unsubscribeCount == 2);
+
+  // Subscribed again by the next callback.
+  CHECK(thingspod.gatewayConnectDevice("first"));
+  CHECK(thingspod.gatewayRPCSubscribe("first", RPCCallback("reboot", respond)));
+  CHECK(mqttClient.subscribeCount == subscribes + 4);
+  return failedChecks();
+}
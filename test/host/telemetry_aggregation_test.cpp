@@ -0,0 +1,94 @@
+// Closes aggregation windows while connected and while the managed connection is down. The statistics of a window have to be
+// published as one message instead of being streamed, queued while disconnected and replayed after the reconnect, and a record
+// that does not fit into the queue has to be logged instead of being dropped silently.
+#include "Check.h"
+#include <Thingspod.h>
+
+static constexpr uint32_t WINDOW = 1000U;
+static constexpr unsigned long LOOP_INTERVAL = 10U;
+
+// Counts the statistics that could not be sent.
+struct CountingLogger
+{
+  static size_t &unsent()
+  {
+    static size_t count = 0U;
+    return count;
+  }
+
+  static void log(const char *message)
+  {
+    if (strncmp(message, "Statistics of", strlen("Statistics of")) == 0)
+    {
+      unsent()++;
+    }
+  }
+};
+
+static Client wifiClient;
+static PubSubClient bigClient(wifiClient);
+static PubSubClient smallClient(wifiClient);
+static ThingspodTemplate<256U, 8U, CountingLogger> big(wifiClient, &bigClient);
+// The record of one window is bigger than a payload of this client.
+static ThingspodTemplate<64U, 8U, CountingLogger> small(wifiClient, &smallClient);
+
+static const bool containsStatistics(const char *payload)
+{
+  return strstr(payload, "\"temperature_min\":20") != nullptr && strstr(payload, "\"temperature_max\":22") != nullptr &&
+         strstr(payload, "\"temperature_mean\":21") != nullptr && strstr(payload, "\"temperature_var\":") != nullptr &&
+         strstr(payload, "\"temperature_count\":2") != nullptr;
+}
+
+template <typename Client_t>
+static void sample(Client_t &client)
+{
+  CHECK(client.setTelemetryAggregation("temperature", WINDOW));
+  CHECK(client.sendTelemetryData("temperature", 20.0f));
+  CHECK(client.sendTelemetryData("temperature", 22.0f));
+  fakeMillis() += WINDOW;
+}
+
+int main()
+{
+  fakeMillis() = 100000U;
+  big.enableManagedConnection();
+  small.enableManagedConnection();
+  CHECK(big.connect("host", 1883, "token"));
+  CHECK(small.connect("host", 1883, "token"));
+
+  // Connected, the record is published at once even though it is bigger than PayloadSize.
+  int publishes = smallClient.publishCount;
+  sample(small);
+  CHECK(smallClient.publishCount == publishes);
+  small.mqttClientLoop();
+  CHECK(smallClient.publishCount == publishes + 1);
+  CHECK(containsStatistics(smallClient.lastPayload));
+  CHECK(CountingLogger::unsent() == 0U);
+
+  // Disconnected, the record is queued and replayed once the managed connection is back.
+  bigClient.online = false;
+  bigClient.refusedConnects = 1000;
+  publishes = bigClient.publishCount;
+  sample(big);
+  big.mqttClientLoop();
+  CHECK(bigClient.publishCount == publishes);
+  CHECK(CountingLogger::unsent() == 0U);
+  bigClient.refusedConnects = 0;
+  for (size_t i = 0U; i < 1000U && !bigClient.connected(); i++)
+  {
+    fakeMillis() += LOOP_INTERVAL;
+    big.mqttClientLoop();
+  }
+  CHECK(bigClient.connected());
+  CHECK(bigClient.publishCount == publishes + 1);
+  CHECK(strcmp(bigClient.lastTopic, "v1/devices/me/telemetry") == 0);
+  CHECK(containsStatistics(bigClient.lastPayload));
+
+  // Disconnected with a record that does not fit into the queue, it is logged.
+  smallClient.online = false;
+  smallClient.refusedConnects = 1000;
+  sample(small);
+  small.mqttClientLoop();
+  CHECK(CountingLogger::unsent() == 1U);
+  return failedChecks();
+}